@@ -0,0 +1,67 @@
+/*****************************************************************/ /**
+ * @file   AliasTable.hpp
+ * @brief  header file of AliasTable class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_ALIASTABLE_HPP_
+#define PALM_INCLUDE_ALIASTABLE_HPP_
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace palm
+{
+    /**
+     * @brief  Walker alias table for sampling a discrete distribution in O(1)
+     * @detail Built with Vose's method in O(n). Sampling picks a bin uniformly,
+     *         then keeps it with the probability of the bin or takes its alias otherwise
+     */
+    class AliasTable
+    {
+    public:
+        /**
+         * @brief  Bin of the table (passed to the GPU, must always be kept in sync with shader side)
+         */
+        struct Bin  // std430
+        {
+            //! Probability of keeping this bin
+            float prob = 1.f;
+            //! Index taken otherwise
+            uint32_t alias = 0;
+            //! Probability with which this index is sampled (weight / sum of weights)
+            float pdf = 0.f;
+            uint32_t padding = 0;
+        };
+
+    public:
+        /**
+         * @brief  Build the table
+         *
+         * @param weights Non-negative weight of each index (sampled uniformly if all weights are zero)
+         */
+        explicit AliasTable(std::span<const float> weights);
+
+        /**
+         * @brief  Get the bins (one per weight)
+         *
+         */
+        const std::vector<Bin>& getBins() const;
+
+        /**
+         * @brief  Sum of the weights
+         *
+         */
+        double getWeightSum() const;
+
+    private:
+        //! Bins
+        std::vector<Bin> mBins;
+        //! Sum of the weights
+        double mWeightSum = 0.0;
+    };
+}  // namespace palm
+
+#endif
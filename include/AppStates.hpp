@@ -11,6 +11,19 @@
 #include <vk2s/Device.hpp>
 #include <EC2S.hpp>
 
+#include <glm/glm.hpp>
+
+#include "DeviceMemoryPool.hpp"
+#include "GPUScene.hpp"
+#include "MeshPool.hpp"
+#include "TextureRegistry.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace palm
 {
     /**
@@ -20,6 +33,42 @@ namespace palm
     {
         eEditor,
         eRenderer,
+        eHeadless,
+    };
+
+    /**
+     * @brief  Settings for offline rendering without window and swapchain (given from command line)
+     */
+    struct HeadlessSettings
+    {
+        //! 3D models to be loaded into the scene
+        std::vector<std::filesystem::path> modelPaths;
+        //! Scene file saved by the editor (loaded before the models, not used if empty)
+        std::filesystem::path scenePath;
+        //! Environment map image for infinite emitter (not used if empty)
+        std::filesystem::path envmapPath;
+        //! Constant emissive of infinite emitter (used if no environment map is specified)
+        std::optional<glm::vec3> envColor;
+
+        //! Integrator to be used ("path" or "restir")
+        std::string integrator = "path";
+        //! Resolution of output image
+        uint32_t width  = 1920;
+        uint32_t height = 1080;
+        //! Samples per pixel per frame
+        uint32_t sppPerFrame = 1;
+        //! Total samples per pixel to be accumulated (0: unlimited, then timeBudget must be set)
+        uint32_t targetSpp = 1024;
+        //! Time budget for rendering in seconds (0: unlimited)
+        double timeBudget = 0.0;
+
+        //! Camera parameters
+        glm::vec3 cameraPos    = glm::vec3(0.0, 0.8, 3.0);
+        glm::vec3 cameraLookAt = glm::vec3(0.0, 0.8, -2.0);
+        double cameraFOV       = 60.;
+
+        //! Destination of the rendered image
+        std::filesystem::path outputPath = "rendered.png";
     };
 
     /**
@@ -29,6 +78,9 @@ namespace palm
     {
         CommonRegion()
             : device(vk2s::Device::Extensions{.useRayTracingExt = true, .useNVMotionBlurExt = false})
+            , memoryPool(device)
+            , meshPool(device, memoryPool)
+            , textureRegistry(device)
         {
 
         }
@@ -37,8 +89,20 @@ namespace palm
         vk2s::Device device;
         //! vk2s window
         UniqueHandle<vk2s::Window> window;
+        //! Pooled device memory of resources created outside of vk2s (declared before everything allocating from it)
+        DeviceMemoryPool memoryPool;
+        //! Geometry pool shared between meshes with the same contents (declared before the scene so that it outlives all meshes)
+        MeshPool meshPool;
+        //! Texture images shared between materials with the same contents
+        TextureRegistry textureRegistry;
         //! ec2s registry (representing scene)
         ec2s::Registry scene;
+        //! GPU resources of the scene shared by all integrators (declared after the scene, recreated when its structure changes)
+        std::unique_ptr<GPUScene> gpuScene;
+        //! Settings for headless mode (valid only when launched in headless mode)
+        std::optional<HeadlessSettings> headless;
+        //! Whether headless rendering failed (the application exits with a non-zero status)
+        bool headlessFailed = false;
     };
 
 }  // namespace palm
@@ -0,0 +1,150 @@
+/*****************************************************************/ /**
+ * @file   BLASBuilder.hpp
+ * @brief  header file of BLAS and BLASBuilder classes
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_BLASBUILDER_HPP_
+#define PALM_INCLUDE_BLASBUILDER_HPP_
+
+#include "DeviceMemoryPool.hpp"
+
+#include <vk2s/Device.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace palm
+{
+    struct MeshGeometry;
+    class MeshPool;
+
+    /**
+     * @brief  Bottom level acceleration structure (built by BLASBuilder)
+     * @detail Owns the acceleration structure and its storage buffer, both are destroyed with this object.
+     *         The storage is sub-allocated from the memory pool, so BLASes of many meshes share a few allocations
+     */
+    class BLAS
+    {
+    public:
+        /**
+         * @brief  Constructor (create an acceleration structure on a buffer of its own)
+         *
+         * @param device vk2s device
+         * @param memoryPool Pool of the storage buffer
+         * @param size Size of the acceleration structure
+         */
+        BLAS(vk2s::Device& device, DeviceMemoryPool& memoryPool, vk::DeviceSize size);
+
+        /**
+         * @brief  Destructor
+         *
+         */
+        ~BLAS();
+
+        BLAS(const BLAS&)            = delete;
+        BLAS& operator=(const BLAS&) = delete;
+
+        /**
+         * @brief  Get the Vulkan handle of the acceleration structure
+         *
+         */
+        vk::AccelerationStructureKHR getVkAccelerationStructure() const
+        {
+            return mAccelerationStructure;
+        }
+
+        /**
+         * @brief  Get the device address (referenced by TLAS instances)
+         *
+         */
+        vk::DeviceAddress getVkDeviceAddress() const
+        {
+            return mDeviceAddress;
+        }
+
+        /**
+         * @brief  Get the size of the storage
+         *
+         */
+        vk::DeviceSize getSize() const
+        {
+            return mSize;
+        }
+
+    private:
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Storage buffer (pooled)
+        PooledBuffer mBuffer;
+        //! Acceleration structure
+        vk::AccelerationStructureKHR mAccelerationStructure;
+        //! Device address of the acceleration structure
+        vk::DeviceAddress mDeviceAddress = 0;
+        //! Size of the storage
+        vk::DeviceSize mSize = 0;
+    };
+
+    /**
+     * @brief  Builds the BLASes of many meshes at once
+     * @detail All builds are recorded into one command buffer sharing a sub-allocated scratch buffer,
+     *         then every BLAS is compacted into a buffer of just the required size
+     */
+    class BLASBuilder
+    {
+    public:
+        /**
+         * @brief  Memory usage of the last build
+         */
+        struct Stats
+        {
+            uint32_t blasNum             = 0;
+            vk::DeviceSize originalSize  = 0;
+            vk::DeviceSize compactedSize = 0;
+            vk::DeviceSize scratchSize   = 0;
+        };
+
+        //! Upper limit of the scratch buffer (builds are split into several batches if exceeded)
+        constexpr static vk::DeviceSize kMaxScratchSize = 256ull * 1024 * 1024;
+        //! Alignment of acceleration structure offsets (required by the specification)
+        constexpr static vk::DeviceSize kASAlignment = 256;
+        //! Alignment of scratch offsets (covers minAccelerationStructureScratchOffsetAlignment of current devices)
+        constexpr static vk::DeviceSize kScratchAlignment = 256;
+
+    public:
+        /**
+         * @brief  Constructor
+         *
+         * @param device vk2s device
+         * @param meshPool Pool owning the global buffers that the geometries refer to
+         */
+        BLASBuilder(vk2s::Device& device, MeshPool& meshPool);
+
+        /**
+         * @brief  Queue the BLAS build of the geometry
+         * @detail The vertices and indices of the geometry must already be uploaded,
+         *         and the geometry must be kept alive until build()
+         *
+         * @param geometry Geometry whose blas is set by build()
+         */
+        void add(MeshGeometry& geometry);
+
+        /**
+         * @brief  Build and compact all queued BLASes, and wait for the completion
+         *
+         * @return Memory usage of this build
+         */
+        Stats build();
+
+    private:
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Reference to the geometry pool
+        MeshPool& mMeshPool;
+        //! Geometries whose BLAS is not built yet
+        std::vector<MeshGeometry*> mPendingGeometries;
+    };
+}  // namespace palm
+
+#endif
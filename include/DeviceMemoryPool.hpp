@@ -0,0 +1,384 @@
+/*****************************************************************/ /**
+ * @file   DeviceMemoryPool.hpp
+ * @brief  header file of DeviceMemoryPool, PooledBuffer and PooledImage classes
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_DEVICEMEMORYPOOL_HPP_
+#define PALM_INCLUDE_DEVICEMEMORYPOOL_HPP_
+
+#include <vk2s/Device.hpp>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace palm
+{
+    /**
+     * @brief  Intended use of memory (each has its own pool)
+     */
+    enum class MemoryUsage : uint32_t
+    {
+        //! Read and written only by the GPU
+        eDeviceLocal = 0,
+        //! Written by the CPU every frame (persistently mapped)
+        eUpload = 1,
+        //! Written by the GPU and read by the CPU (persistently mapped)
+        eReadback = 2,
+        eUsageNum
+    };
+
+    /**
+     * @brief  Sub-allocates resources from a few large VkDeviceMemory blocks
+     * @detail Each usage has its own list of blocks, and the ranges in a block are allocated first-fit,
+     *         so the number of vkAllocateMemory calls no longer grows with the number of resources.
+     *         Requests larger than half a block get a dedicated block that is freed with the resource,
+     *         and shared blocks that become empty are freed except one per usage kept for the next allocations
+     */
+    class DeviceMemoryPool
+    {
+    public:
+        //! Size of the shared blocks
+        constexpr static vk::DeviceSize kBlockSize = 64ull * 1024 * 1024;
+
+        /**
+         * @brief  Range of memory handed out by allocate()
+         */
+        struct Allocation
+        {
+            vk::DeviceMemory memory;
+            vk::DeviceSize offset = 0;
+            vk::DeviceSize size   = 0;
+            //! Mapped address of the range (nullptr for eDeviceLocal)
+            void* pMapped       = nullptr;
+            MemoryUsage usage        = MemoryUsage::eDeviceLocal;
+            uint32_t blockIndex      = 0;
+            uint32_t memoryTypeIndex = 0;
+        };
+
+        /**
+         * @brief  Memory usage of a pool
+         */
+        struct Stats
+        {
+            //! Number of VkDeviceMemory objects
+            uint32_t blockNum = 0;
+            //! Number of live allocations in the blocks
+            uint32_t allocationNum = 0;
+            //! Total size of the blocks
+            vk::DeviceSize reservedSize = 0;
+            //! Total size of the live allocations
+            vk::DeviceSize usedSize = 0;
+        };
+
+    public:
+        /**
+         * @brief  Constructor
+         *
+         * @param device vk2s device
+         */
+        explicit DeviceMemoryPool(vk2s::Device& device);
+
+        /**
+         * @brief  Destructor (free all blocks, every allocation must have been freed)
+         *
+         */
+        ~DeviceMemoryPool();
+
+        DeviceMemoryPool(const DeviceMemoryPool&)            = delete;
+        DeviceMemoryPool& operator=(const DeviceMemoryPool&) = delete;
+
+        /**
+         * @brief  Allocate memory satisfying the requirements of a resource
+         * @detail Throws std::runtime_error if no memory type fits or the device runs out of memory
+         *
+         * @param requirements Memory requirements of the resource
+         * @param usage Pool to allocate from
+         * @return Allocated range (the resource is bound at its offset)
+         */
+        Allocation allocate(const vk::MemoryRequirements& requirements, MemoryUsage usage);
+
+        /**
+         * @brief  Return the range to its block (the resource bound to it must already be destroyed)
+         *
+         * @param allocation Range returned by allocate()
+         */
+        void free(const Allocation& allocation);
+
+        /**
+         * @brief  Get the memory usage of the pool
+         *
+         * @param usage Pool
+         */
+        Stats getStats(MemoryUsage usage) const;
+
+    private:
+        /**
+         * @brief  One VkDeviceMemory and its free ranges
+         */
+        struct Block
+        {
+            vk::DeviceMemory memory;
+            vk::DeviceSize size      = 0;
+            uint32_t memoryTypeIndex = 0;
+            void* pMapped            = nullptr;
+            //! Freed when its allocation is freed
+            bool dedicated = false;
+            //! Offset -> size of each free range
+            std::map<vk::DeviceSize, vk::DeviceSize> freeRanges;
+            uint32_t allocationNum  = 0;
+            vk::DeviceSize usedSize = 0;
+        };
+
+        /**
+         * @brief  Find the memory type for the usage among the allowed types
+         *
+         * @param typeBits Allowed memory types (from the requirements of the resource)
+         * @param usage Intended use
+         */
+        uint32_t findMemoryType(uint32_t typeBits, MemoryUsage usage) const;
+
+        /**
+         * @brief  Allocate a new block
+         *
+         * @param size Size of the block
+         * @param memoryTypeIndex Memory type of the block
+         * @param usage Intended use (host-visible blocks are mapped)
+         * @param dedicated Whether the block holds a single resource
+         */
+        std::unique_ptr<Block> createBlock(vk::DeviceSize size, uint32_t memoryTypeIndex, MemoryUsage usage, bool dedicated);
+
+        /**
+         * @brief  Put the block into a free slot of the blocks of the usage (the slots of freed blocks are reused)
+         *
+         * @param usage Intended use of the block
+         * @param block Created block
+         * @return Index of the slot
+         */
+        uint32_t insertBlock(MemoryUsage usage, std::unique_ptr<Block> block);
+
+        /**
+         * @brief  Free the memory of the block and leave its slot empty
+         *
+         * @param block Slot of the block
+         */
+        void destroyBlock(std::unique_ptr<Block>& block);
+
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Memory types and heaps of the physical device
+        vk::PhysicalDeviceMemoryProperties mMemoryProperties;
+        //! Alignment keeping buffers and images in the same block apart (bufferImageGranularity)
+        vk::DeviceSize mGranularity = 1;
+        //! Blocks of each usage (freed blocks leave nullptr to keep the indices of the others, and the slot is reused)
+        std::array<std::vector<std::unique_ptr<Block>>, static_cast<size_t>(MemoryUsage::eUsageNum)> mBlocks;
+    };
+
+    /**
+     * @brief  VkBuffer bound to memory of DeviceMemoryPool
+     */
+    class PooledBuffer
+    {
+    public:
+        /**
+         * @brief  Constructor (create the buffer and bind it to pooled memory)
+         *
+         * @param device vk2s device
+         * @param pool Pool to allocate from
+         * @param ci Create info of the buffer
+         * @param usage Pool to allocate from
+         */
+        PooledBuffer(vk2s::Device& device, DeviceMemoryPool& pool, const vk::BufferCreateInfo& ci, MemoryUsage usage);
+
+        /**
+         * @brief  Destructor (destroy the buffer and return its memory)
+         *
+         */
+        ~PooledBuffer();
+
+        PooledBuffer(const PooledBuffer&)            = delete;
+        PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+        /**
+         * @brief  Get the Vulkan handle of the buffer
+         *
+         */
+        vk::Buffer getVkBuffer() const
+        {
+            return mBuffer;
+        }
+
+        /**
+         * @brief  Get the mapped address of the buffer (nullptr for eDeviceLocal)
+         *
+         */
+        void* getMappedPointer() const
+        {
+            return mAllocation.pMapped;
+        }
+
+        /**
+         * @brief  Get the size of the buffer
+         *
+         */
+        vk::DeviceSize getSize() const
+        {
+            return mSize;
+        }
+
+        /**
+         * @brief  Get the device address of the buffer (must be created with eShaderDeviceAddress)
+         *
+         */
+        vk::DeviceAddress getDeviceAddress() const;
+
+        /**
+         * @brief  Write the buffer to the binding of the bind group
+         *
+         * @param bindGroup Destination bind group
+         * @param binding Binding index
+         * @param type Descriptor type of the binding (e.g. eStorageBuffer)
+         * @param range Size read through the binding (the whole buffer by default, one block for dynamic bindings)
+         */
+        void bind(Handle<vk2s::BindGroup> bindGroup, uint32_t binding, vk::DescriptorType type, vk::DeviceSize range = VK_WHOLE_SIZE) const;
+
+        /**
+         * @brief  Copy data into the mapped buffer (eUpload or eReadback only)
+         *
+         * @param pData Source data
+         * @param size Size of the data in bytes
+         * @param offset Offset in the buffer
+         */
+        void write(const void* pData, size_t size, vk::DeviceSize offset = 0) const;
+
+    private:
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Reference to the pool of the memory
+        DeviceMemoryPool& mPool;
+        //! Buffer
+        vk::Buffer mBuffer;
+        //! Memory bound to the buffer
+        DeviceMemoryPool::Allocation mAllocation;
+        //! Size of the buffer
+        vk::DeviceSize mSize = 0;
+    };
+
+    /**
+     * @brief  VkImage (and its view) bound to memory of DeviceMemoryPool
+     * @detail An image can alias the memory of another one, so transient images whose lifetimes in a frame do not
+     *         overlap share one allocation (the contents are undefined after the other image is written)
+     */
+    class PooledImage
+    {
+    public:
+        /**
+         * @brief  Constructor (create the image and its view, and bind it to pooled memory)
+         *
+         * @param device vk2s device
+         * @param pool Pool to allocate from
+         * @param ci Create info of the image
+         * @param aspect Aspect of the view
+         */
+        PooledImage(vk2s::Device& device, DeviceMemoryPool& pool, const vk::ImageCreateInfo& ci, vk::ImageAspectFlags aspect);
+
+        /**
+         * @brief  Constructor (create the image and its view, and bind it to the memory of another image)
+         * @detail Throws std::runtime_error if the image does not fit in the memory of the aliased image,
+         *         which must outlive this image
+         *
+         * @param device vk2s device
+         * @param aliased Image whose memory is shared
+         * @param ci Create info of the image
+         * @param aspect Aspect of the view
+         */
+        PooledImage(vk2s::Device& device, const PooledImage& aliased, const vk::ImageCreateInfo& ci, vk::ImageAspectFlags aspect);
+
+        /**
+         * @brief  Destructor (destroy the image and return its memory unless it is an alias)
+         *
+         */
+        ~PooledImage();
+
+        PooledImage(const PooledImage&)            = delete;
+        PooledImage& operator=(const PooledImage&) = delete;
+
+        /**
+         * @brief  Get the Vulkan handle of the image
+         *
+         */
+        vk::Image getVkImage() const
+        {
+            return mImage;
+        }
+
+        /**
+         * @brief  Get the Vulkan handle of the view of the image
+         *
+         */
+        vk::ImageView getVkImageView() const
+        {
+            return mImageView;
+        }
+
+        /**
+         * @brief  Get the extent of the image
+         *
+         */
+        vk::Extent3D getVkExtent() const
+        {
+            return mExtent;
+        }
+
+        /**
+         * @brief  Write the view to the binding of the bind group
+         *
+         * @param bindGroup Destination bind group
+         * @param binding Binding index
+         * @param type Descriptor type of the binding (e.g. eStorageImage)
+         * @param layout Layout of the image when it is accessed through the binding
+         */
+        void bind(Handle<vk2s::BindGroup> bindGroup, uint32_t binding, vk::DescriptorType type, vk::ImageLayout layout) const;
+
+        /**
+         * @brief  Record a layout transition of the whole image (waits for all preceding commands)
+         *
+         * @param command Command to record to
+         * @param from Current layout
+         * @param to New layout
+         */
+        void recordTransition(Handle<vk2s::Command> command, vk::ImageLayout from, vk::ImageLayout to) const;
+
+    private:
+        /**
+         * @brief  Bind the image to mAllocation and create its view
+         *
+         * @param ci Create info of the image
+         * @param aspect Aspect of the view
+         */
+        void bindMemory(const vk::ImageCreateInfo& ci, vk::ImageAspectFlags aspect);
+
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Reference to the pool of the memory
+        DeviceMemoryPool& mPool;
+        //! Image
+        vk::Image mImage;
+        //! View of the whole image
+        vk::ImageView mImageView;
+        //! Memory bound to the image
+        DeviceMemoryPool::Allocation mAllocation;
+        //! Whole image (mip levels and layers)
+        vk::ImageSubresourceRange mSubresourceRange;
+        //! Whether the memory belongs to another image
+        bool mAlias = false;
+        //! Extent of the image
+        vk::Extent3D mExtent;
+    };
+}  // namespace palm
+
+#endif
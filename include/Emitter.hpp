@@ -11,8 +11,12 @@
 #include <vk2s/Device.hpp>
 #include <EC2S.hpp>
 #include <glm/glm.hpp>
-#include <omp.h>
 
+#include "DeviceMemoryPool.hpp"
+#include "EnvmapDistribution.hpp"
+
+#include <memory>
+#include <stdexcept>
 #include <utility>
 
 namespace palm
@@ -44,9 +48,12 @@ namespace palm
 
             //! Index of the Entity's mesh with this Emitter (only for area emitter)
             int32_t faceNum        = 0;
+            //! Index of the (shared) geometry
             int32_t meshIndex      = -1;
-            int32_t primitiveIndex = -1;
-            int32_t padding        = 0;
+            //! First face of this emitter in the emissive triangle table (only for area emitter)
+            int32_t firstTriangle  = -1;
+            //! Index of the instance (transform)
+            int32_t instanceIndex  = -1;
 
             //! The luminous component of this Emitter
             glm::vec3 emissive = glm::vec3(0.);
@@ -61,12 +68,20 @@ namespace palm
             return 0.299 * r + 0.587 * g + 0.114 * b;
         }
 
-        void buildPDFImage(vk2s::Device& device)
+        /**
+         * @brief  Build the distribution for importance sampling from the texels of emissiveTex (read back from the GPU)
+         * @detail Used when the texels are not on the host anymore (e.g. the envmap was loaded from a scene file),
+         *         emissiveTex must be in the general layout like all envmaps
+         *
+         * @param device vk2s device
+         * @param memoryPool Pool of the staging buffer for the readback
+         */
+        void buildDistribution(vk2s::Device& device, DeviceMemoryPool& memoryPool)
         {
             const auto extent = emissiveTex->getVkExtent();
             const auto format = emissiveTex->getVkFormat();
 
-            if (format != vk::Format::eR8G8B8A8Unorm)
+            if (!EnvmapDistribution::isSupportedFormat(format))
             {
                 throw std::runtime_error("invalid texture format for building PDF!");
             }
@@ -77,92 +92,29 @@ namespace palm
             const auto copyRegion = vk::BufferImageCopy().setBufferOffset(0).setBufferRowLength(0).setBufferImageHeight(0).setImageSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 }).setImageOffset({ 0, 0, 0 }).setImageExtent(extent);
 
             // create staging buffer
-            UniqueHandle<vk2s::Buffer> stagingBuffer = device.create<vk2s::Buffer>(vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferDst), vk::MemoryPropertyFlagBits::eHostVisible);
+            const PooledBuffer stagingBuffer(device, memoryPool, vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferDst), MemoryUsage::eReadback);
 
             UniqueHandle<vk2s::Fence> fence = device.create<vk2s::Fence>();
             fence->reset();
             UniqueHandle<vk2s::Command> cmd = device.create<vk2s::Command>();
             cmd->begin(true);
             cmd->transitionImageLayout(emissiveTex.get(), vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal);
-            cmd->copyImageToBuffer(emissiveTex.get(), stagingBuffer.get(), copyRegion);
+            cmd->getVkCommandBuffer()->copyImageToBuffer(emissiveTex->getVkImage().get(), vk::ImageLayout::eTransferSrcOptimal, stagingBuffer.getVkBuffer(), copyRegion);
+            cmd->transitionImageLayout(emissiveTex.get(), vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eGeneral);
+            cmd->end();
             cmd->execute(fence);
 
             fence->wait();
 
-            const std::uint8_t* p = reinterpret_cast<std::uint8_t*>(device.getVkDevice()->mapMemory(stagingBuffer->getVkDeviceMemory().get(), 0, size));
-
-            // step 1 : accumulate all pixel value
-            std::vector<double> sums(extent.height, 0);
-            {
-                omp_set_num_threads(omp_get_max_threads());
-#pragma omp parallel for
-                for (int h = 0; h < extent.height; ++h)  // int for OpenMP
-                {
-                    for (size_t w = 0; w < extent.width; ++w)
-                    {
-                        const size_t index = h * extent.width + w;
-                        sums[h] += toGray<double>(p[index * 4 + 0], p[index * 4 + 1], p[index * 4 + 2]);
-                    }
-                }
-            }
-
-            // step 2: calculate pdf from sum and each pixel value
-            std::vector<float> pdf(extent.width * extent.height, 0);
-            std::vector<float> cdf(extent.width * extent.height, 0);
-            {
-                omp_set_num_threads(omp_get_max_threads());
-#pragma omp parallel for
-                for (int h = 0; h < extent.height; ++h)  // int for OpenMP
-                {
-                    for (size_t w = 0; w < extent.width; ++w)
-                    {
-                        const size_t index = h * extent.width + w;
-                        pdf[index]         = toGray<double>(p[index * 4 + 0], p[index * 4 + 1], p[index * 4 + 2]) / sums[h];
-                    }
-                }
-            }
-
-            device.getVkDevice()->unmapMemory(stagingBuffer->getVkDeviceMemory().get());
-
-            // write pdf and cdf data to image
-            {
-                const auto pdfFormat = vk::Format::eR32Sfloat;
-                const uint32_t size  = extent.width * extent.height * vk2s::Compiler::getSizeOfFormat(pdfFormat);
-
-                vk::ImageCreateInfo ci;
-                ci.arrayLayers   = 1;
-                ci.extent        = vk::Extent3D(extent.width, extent.height, 1);
-                ci.format        = pdfFormat;
-                ci.imageType     = vk::ImageType::e2D;
-                ci.mipLevels     = 1;
-                ci.usage         = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eStorage;
-                ci.initialLayout = vk::ImageLayout::eUndefined;
-
-                pdfTex = device.create<vk2s::Image>(ci, vk::MemoryPropertyFlagBits::eDeviceLocal, size, vk::ImageAspectFlagBits::eColor);
-                cdfTex = device.create<vk2s::Image>(ci, vk::MemoryPropertyFlagBits::eDeviceLocal, size, vk::ImageAspectFlagBits::eColor);
-
-                pdfTex->write(pdf.data(), pdf.size() * vk2s::Compiler::getSizeOfFormat(pdfFormat));
-
-                fence->reset();
-                cmd->begin(true);
-                cmd->transitionImageLayout(emissiveTex.get(), vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eGeneral);
-                cmd->transitionImageLayout(pdfTex.get(), vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
-                cmd->transitionImageLayout(cdfTex.get(), vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
-                cmd->end();
-                cmd->execute(fence);
-
-                fence->wait();
-            }
+            distribution = std::make_shared<const EnvmapDistribution>(stagingBuffer.getMappedPointer(), format, extent.width, extent.height);
         }
 
         //! GPU Parameters
         Params params;
         //! Texture representing the distribution of emissive values
         Handle<vk2s::Image> emissiveTex;
-        //! Texture representing the pdf of emissive values
-        Handle<vk2s::Image> pdfTex;
-        //! Texture representing the cdf of emissive values
-        Handle<vk2s::Image> cdfTex;
+        //! Distribution of emissiveTex for importance sampling (only for infinite emitter, shared by the copies of the emitter)
+        std::shared_ptr<const EnvmapDistribution> distribution;
 
         //! Entity that has this Emitter
         std::optional<ec2s::Entity> attachedEntity;
@@ -0,0 +1,105 @@
+/*****************************************************************/ /**
+ * @file   EnvmapDistribution.hpp
+ * @brief  header file of EnvmapDistribution class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_ENVMAPDISTRIBUTION_HPP_
+#define PALM_INCLUDE_ENVMAPDISTRIBUTION_HPP_
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace palm
+{
+    /**
+     * @brief  Envmap image decoded on the host
+     */
+    struct DecodedEnvmap
+    {
+        uint32_t width  = 0;
+        uint32_t height = 0;
+        //! R32G32B32A32Sfloat for HDR images (.hdr), R8G8B8A8Unorm otherwise
+        vk::Format format = vk::Format::eR8G8B8A8Unorm;
+        //! Tightly packed texels
+        std::vector<uint8_t> texels;
+
+        /**
+         * @brief  Decode the envmap image (thread-safe, no device access)
+         *
+         * @param path Image path
+         * @return Decoded image (throws std::runtime_error if the image could not be decoded)
+         */
+        static DecodedEnvmap load(const std::filesystem::path& path);
+    };
+
+    /**
+     * @brief  2D piecewise-constant distribution of the envmap for importance sampling the infinite emitter
+     * @detail Each texel is weighted by its luminance and sin(theta) of its row (the area of the texel on the sphere),
+     *         and the marginal CDF over the rows and the conditional CDF of each row are flattened into one float array,
+     *         which is uploaded as is and sampled by EnvmapDistribution in Emitter.slang:
+     *         [0] width, [1] height (bits of uint32_t), [2, 2 + height] marginal CDF, then (width + 1) conditional CDF values per row.
+     *         The texel (u, v) maps to the direction (cos(2 pi u) sin(pi v), cos(pi v), sin(2 pi u) sin(pi v))
+     */
+    class EnvmapDistribution
+    {
+    public:
+        //! Number of the header elements before the CDFs
+        constexpr static uint32_t kHeaderSize = 2;
+
+    public:
+        /**
+         * @brief  Build the distribution (rows are processed in parallel)
+         *
+         * @param pTexels Texels of the envmap (tightly packed)
+         * @param format Format of the texels (see isSupportedFormat())
+         * @param width Width of the envmap
+         * @param height Height of the envmap
+         */
+        EnvmapDistribution(const void* pTexels, vk::Format format, uint32_t width, uint32_t height);
+
+        /**
+         * @brief  Whether the distribution can be built from the texels of the format
+         *
+         */
+        static bool isSupportedFormat(vk::Format format);
+
+        /**
+         * @brief  Get the flattened distribution passed to the GPU
+         *
+         */
+        std::span<const float> getData() const;
+
+        /**
+         * @brief  Get the data of the distribution with no texel, with which the shaders sample the sphere uniformly
+         *
+         */
+        static std::span<const float> getUniformData();
+
+        /**
+         * @brief  Get the average luminance of the envmap over the sphere (to estimate its power)
+         *
+         */
+        float getAverageLuminance() const;
+
+        uint32_t getWidth() const;
+        uint32_t getHeight() const;
+
+    private:
+        //! Width of the envmap
+        uint32_t mWidth;
+        //! Height of the envmap
+        uint32_t mHeight;
+        //! Average luminance over the sphere
+        float mAverageLuminance = 0.f;
+        //! Header, marginal and conditional CDFs
+        std::vector<float> mData;
+    };
+}  // namespace palm
+
+#endif
@@ -0,0 +1,137 @@
+/*****************************************************************/ /**
+ * @file   FrameRing.hpp
+ * @brief  header file of FrameRing class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_FRAMERING_HPP_
+#define PALM_INCLUDE_FRAMERING_HPP_
+
+#include "DeviceMemoryPool.hpp"
+
+#include <vk2s/Device.hpp>
+
+#include <cstdint>
+
+namespace palm
+{
+    /**
+     * @brief  Linear allocator of per-frame uniform data on one persistently mapped buffer
+     * @detail The buffer is split into one region per frame in flight. Data of a frame are bump-allocated
+     *         from its region and addressed by dynamic offsets, and the region is reset by begin()
+     *         once the fence of that frame has signaled, so no per-object buffers or bind groups are needed
+     */
+    class FrameRing
+    {
+    public:
+        //! Alignment of allocations (the upper limit of minUniformBufferOffsetAlignment allowed by the specification)
+        constexpr static vk::DeviceSize kAlignment = 256;
+
+    public:
+        /**
+         * @brief  Constructor (create and map the buffer)
+         *
+         * @param device vk2s device
+         * @param memoryPool Pool of the buffer (eUpload memory is persistently mapped)
+         * @param regionSize Size of the region of each frame
+         * @param frameCount Number of frames in flight
+         */
+        FrameRing(vk2s::Device& device, DeviceMemoryPool& memoryPool, vk::DeviceSize regionSize, uint32_t frameCount);
+
+        FrameRing(const FrameRing&)            = delete;
+        FrameRing& operator=(const FrameRing&) = delete;
+
+        /**
+         * @brief  Start allocating from the region of the frame (the GPU must have finished the previous use of it)
+         *
+         * @param frameIndex Index of the frame in flight
+         */
+        void begin(uint32_t frameIndex);
+
+        /**
+         * @brief  Allocate a part of the region of the current frame
+         * @detail Throws std::runtime_error if the region is exhausted
+         *
+         * @param size Size in bytes
+         * @param ppMapped Receives the mapped address of the allocation
+         * @return Offset in the buffer (to be passed as a dynamic offset)
+         */
+        uint32_t allocate(vk::DeviceSize size, void** ppMapped);
+
+        /**
+         * @brief  Allocate and write the data
+         *
+         * @param pData Data to be written
+         * @param size Size of the data in bytes
+         * @return Offset in the buffer (to be passed as a dynamic offset)
+         */
+        uint32_t push(const void* pData, vk::DeviceSize size);
+
+        /**
+         * @brief  Allocate and write the value
+         *
+         * @param value Value to be written
+         * @return Offset in the buffer (to be passed as a dynamic offset)
+         */
+        template <typename T>
+        uint32_t push(const T& value)
+        {
+            return push(&value, sizeof(T));
+        }
+
+        /**
+         * @brief  Write the buffer to the binding of the bind group as eUniformBufferDynamic
+         *
+         * @param bindGroup Destination bind group
+         * @param binding Binding index
+         * @param range Size of the data read through the binding
+         */
+        void bind(Handle<vk2s::BindGroup> bindGroup, uint32_t binding, vk::DeviceSize range) const;
+
+        /**
+         * @brief  Get the bytes allocated in the current frame
+         *
+         */
+        vk::DeviceSize getUsedSize() const
+        {
+            return mHead;
+        }
+
+        /**
+         * @brief  Get the largest bytes allocated in a frame so far
+         *
+         */
+        vk::DeviceSize getPeakSize() const
+        {
+            return mPeak;
+        }
+
+        /**
+         * @brief  Get the size of the region of each frame
+         *
+         */
+        vk::DeviceSize getRegionSize() const
+        {
+            return mRegionSize;
+        }
+
+    private:
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Size of the region of each frame
+        vk::DeviceSize mRegionSize = 0;
+        //! Buffer of all regions (host-visible, mapped while this object lives)
+        PooledBuffer mBuffer;
+        //! Mapped address of the buffer
+        std::uint8_t* mpMapped = nullptr;
+        //! Offset of the region of the current frame
+        vk::DeviceSize mRegionOffset = 0;
+        //! Bytes allocated in the current frame
+        vk::DeviceSize mHead = 0;
+        //! Largest bytes allocated in a frame
+        vk::DeviceSize mPeak = 0;
+    };
+}  // namespace palm
+
+#endif
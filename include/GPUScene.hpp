@@ -0,0 +1,325 @@
+/*****************************************************************/ /**
+ * @file   GPUScene.hpp
+ * @brief  header file of GPUScene class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_GPUSCENE_HPP_
+#define PALM_INCLUDE_GPUSCENE_HPP_
+
+#include <vk2s/Device.hpp>
+
+#include <EC2S.hpp>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "DeviceMemoryPool.hpp"
+#include "Emitter.hpp"
+#include "LightBVH.hpp"
+#include "Material.hpp"
+#include "TLAS.hpp"
+
+namespace palm
+{
+    class MeshPool;
+
+    /**
+     * @brief  GPU-ready copy of the scene shared by all integrators (TLAS, instances, geometries, materials, emitters and textures)
+     * @detail The registry is flattened once into arrays indexed by stable indices (the instance index is also the index of the TLAS instance and the material),
+     *         and kept in CommonRegion so that switching or adding integrators binds the same buffers without uploading the scene again.
+     *         Edits are applied in place by applyDelta(), and the scene must be recreated only if its structure changes
+     */
+    class GPUScene
+    {
+    public:
+        /**
+         * @brief  Entities whose components were edited since the last frame
+         * @detail Passed to applyDelta() so that only the affected GPU data is rewritten
+         */
+        struct SceneDelta
+        {
+            //! Entities whose Transform was changed
+            std::vector<ec2s::Entity> transforms;
+            //! Entities whose Material was changed
+            std::vector<ec2s::Entity> materials;
+            //! Entities whose Emitter was changed
+            std::vector<ec2s::Entity> emitters;
+
+            bool empty() const
+            {
+                return transforms.empty() && materials.empty() && emitters.empty();
+            }
+
+            void clear()
+            {
+                transforms.clear();
+                materials.clear();
+                emitters.clear();
+            }
+        };
+
+    public:
+        /**
+         * @brief  Constructor (flattens the scene and uploads it)
+         *
+         * @param device vk2s device
+         * @param scene Scene to be flattened
+         * @param meshPool Pool owning the global vertex and index buffers of the scene
+         */
+        GPUScene(vk2s::Device& device, ec2s::Registry& scene, MeshPool& meshPool);
+
+        /**
+         * @brief  Destructor
+         *
+         */
+        ~GPUScene();
+
+        // non-copyable
+        GPUScene(const GPUScene&)            = delete;
+        GPUScene& operator=(const GPUScene&) = delete;
+
+        /**
+         * @brief  Apply edits of the scene in place
+         * @detail Only the changed ranges of the instance, material and emitter buffers are rewritten, the light BVH is refit on the CPU and the TLAS in the next recordUpdate().
+         *         Must be called while the GPU is not using the scene resources
+         *
+         * @param delta Edited entities
+         * @return false if the structure of the scene has changed (e.g. an emitter was added) and the scene must be recreated
+         */
+        bool applyDelta(const SceneDelta& delta);
+
+        /**
+         * @brief  Bind the scene resources to the common bindings (0: TLAS, 4-11: vertices, indices, instances, materials, emitters, textures, sampler, geometries, 15: envmap distribution, 16: emitter alias table, 17: first emitter of each instance, 18-19: light BVH nodes and trails, 20: emissive triangles)
+         *
+         * @param bindGroup Destination bind group
+         */
+        void bind(Handle<vk2s::BindGroup> bindGroup);
+
+        /**
+         * @brief  Record the copies of edited scene data and the TLAS refit if any instance has moved (call before tracing rays)
+         *
+         * @param command Command buffer to write instructions
+         */
+        void recordUpdate(Handle<vk2s::Command> command);
+
+        /**
+         * @brief  Get the number of all emitters (an area emitter counts its faces)
+         *
+         */
+        uint32_t getEmitterNum() const;
+
+        /**
+         * @brief  Get the number of the textures bound to the texture table (at least one)
+         *
+         */
+        uint32_t getTextureNum() const;
+
+        /**
+         * @brief  Get the device memory pool shared by the scene buffers (integrators suballocate their buffers from it)
+         *
+         */
+        DeviceMemoryPool& getMemoryPool() const;
+
+    private:
+        /**
+         * @brief  Parameters per instance (passed to the GPU)
+         */
+        struct InstanceParams
+        {
+            glm::mat4 world;
+            glm::mat4 worldInvTrans;
+        };
+
+        /**
+         * @brief  Range of a geometry in the global vertex and index buffers (passed to the GPU, indexed by instanceCustomIndex)
+         */
+        struct GeometryParams
+        {
+            //! Vertices are Mesh::CompactVertex
+            constexpr static uint32_t kCompactVertexFlag = 1u << 0;
+            //! Indices are 16 bit (two per word)
+            constexpr static uint32_t kIndex16Flag = 1u << 1;
+
+            uint32_t firstVertex;
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            uint32_t flags;
+        };
+
+        /**
+         * @brief  Face of an area emitter (passed to the GPU, refers to its emitter instead of copying Emitter::Params per face)
+         * @detail Sampled emitters are indexed as the entries of the emitter buffer followed by the entries of this table
+         */
+        struct EmissiveTriangle
+        {
+            //! Index of the area emitter in the emitter buffer (geometry, instance and emissive)
+            uint32_t emitterIndex;
+            //! Face in the geometry
+            uint32_t primitiveIndex;
+            //! World-space area
+            float area;
+            //! Estimated power (weight of emitter sampling)
+            float power;
+        };
+
+        /**
+         * @brief  Transform and emissive from which the faces of an area emitter were computed
+         */
+        struct EmissiveSource
+        {
+            //! Metric of the linear part of the world matrix (transpose(L) * L, invariant under rotations)
+            glm::mat3 metric;
+            //! Radiance of the faces
+            float radiance;
+        };
+
+        /**
+         * @brief  Create the dummy texture bound if the scene has no texture
+         *
+         */
+        void createDummyTexture();
+
+        /**
+         * @brief  Queue the write of a part of a device-local buffer (recorded by the next recordUpdate())
+         * @detail Writes larger than kMaxInlineWriteSize are copied from a staging buffer instead of vkCmdUpdateBuffer
+         *
+         * @param buffer Destination buffer
+         * @param pData Source data (copied here)
+         * @param size Size of the data (multiple of 4)
+         * @param offset Offset in the buffer (multiple of 4)
+         */
+        void queueBufferWrite(vk::Buffer buffer, const void* pData, size_t size, size_t offset);
+
+        /**
+         * @brief  Rewrite the emitter entry of the entity and its faces (the type and the number of faces must be unchanged)
+         *
+         * @param entity Entity with Emitter
+         * @return false if the entries cannot be rewritten in place
+         */
+        bool updateEmitter(ec2s::Entity entity);
+
+        /**
+         * @brief  Recompute the world-space area and power of the faces of the area emitter (host copy only)
+         * @detail The faces are left untouched if the metric of the world matrix and the radiance are unchanged,
+         *         because translations and rotations never change the area of a face
+         *
+         * @param params Area emitter with its faces in the emissive triangle table
+         * @param world World matrix of the emitter
+         * @return Number of the faces rewritten (0 if they are unchanged)
+         */
+        uint32_t updateEmissiveTriangles(const Emitter::Params& params, const glm::mat4& world);
+
+        /**
+         * @brief  Estimate the power of each sampled emitter from the current scene (weights of the emitter alias table)
+         *
+         * @return Power of the entries of the emitter buffer followed by the emissive triangles (area emitters themselves have none)
+         */
+        std::vector<float> computeEmitterPowers() const;
+
+        /**
+         * @brief  Compute the bounds of each sampled emitter for the light BVH (the infinite emitter is not bounded)
+         *
+         * @param powers Power of each sampled emitter (computeEmitterPowers())
+         * @return Bounds of each sampled emitter (without power if it is not put in the tree)
+         */
+        std::vector<LightBVH::LightBounds> computeEmitterBounds(std::span<const float> powers) const;
+
+        /**
+         * @brief  Add the image to the texture table unless it is already there
+         *
+         * @param image Texture image
+         * @return Index of the image in the texture table
+         */
+        int32_t registerTexture(Handle<vk2s::Image> image);
+
+        /**
+         * @brief  Get the parameters of the material with the indices of its textures in the texture table
+         *
+         * @param mat Material
+         * @param registerNew Whether textures not in the table are added (only while flattening the scene)
+         * @return Parameters to be passed to the GPU (nullopt if a texture is not in the table)
+         */
+        std::optional<Material::Params> resolveTextureIndices(const Material& mat, bool registerNew);
+
+    private:
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Reference to scene
+        ec2s::Registry& mScene;
+        //! Reference to the geometry pool (owner of the global vertex and index buffers)
+        MeshPool& mMeshPool;
+
+        //! Texture bound if the scene has no texture
+        UniqueHandle<vk2s::Image> mDummyTexture;
+
+        //! Number of all emitters (an area emitter counts its faces)
+        uint32_t mEmitterNum = 0;
+
+        //! TLAS (refit when transforms are changed)
+        std::unique_ptr<TLAS> mTLAS;
+        //! Light BVH over the bounded emitters (refit when emitters are changed)
+        std::unique_ptr<LightBVH> mLightBVH;
+
+        // scene resources (suballocated from the memory pool of the mesh pool)
+        std::unique_ptr<PooledBuffer> mInstanceBuffer;
+        std::unique_ptr<PooledBuffer> mMaterialBuffer;
+        std::unique_ptr<PooledBuffer> mEmittersBuffer;
+        std::unique_ptr<PooledBuffer> mGeometryBuffer;
+        std::unique_ptr<PooledBuffer> mEnvmapDistributionBuffer;
+        std::unique_ptr<PooledBuffer> mEmitterAliasBuffer;
+        std::unique_ptr<PooledBuffer> mInstanceEmitterBuffer;
+        std::unique_ptr<PooledBuffer> mLightBVHBuffer;
+        std::unique_ptr<PooledBuffer> mLightBVHTrailBuffer;
+        std::unique_ptr<PooledBuffer> mEmissiveTriangleBuffer;
+        UniqueHandle<vk2s::Sampler> mSampler;
+
+        // WARN: textures have no ownership
+        std::vector<Handle<vk2s::Image>> mTextures;
+
+        //! Entity -> index of instance (TLAS instance, instance buffer and material buffer)
+        std::unordered_map<ec2s::Entity, uint32_t> mInstanceIndices;
+        //! Image -> index in the texture table (textures shared by materials are bound once)
+        std::unordered_map<VkImage, int32_t> mTextureIndices;
+        //! Entity -> index in the emitter buffer
+        std::unordered_map<ec2s::Entity, uint32_t> mEmitterIndices;
+        //! Host copy of the emitter buffer (one entry per emitter)
+        std::vector<Emitter::Params> mEmitterParams;
+        //! Host copy of the emissive triangle table (faces of each area emitter are consecutive)
+        std::vector<EmissiveTriangle> mEmissiveTriangles;
+        //! Index of geometry -> object-space positions of its faces (three per face, only for area emitters)
+        std::unordered_map<int32_t, std::vector<glm::vec3>> mEmissiveFaces;
+        //! Power of each sampled emitter from which the emitter alias table was built
+        std::vector<float> mEmitterPowers;
+        //! First triangle of each area emitter -> source of the area and power of its faces
+        std::unordered_map<int32_t, EmissiveSource> mEmissiveSources;
+
+        /**
+         * @brief  Write to a scene buffer waiting for the next frame
+         */
+        struct PendingWrite
+        {
+            vk::Buffer buffer;
+            size_t offset;
+            //! Data written inline (empty if staged)
+            std::vector<std::uint8_t> data;
+            //! Staging buffer holding the data of a large write
+            std::unique_ptr<PooledBuffer> staging;
+        };
+
+        //! Upper limit of the size of one vkCmdUpdateBuffer (larger writes are staged)
+        constexpr static size_t kMaxInlineWriteSize = 65536;
+        //! Writes not recorded yet
+        std::vector<PendingWrite> mPendingWrites;
+        //! Staging buffers of the copies recorded by the last recordUpdate() (released when the GPU is idle)
+        std::vector<std::unique_ptr<PooledBuffer>> mRetiredStagingBuffers;
+    };
+}  // namespace palm
+
+#endif
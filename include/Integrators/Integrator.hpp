@@ -13,6 +13,10 @@
 
 #include <EC2S.hpp>
 
+#include <glm/glm.hpp>
+
+#include "../GPUScene.hpp"
+
 namespace palm
 {
     /**
@@ -20,15 +24,20 @@ namespace palm
      */
     class Integrator
     {
+    public:
+        //! Entities whose components were edited since the last frame
+        using SceneDelta = GPUScene::SceneDelta;
+
     public:
         /** 
          * @brief  Constructor
          *  
          * @param device vk2s device
          * @param scene Scene to be rendered
+         * @param gpuScene GPU resources of the scene shared by all integrators
          * @param outputImage Image to which the drawing result (current progress) for each frame is written
          */
-        Integrator(vk2s::Device& device, ec2s::Registry& scene, Handle<vk2s::Image> outputImage);
+        Integrator(vk2s::Device& device, ec2s::Registry& scene, GPUScene& gpuScene, Handle<vk2s::Image> outputImage);
 
         /** 
          * @brief  destructor (virtual)
@@ -57,17 +66,26 @@ namespace palm
          */
         virtual void sample(Handle<vk2s::Command> command) = 0;
 
+        /** 
+         * @brief  Apply edits of the scene without rebuilding the integrator
+         * @detail The edits are applied to the shared GPUScene, and the TLAS is refit in the next sample().
+         *         Must be called while the GPU is not using the scene resources (same as updateShaderResources())
+         *  
+         * @param delta Edited entities
+         * @return false if the structure of the scene has changed (e.g. an emitter was added) and the GPUScene and the integrator must be recreated
+         */
+        virtual bool applySceneDelta(const SceneDelta& delta);
+
     protected:
         //! Reference to vk2s device
         vk2s::Device& mDevice;
         //! Reference to scene
         ec2s::Registry& mScene;
+        //! Reference to the GPU resources of the scene (TLAS, instances, materials, emitters and textures)
+        GPUScene& mGPUScene;
 
         //! Handle of output destination image
         Handle<vk2s::Image> mOutputImage;
-
-        //! Handle of dummy texture
-        Handle<vk2s::Image> mDummyTexture;
     };
 }  // namespace palm
 
@@ -26,11 +26,12 @@ namespace palm
             int spp            = 1;
             int accumulatedSpp = 0;
             int maxBounces     = 16;  // max bounces for path tracing
+            bool lightBVH      = true;  // select emitters with the light BVH (otherwise the alias table)
         };
 
 
     public:
-        PathIntegrator(vk2s::Device& device, ec2s::Registry& scene, Handle<vk2s::Image> output);
+        PathIntegrator(vk2s::Device& device, ec2s::Registry& scene, GPUScene& gpuScene, Handle<vk2s::Image> output);
 
         virtual ~PathIntegrator() override;
 
@@ -40,6 +41,8 @@ namespace palm
 
         virtual void sample(Handle<vk2s::Command> command) override;
 
+        virtual bool applySceneDelta(const SceneDelta& delta) override;
+
         GUIParams& getGUIParamsRef();
 
     private:
@@ -63,35 +66,19 @@ namespace palm
             uint32_t accumulatedSpp;
             uint32_t allEmitterNum;
             uint32_t maxBounces;
-        };
 
-        struct InstanceParams
-        {
-            glm::mat4 world;
-            glm::mat4 worldInvTrans;
+            uint32_t lightBVH;
+            uint32_t padding[3];
         };
 
         GUIParams mGUIParams;
-        uint32_t mEmitterNum;
-
-        // TLAS
-        UniqueHandle<vk2s::AccelerationStructure> mTLAS;
 
         UniqueHandle<vk2s::Image> mEnvmapPDFImage;
 
         // shader resources
-        UniqueHandle<vk2s::Buffer> mSceneBuffer;
-        UniqueHandle<vk2s::Buffer> mInstanceBuffer;
-        UniqueHandle<vk2s::Buffer> mMaterialBuffer;
+        std::unique_ptr<PooledBuffer> mSceneBuffer;
         UniqueHandle<vk2s::Buffer> mSampleBuffer;
-        UniqueHandle<vk2s::Buffer> mEmittersBuffer;
-        UniqueHandle<vk2s::Image> mPoolImage;
-        UniqueHandle<vk2s::Sampler> mSampler;
-
-        // WARN: VB, IB and textures have no ownership
-        std::vector<Handle<vk2s::Buffer>> mVertexBuffers;
-        std::vector<Handle<vk2s::Buffer>> mIndexBuffers;
-        std::vector<Handle<vk2s::Image>> mTextures;
+        std::unique_ptr<PooledImage> mPoolImage;
 
         // binding
         Handle<vk2s::BindLayout> mBindLayout;
@@ -0,0 +1,135 @@
+/*****************************************************************/ /**
+ * @file   LightBVH.hpp
+ * @brief  header file of LightBVH class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_LIGHTBVH_HPP_
+#define PALM_INCLUDE_LIGHTBVH_HPP_
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace palm
+{
+    /**
+     * @brief  Hierarchy of the bounded emitters for many-light sampling
+     * @detail Each node bounds the positions, the power and the emitted directions (orientation cone) of its emitters,
+     *         and the shaders descend from the root choosing a child in proportion to its importance to the shading point
+     *         (Conty Estevez and Kulla, "Importance Sampling of Many Lights with Adaptive Tree Splitting", and pbrt-v4).
+     *         Nodes are flattened in depth-first order (the first child follows its parent),
+     *         and the path from the root to each emitter is kept as a bit trail to evaluate the pdf of an emitter hit by BSDF sampling
+     */
+    class LightBVH
+    {
+    public:
+        /**
+         * @brief  Spatial and directional bounds of emitters
+         */
+        struct LightBounds
+        {
+            glm::vec3 boundsMin = glm::vec3(0.f);
+            glm::vec3 boundsMax = glm::vec3(0.f);
+            //! Power (emitters without power are not added to the tree)
+            float phi = 0.f;
+            //! Axis of the orientation cone
+            glm::vec3 axis = glm::vec3(0.f, 0.f, 1.f);
+            //! Cosine of the spread of the normals around the axis
+            float cosThetaO = 1.f;
+            //! Cosine of the spread of the emission around the normals
+            float cosThetaE = 0.f;
+            //! Emits to both sides of the normals
+            bool twoSided = false;
+        };
+
+        /**
+         * @brief  Node of the tree (passed to the GPU, must always be kept in sync with shader side)
+         */
+        struct Node  // std430
+        {
+            glm::vec3 boundsMin;
+            float phi;
+            glm::vec3 boundsMax;
+            float cosThetaO;
+            glm::vec3 axis;
+            float cosThetaE;
+            //! Index of the second child (interior) or the emitter (leaf)
+            uint32_t child;
+            //! kLeafFlag | kTwoSidedFlag
+            uint32_t flags;
+            uint32_t padding[2];
+        };
+
+        constexpr static uint32_t kLeafFlag     = 1u << 0;
+        constexpr static uint32_t kTwoSidedFlag = 1u << 1;
+        //! Bit trail of the emitters not in the tree (the depth is kept under 63)
+        constexpr static uint64_t kNotInTree = 1ull << 63;
+
+    public:
+        /**
+         * @brief  Build the tree (splits are chosen by the surface area orientation heuristic)
+         *
+         * @param lights Bounds of each emitter (the index is referred to by the leaves)
+         */
+        explicit LightBVH(std::span<const LightBounds> lights);
+
+        /**
+         * @brief  Get the flattened nodes (a root without power if no emitter is in the tree)
+         *
+         */
+        const std::vector<Node>& getNodes() const;
+
+        /**
+         * @brief  Get the bit trail of each emitter (bit i selects the second child at depth i, kNotInTree if not in the tree)
+         *
+         */
+        const std::vector<uint64_t>& getTrails() const;
+
+        /**
+         * @brief  Refit the tree to new bounds of the same emitters (the topology and the bit trails are kept)
+         * @detail Bounds, power and cones are recomputed bottom-up, which is much cheaper than building the tree again
+         *         but the quality of the tree degrades if emitters move far
+         *
+         * @param lights Bounds of each emitter (same number as the tree was built with)
+         * @return false if an emitter enters or leaves the tree (it must be built again)
+         */
+        bool refit(std::span<const LightBounds> lights);
+
+        /**
+         * @brief  Get the range [first, second) of the nodes changed by the last refit() (all nodes after building)
+         *
+         */
+        std::pair<uint32_t, uint32_t> getDirtyRange() const;
+
+    private:
+        /**
+         * @brief  Build the subtree of the range of mIndices
+         *
+         * @param begin First of the range
+         * @param end End of the range
+         * @param trail Bit trail to the root of the subtree
+         * @param depth Depth of the root of the subtree
+         * @return Index of the root node
+         */
+        uint32_t build(size_t begin, size_t end, uint64_t trail, uint32_t depth);
+
+        //! Bounds of each emitter
+        std::span<const LightBounds> mLights;
+        //! Indices of the emitters in the tree (partitioned while building)
+        std::vector<uint32_t> mIndices;
+        //! Flattened nodes
+        std::vector<Node> mNodes;
+        //! Bit trail of each emitter
+        std::vector<uint64_t> mTrails;
+        //! Range of the nodes changed by the last build or refit
+        uint32_t mDirtyBegin = 0;
+        uint32_t mDirtyEnd   = 0;
+    };
+}  // namespace palm
+
+#endif
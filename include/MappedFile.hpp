@@ -0,0 +1,101 @@
+/*****************************************************************/ /**
+ * @file   MappedFile.hpp
+ * @brief  header file of MappedFile class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_MAPPEDFILE_HPP_
+#define PALM_INCLUDE_MAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <filesystem>
+
+namespace palm
+{
+    /**
+     * @brief  Read-only memory-mapped file
+     * @detail The contents are paged in by the OS on access, so large files can be read without copying into user buffers
+     */
+    class MappedFile
+    {
+    public:
+        /**
+         * @brief  Default constructor (not mapped)
+         *
+         */
+        MappedFile() = default;
+
+        /**
+         * @brief  Map the whole file (throws std::runtime_error if failed)
+         *
+         * @param path File to be mapped
+         */
+        explicit MappedFile(const std::filesystem::path& path);
+
+        /**
+         * @brief  Destructor (unmap the file)
+         *
+         */
+        ~MappedFile();
+
+        MappedFile(const MappedFile&)            = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        /**
+         * @brief  Get the head of the mapped contents
+         *
+         * @return Pointer to the contents (nullptr if not mapped)
+         */
+        const std::byte* data() const
+        {
+            return mpData;
+        }
+
+        /**
+         * @brief  Get the size of the mapped contents
+         *
+         * @return Size in bytes
+         */
+        size_t size() const
+        {
+            return mSize;
+        }
+
+        /**
+         * @brief  Whether the file is mapped
+         *
+         */
+        bool isMapped() const
+        {
+            return mpData != nullptr;
+        }
+
+    private:
+        /**
+         * @brief  Unmap the file and close the handles
+         *
+         */
+        void close();
+
+        //! Head of the mapped contents
+        const std::byte* mpData = nullptr;
+        //! Size of the mapped contents
+        size_t mSize = 0;
+
+#ifdef _WIN32
+        //! File handle
+        void* mFileHandle = nullptr;
+        //! File mapping object handle
+        void* mMappingHandle = nullptr;
+#else
+        //! File descriptor
+        int mFileDescriptor = -1;
+#endif
+    };
+}  // namespace palm
+
+#endif
@@ -81,11 +81,12 @@ namespace palm
             //! Index of Refraction (for transparent scattering)
             float IOR            = 1.0;
 
-            //! each texture index
+            //! each texture index (roughness and metallic above are multiplied by G and B of the ORM texture)
             int32_t albedoTexIndex    = kInvalidTexIndex;
-            int32_t roughnessTexIndex = kInvalidTexIndex;
-            int32_t metalnessTexIndex = kInvalidTexIndex;
+            int32_t ormTexIndex       = kInvalidTexIndex;
             int32_t normalMapTexIndex = kInvalidTexIndex;
+            //! padding
+            int32_t texPadding        = 0;
 
             //! Emissive component of the material (usually used with emitters)
             glm::vec3 emissive   = glm::vec3(0.0);
@@ -155,17 +156,14 @@ namespace palm
 
         //! Parameters
         Params params;
-        //! Handle to uniform buffer with parameters written (for rasterization)
-        Handle<vk2s::DynamicBuffer> uniformBuffer;
 
         //! Number of textures to use (constant)
-        constexpr static uint32_t kDefaultTexNum = 4;
+        constexpr static uint32_t kDefaultTexNum = 3;
         Handle<vk2s::Image> albedoTex;
-        Handle<vk2s::Image> roughnessTex;
-        Handle<vk2s::Image> metalnessTex;
+        //! Occlusion, roughness and metalness packed into RGB (occlusion is not used by the integrators)
+        Handle<vk2s::Image> ormTex;
+        //! Tangent space normal in RG (z is reconstructed)
         Handle<vk2s::Image> normalMapTex;
-
-        Handle<vk2s::BindGroup> bindGroup;
     };
 }  // namespace palm
 
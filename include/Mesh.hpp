@@ -9,10 +9,57 @@
 #define PALM_INCLUDE_MESH_HPP_
 
 #include <vk2s/Device.hpp>
-#include <vk2s/Scene.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <memory>
 
 namespace palm
 {
+    class BLAS;
+
+    /**
+     * @brief  Format of vertices stored in the global vertex buffer
+     */
+    enum class VertexFormat : uint32_t
+    {
+        //! Mesh::Vertex (32 bytes)
+        eFull,
+        //! Mesh::CompactVertex (20 bytes, octahedral normal and half UV)
+        eCompact,
+    };
+
+    /**
+     * @brief  GPU resources of a mesh shared by all entities with the same geometry (managed by MeshPool)
+     * @detail Vertices and indices are sub-allocated from the global buffers of MeshPool,
+     *         and the ranges and BLAS are released when the last Mesh referring to this geometry is destroyed
+     */
+    struct MeshGeometry
+    {
+        //! Content hash of vertices and indices (key in MeshPool)
+        uint64_t hash = 0;
+        //! Number of vertices
+        uint32_t vertexCount = 0;
+        //! Number of indices (3 per face)
+        uint32_t indexCount = 0;
+        //! Object-space bounding box
+        glm::vec3 aabbMin = glm::vec3(0.0);
+        glm::vec3 aabbMax = glm::vec3(0.0);
+
+        //! Offset of the first vertex in the global vertex buffer of MeshPool
+        uint32_t firstVertex = 0;
+        //! Offset of the first index in the global index buffer of MeshPool, in 32 bit words (indices are relative to firstVertex)
+        uint32_t firstIndex = 0;
+        //! Format of the vertices
+        VertexFormat vertexFormat = VertexFormat::eFull;
+        //! Type of the indices (eUint16 packs two indices into a word)
+        vk::IndexType indexType = vk::IndexType::eUint32;
+
+        //! Compacted BLAS (built by BLASBuilder)
+        std::shared_ptr<BLAS> blas;
+    };
+
     /**
      * @brief  Struct representing mesh 
      */
@@ -34,13 +81,64 @@ namespace palm
             float v;
         };
 
-        //! CPU-side mesh information obtained from vk2s loader
-        vk2s::Mesh hostMesh;
-        
-        Handle<vk2s::Buffer> vertexBuffer;
-        Handle<vk2s::Buffer> indexBuffer;
+        /**
+         * @brief  Quantized vertex (VertexFormat::eCompact)
+         * @detail Position is kept in full precision since it is also the input of BLAS builds,
+         *         normal is octahedral-encoded into 2 x snorm16 and UV is stored as 2 x half
+         */
+        struct CompactVertex
+        {
+            //! Position
+            glm::vec3 pos;
+            //! Octahedral-encoded normal (2 x snorm16)
+            uint32_t normal;
+            //! UV (2 x half)
+            uint32_t uv;
+
+            /**
+             * @brief  Quantize the vertex
+             *
+             * @param vertex Source vertex
+             */
+            static CompactVertex encode(const Vertex& vertex)
+            {
+                // project onto the octahedron and fold the lower hemisphere
+                const glm::vec3 n = vertex.normal / (std::abs(vertex.normal.x) + std::abs(vertex.normal.y) + std::abs(vertex.normal.z) + 1e-12f);
+                glm::vec2 oct     = glm::vec2(n.x, n.y);
+                if (n.z < 0.f)
+                {
+                    const glm::vec2 signs = glm::vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+                    oct                   = (1.f - glm::abs(glm::vec2(n.y, n.x))) * signs;
+                }
+
+                CompactVertex ret;
+                ret.pos    = vertex.pos;
+                ret.normal = glm::packSnorm2x16(oct);
+                ret.uv     = glm::packHalf2x16(glm::vec2(vertex.u, vertex.v));
+
+                return ret;
+            }
+
+            /**
+             * @brief  Restore the vertex (normal and UV lose precision)
+             *
+             */
+            Vertex decode() const
+            {
+                const glm::vec2 oct = glm::unpackSnorm2x16(normal);
+                glm::vec3 n         = glm::vec3(oct.x, oct.y, 1.f - std::abs(oct.x) - std::abs(oct.y));
+                const float t       = glm::clamp(-n.z, 0.f, 1.f);
+                n.x += n.x >= 0.f ? -t : t;
+                n.y += n.y >= 0.f ? -t : t;
+
+                const glm::vec2 texcoord = glm::unpackHalf2x16(uv);
+
+                return Vertex{ .pos = pos, .u = texcoord.x, .normal = glm::normalize(n), .v = texcoord.y };
+            }
+        };
 
-        Handle<vk2s::AccelerationStructure> blas;
+        //! Geometry (shared by the instances of the same mesh)
+        std::shared_ptr<MeshGeometry> geometry;
         //! Uniform buffer for writing instance information (for rasterization)
         Handle<vk2s::Buffer> instanceBuffer;
     };
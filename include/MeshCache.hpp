@@ -0,0 +1,212 @@
+/*****************************************************************/ /**
+ * @file   MeshCache.hpp
+ * @brief  header file of MeshCache and CompiledModel classes
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_MESHCACHE_HPP_
+#define PALM_INCLUDE_MESHCACHE_HPP_
+
+#include "MappedFile.hpp"
+#include "Mesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace palm
+{
+    /**
+     * @brief  3D model compiled into the layout used at runtime (the contents of a mesh cache file)
+     * @detail All sections are placed at 16 byte aligned offsets from the head of the file,
+     *         so vertices, indices and texels can be passed to the GPU directly from the mapped memory
+     */
+    class CompiledModel
+    {
+    public:
+        /**
+         * @brief  Header at the head of the file
+         */
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            //! Cache key (source file hash combined with import options)
+            uint64_t key;
+            uint32_t meshNum;
+            uint32_t materialNum;
+            uint32_t textureNum;
+            uint32_t padding;
+            //! Total size of the file (to detect truncated files)
+            uint64_t fileSize;
+            uint64_t padding2;
+        };
+
+        /**
+         * @brief  Mesh record (vertices are already converted to Mesh::Vertex)
+         */
+        struct MeshRecord
+        {
+            uint64_t vertexOffset;
+            uint64_t indexOffset;
+            uint32_t vertexCount;
+            uint32_t indexCount;
+            uint32_t materialIndex;
+            //! Node name (offset into the string section and length)
+            uint32_t nameOffset;
+            uint32_t nameLength;
+            glm::vec3 aabbMin;
+            glm::vec3 aabbMax;
+            uint32_t padding;
+        };
+
+        /**
+         * @brief  Material record bound to meshes
+         */
+        struct MaterialRecord
+        {
+            //! Channels of the ORM texture taken from the source
+            enum ORMChannel : uint32_t
+            {
+                eRoughness = 1 << 0,
+                eMetalness = 1 << 1,
+            };
+
+            glm::vec3 albedo;
+            float roughness;
+            glm::vec3 emissive;
+            float IOR;
+            //! Indices into the texture records (-1 if none)
+            int32_t albedoTex;
+            //! Occlusion, roughness and metalness in RGB (the layout of glTF, occlusion is 1 unless the source packs it)
+            int32_t ormTex;
+            int32_t normalMapTex;
+            //! ORMChannel bits
+            uint32_t ormChannels;
+        };
+
+        /**
+         * @brief  Texture record (texels are R8G8B8A8)
+         */
+        struct TextureRecord
+        {
+            uint64_t texelOffset;
+            uint32_t width;
+            uint32_t height;
+        };
+
+    public:
+        /**
+         * @brief  Construct from the mapped cache file
+         *
+         * @param file Mapped file
+         */
+        explicit CompiledModel(MappedFile&& file);
+
+        /**
+         * @brief  Construct from the data compiled in memory
+         *
+         * @param data Compiled data
+         */
+        explicit CompiledModel(std::vector<std::byte>&& data);
+
+        /**
+         * @brief  Validate the header and the section ranges
+         *
+         * @param key Expected cache key
+         * @return Whether the data can be used
+         */
+        bool isValid(uint64_t key) const;
+
+        const Header& getHeader() const;
+        std::span<const MeshRecord> getMeshes() const;
+        std::span<const MaterialRecord> getMaterials() const;
+        std::span<const TextureRecord> getTextures() const;
+
+        std::string_view getName(const MeshRecord& mesh) const;
+        const Mesh::Vertex* getVertices(const MeshRecord& mesh) const;
+        const uint32_t* getIndices(const MeshRecord& mesh) const;
+        const uint8_t* getTexels(const TextureRecord& texture) const;
+
+        /**
+         * @brief  Size of the texels of the texture
+         *
+         */
+        static size_t getTexelSize(const TextureRecord& texture)
+        {
+            return static_cast<size_t>(texture.width) * texture.height * 4;
+        }
+
+    private:
+        //! Mapped cache file (if loaded from the cache)
+        MappedFile mFile;
+        //! Data compiled in memory (if the cache could not be used)
+        std::vector<std::byte> mMemory;
+        //! View to whichever holds the data
+        std::span<const std::byte> mData;
+    };
+
+    /**
+     * @brief  On-disk cache of models compiled from the files imported with Assimp
+     * @detail Cache files are keyed by the hash of the source file and the import options,
+     *         so a cache entry is reused until the model file itself (or the vertex layout) changes.
+     *         Separate texture files referenced by the model are not part of the key.
+     *         Separate roughness and metalness maps are packed into one ORM texture at compile time
+     */
+    class MeshCache
+    {
+    public:
+        //! Magic number at the head of the file ("PLMC")
+        constexpr static uint32_t kMagic = 0x434D4C50;
+        //! Format version (increment when the layout or conversion changes)
+        constexpr static uint32_t kVersion = 2;
+        //! Extension of the cache file
+        constexpr static const char* kExtension = ".palmmesh";
+        //! Default directory of cache files (relative to the working directory)
+        constexpr static const char* kDefaultDirectory = "cache/meshes";
+
+    public:
+        /**
+         * @brief  Constructor
+         *
+         * @param directory Directory where cache files are stored
+         */
+        explicit MeshCache(const std::filesystem::path& directory = kDefaultDirectory);
+
+        /**
+         * @brief  Get the compiled model, importing and compiling the source only if no valid cache exists
+         *
+         * @param source 3D model path
+         * @return Compiled model (mapped from the cache file if hit)
+         */
+        CompiledModel acquire(const std::filesystem::path& source);
+
+        /**
+         * @brief  Compute the cache key of the source file
+         *
+         * @param source 3D model path
+         * @return Hash of the file contents combined with the import options
+         */
+        static uint64_t computeKey(const std::filesystem::path& source);
+
+    private:
+        /**
+         * @brief  Import the source with Assimp (vk2s::Scene) and compile it to the cache layout
+         *
+         * @param source 3D model path
+         * @param key Cache key
+         * @return Compiled data
+         */
+        static std::vector<std::byte> compile(const std::filesystem::path& source, uint64_t key);
+
+        //! Directory where cache files are stored
+        std::filesystem::path mDirectory;
+    };
+}  // namespace palm
+
+#endif
@@ -0,0 +1,256 @@
+/*****************************************************************/ /**
+ * @file   MeshPool.hpp
+ * @brief  header file of MeshPool class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_MESHPOOL_HPP_
+#define PALM_INCLUDE_MESHPOOL_HPP_
+
+#include "Mesh.hpp"
+#include "DeviceMemoryPool.hpp"
+
+#include <vk2s/Device.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace palm
+{
+    class UploadBatch;
+
+    /**
+     * @brief  Shares MeshGeometry (vertex/index ranges and BLAS) between meshes with the same contents
+     * @detail Vertices and indices of all geometries are sub-allocated from one global vertex buffer and one global index buffer,
+     *         so the shaders need only two descriptors regardless of the number of meshes.
+     *         Geometries are looked up by the content hash and only weakly referenced here,
+     *         so their ranges are released when the last Mesh using them is destroyed
+     */
+    class MeshPool
+    {
+    public:
+        //! Initial capacity of the global vertex buffer (in vertices)
+        constexpr static uint32_t kInitialVertexCapacity = 1u << 18;
+        //! Initial capacity of the global index buffer (in 32 bit words)
+        constexpr static uint32_t kInitialIndexCapacity = 1u << 20;
+        //! Geometries with at most this number of vertices use 16 bit indices
+        constexpr static uint32_t kMaxIndex16VertexCount = 1u << 16;
+
+    public:
+        /**
+         * @brief  Constructor (allocate the global buffers with the initial capacities)
+         *
+         * @param device vk2s device
+         * @param memoryPool Pool of the BLASes of the geometries
+         */
+        MeshPool(vk2s::Device& device, DeviceMemoryPool& memoryPool);
+
+        MeshPool(const MeshPool&)            = delete;
+        MeshPool& operator=(const MeshPool&) = delete;
+
+        /**
+         * @brief  Change the format of vertices of the geometries created afterwards
+         * @detail The stride of the global vertex buffer changes, so this fails while any geometry is alive
+         *
+         * @param format New format
+         * @return Whether the format was changed
+         */
+        bool setVertexFormat(VertexFormat format);
+
+        /**
+         * @brief  Get the format of vertices in the global vertex buffer
+         *
+         */
+        VertexFormat getVertexFormat() const
+        {
+            return mVertexFormat;
+        }
+
+        /**
+         * @brief  Get the size of a vertex in the global vertex buffer
+         *
+         */
+        size_t getVertexStride() const;
+
+        /**
+         * @brief  Compute the content hash of the geometry
+         *
+         * @param vertices Vertices
+         * @param indices Indices
+         * @return Hash (key of the pool)
+         */
+        static uint64_t computeHash(std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices);
+
+        /**
+         * @brief  Find an alive geometry with the same contents
+         *
+         * @param hash Content hash
+         * @param vertexCount Number of vertices (to reject hash collisions)
+         * @param indexCount Number of indices (to reject hash collisions)
+         * @return Shared geometry (nullptr if not found)
+         */
+        std::shared_ptr<MeshGeometry> find(uint64_t hash, uint32_t vertexCount, uint32_t indexCount);
+
+        /**
+         * @brief  Create a new geometry and register it to the pool
+         * @detail Ranges of the global buffers are allocated but not written (upload them with UploadBatch::addBuffer()),
+         *         and the BLAS is not built.
+         *         If the global buffers are full they are reallocated (waiting for the device to be idle),
+         *         which invalidates the buffers previously returned by getVertexBuffer() and getIndexBuffer()
+         *
+         * @param hash Content hash
+         * @param vertexCount Number of vertices
+         * @param indexCount Number of indices
+         * @param aabbMin Object-space bounding box
+         * @param aabbMax Object-space bounding box
+         * @return Created geometry
+         */
+        std::shared_ptr<MeshGeometry> create(uint64_t hash, uint32_t vertexCount, uint32_t indexCount, const glm::vec3& aabbMin, const glm::vec3& aabbMax);
+
+        /**
+         * @brief  Queue the upload of the contents of the geometry, converted into its vertex format and index type
+         * @detail Converted data are owned by the batch, but unconverted data are referenced,
+         *         so the source must be kept alive until UploadBatch::submit()
+         *
+         * @param uploadBatch Batch to which the uploads are queued
+         * @param geometry Destination geometry (created by this pool)
+         * @param vertices Vertices (vertexCount of the geometry)
+         * @param indices Indices (indexCount of the geometry)
+         */
+        void upload(UploadBatch& uploadBatch, const MeshGeometry& geometry, std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices);
+
+        /**
+         * @brief  Read the contents of the geometry back from the GPU (decoded into Mesh::Vertex and 32 bit indices)
+         *
+         * @param geometry Source geometry (created by this pool)
+         * @param vertices Destination of vertices
+         * @param indices Destination of indices
+         */
+        void download(const MeshGeometry& geometry, std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+        /**
+         * @brief  Number of 32 bit words occupied by the indices of the geometry
+         *
+         * @param geometry Geometry
+         */
+        static uint32_t getIndexWordCount(const MeshGeometry& geometry);
+
+        /**
+         * @brief  Number of geometries currently alive
+         *
+         */
+        size_t size();
+
+        /**
+         * @brief  Get the global vertex buffer (device-local, vertices of a geometry start at firstVertex)
+         *
+         */
+        const PooledBuffer& getVertexBuffer() const
+        {
+            return *mVertexBuffer;
+        }
+
+        /**
+         * @brief  Get the global index buffer (device-local, indices of a geometry start at firstIndex)
+         *
+         */
+        const PooledBuffer& getIndexBuffer() const
+        {
+            return *mIndexBuffer;
+        }
+
+        /**
+         * @brief  Get the memory pool of the BLASes of the geometries
+         *
+         */
+        DeviceMemoryPool& getMemoryPool() const
+        {
+            return mMemoryPool;
+        }
+
+    private:
+        /**
+         * @brief  First-fit allocator of element ranges in a global buffer
+         */
+        class FreeList
+        {
+        public:
+            /**
+             * @brief  Allocate a range (the lowest free offset that fits)
+             *
+             * @param count Number of elements
+             * @return Offset of the range (nullopt if no free range is large enough)
+             */
+            std::optional<uint32_t> allocate(uint32_t count);
+
+            /**
+             * @brief  Return a range (merged with adjacent free ranges)
+             *
+             * @param offset Offset of the range
+             * @param count Number of elements
+             */
+            void release(uint32_t offset, uint32_t count);
+
+        private:
+            //! Offset -> number of elements of each free range
+            std::map<uint32_t, uint32_t> mRanges;
+        };
+
+        /**
+         * @brief  Reallocate a global buffer with a larger capacity keeping its contents
+         *
+         * @param buffer Global buffer to be reallocated
+         * @param capacity Current capacity (updated)
+         * @param freeList Free list of the buffer (the added range is released to it)
+         * @param required Number of elements that must fit at least
+         * @param stride Size of an element
+         * @param usage Usage of the buffer
+         */
+        void grow(std::unique_ptr<PooledBuffer>& buffer, uint32_t& capacity, FreeList& freeList, uint32_t required, size_t stride, vk::BufferUsageFlags usage);
+
+        /**
+         * @brief  Release the ranges of the geometry (called when the last reference is dropped)
+         *
+         * @param geometry Geometry being destroyed
+         */
+        void release(const MeshGeometry& geometry);
+
+        /**
+         * @brief  Copy a part of a global buffer to the host
+         *
+         * @param buffer Source buffer
+         * @param pDst Destination on the host
+         * @param size Size in bytes
+         * @param offset Offset in the buffer
+         */
+        void readBack(vk::Buffer buffer, void* pDst, size_t size, size_t offset);
+
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Reference to the memory pool
+        DeviceMemoryPool& mMemoryPool;
+        //! Content hash -> geometry (not owned)
+        std::unordered_map<uint64_t, std::weak_ptr<MeshGeometry>> mGeometries;
+
+        //! Format of vertices in the global vertex buffer
+        VertexFormat mVertexFormat = VertexFormat::eFull;
+        //! Global vertex buffer (suballocated from the memory pool)
+        std::unique_ptr<PooledBuffer> mVertexBuffer;
+        //! Global index buffer (suballocated from the memory pool)
+        std::unique_ptr<PooledBuffer> mIndexBuffer;
+        //! Capacities of the global buffers (in elements)
+        uint32_t mVertexCapacity = 0;
+        uint32_t mIndexCapacity  = 0;
+        //! Free ranges of the global buffers
+        FreeList mVertexFreeList;
+        FreeList mIndexFreeList;
+    };
+}  // namespace palm
+
+#endif
@@ -0,0 +1,132 @@
+/*****************************************************************/ /**
+ * @file   ModelLoader.hpp
+ * @brief  header file of ModelLoader class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_MODELLOADER_HPP_
+#define PALM_INCLUDE_MODELLOADER_HPP_
+
+#include <vk2s/Device.hpp>
+#include <EC2S.hpp>
+
+#include "MeshCache.hpp"
+#include "TextureCache.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace palm
+{
+    class MeshPool;
+    class TextureRegistry;
+
+    /**
+     * @brief  Progress and cancellation of a load, shared with the thread preparing it
+     */
+    struct LoadControl
+    {
+        //! Ratio of the preparation done [0, 1]
+        std::atomic<float> progress = 0.f;
+        //! Set to abandon the load (checked between the steps of the preparation)
+        std::atomic<bool> cancelled = false;
+    };
+
+    /**
+     * @brief  Loads 3D models and adds them to the scene as entities
+     * @detail Only the resources required for rendering (ray tracing) are created here,
+     *         resources for the editor (rasterization) are created by the Editor itself.
+     *         Loading is split into prepare() touching only the host (importing, hashing and texture encoding),
+     *         which may run on any thread, and add() creating the entities and GPU resources on the thread owning the scene
+     */
+    class ModelLoader
+    {
+    public:
+        /**
+         * @brief  Texture of the model prepared on the host
+         */
+        struct PreparedTexture
+        {
+            //! Content hash (TextureCache::computeKey())
+            uint64_t key = 0;
+            //! Block-compressed texels (nullopt if the texels are uploaded as is)
+            std::optional<CompressedTexture> compressed;
+        };
+
+        /**
+         * @brief  Model imported, hashed and encoded on the host, ready to be added to the scene
+         */
+        struct Prepared
+        {
+            //! Source path
+            std::filesystem::path path;
+            //! Compiled model (mapped from the mesh cache)
+            CompiledModel model;
+            //! Content hash of each mesh record
+            std::vector<uint64_t> meshHashes;
+            //! Texture record and usage -> prepared texture
+            std::map<std::pair<int32_t, TextureUsage>, PreparedTexture> textures;
+        };
+
+    public:
+        /**
+         * @brief  Constructor
+         *
+         * @param device vk2s device
+         * @param scene Scene to which the loaded entities are added
+         * @param meshPool Pool of geometries (meshes already loaded are shared instead of being uploaded again)
+         * @param textureRegistry Registry of textures (textures already loaded are shared instead of being uploaded again)
+         */
+        ModelLoader(vk2s::Device& device, ec2s::Registry& scene, MeshPool& meshPool, TextureRegistry& textureRegistry);
+
+        /**
+         * @brief  Loads a 3D model from a specified path and adds it to the scene
+         *
+         * @param path 3D model path
+         * @return Entities created for each mesh of the model
+         */
+        std::vector<ec2s::Entity> load(const std::filesystem::path& path);
+
+        /**
+         * @brief  Import the model and prepare its geometries and textures on the host (thread-safe, no device access)
+         *
+         * @param path 3D model path
+         * @param compressTextures Whether textures are block-compressed (see supportsCompressedTextures())
+         * @param pControl Progress and cancellation of the load (optional)
+         * @return Prepared model (nullopt if cancelled)
+         */
+        static std::optional<Prepared> prepare(const std::filesystem::path& path, bool compressTextures, LoadControl* pControl = nullptr);
+
+        /**
+         * @brief  Create the entities and upload the GPU resources of the prepared model
+         *
+         * @param prepared Model prepared by prepare()
+         * @return Entities created for each mesh of the model
+         */
+        std::vector<ec2s::Entity> add(const Prepared& prepared);
+
+        /**
+         * @brief  Whether the device can sample the block-compressed formats written by TextureCache
+         *
+         */
+        bool supportsCompressedTextures() const;
+
+    private:
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Reference to scene
+        ec2s::Registry& mScene;
+        //! Reference to geometry pool
+        MeshPool& mMeshPool;
+        //! Reference to texture registry
+        TextureRegistry& mTextureRegistry;
+    };
+}  // namespace palm
+
+#endif
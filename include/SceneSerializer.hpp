@@ -0,0 +1,118 @@
+/*****************************************************************/ /**
+ * @file   SceneSerializer.hpp
+ * @brief  header file of SceneSerializer class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_SCENESERIALIZER_HPP_
+#define PALM_INCLUDE_SCENESERIALIZER_HPP_
+
+#include <vk2s/Device.hpp>
+#include <EC2S.hpp>
+
+#include <filesystem>
+#include <vector>
+
+namespace palm
+{
+    class MeshPool;
+    class TextureRegistry;
+
+    /**
+     * @brief  Saves/loads the scene (registry) to/from the palm binary scene format
+     * @detail Geometry is stored already converted to Mesh::Vertex and textures are stored as raw texels,
+     *         so loading requires neither model importing nor vertex conversion.
+     *         Geometries and textures shared by several entities are stored once in tables
+     */
+    class SceneSerializer
+    {
+    public:
+        //! Magic number at the head of the file ("PLMS")
+        constexpr static uint32_t kMagic = 0x534D4C50;
+        //! Format version (increment when the layout changes)
+        constexpr static uint32_t kVersion = 6;
+        //! Extension of the scene file
+        constexpr static const char* kExtension = ".palmscene";
+
+    public:
+        /**
+         * @brief  Constructor
+         *
+         * @param device vk2s device
+         * @param scene Scene to be saved, or to which the loaded entities are added
+         * @param meshPool Pool of geometries (loaded geometries are shared through it)
+         * @param textureRegistry Registry of textures (loaded textures are shared through it)
+         */
+        SceneSerializer(vk2s::Device& device, ec2s::Registry& scene, MeshPool& meshPool, TextureRegistry& textureRegistry);
+
+        /**
+         * @brief  Save all entities in the scene
+         * @detail GPU resources (geometry and textures) are read back, so the GPU must be idle
+         *
+         * @param path Destination path
+         * @return Whether the scene was saved successfully
+         */
+        bool save(const std::filesystem::path& path);
+
+        /**
+         * @brief  Load entities from the file and add them to the scene
+         *
+         * @param path Scene file path
+         * @return Loaded entities (empty if failed)
+         */
+        std::vector<ec2s::Entity> load(const std::filesystem::path& path);
+
+    private:
+        /**
+         * @brief  Bit flags representing which components the entity has
+         */
+        enum ComponentFlag : uint32_t
+        {
+            eMesh      = 1 << 0,
+            eMaterial  = 1 << 1,
+            eTransform = 1 << 2,
+            eEmitter   = 1 << 3,
+            eCamera    = 1 << 4,
+        };
+
+        /**
+         * @brief  Texels of a texture stored in the texture table of the file
+         */
+        struct TextureData
+        {
+            //! Content hash in the texture registry (0 if the texture was not registered)
+            uint64_t key    = 0;
+            uint32_t width  = 0;
+            uint32_t height = 0;
+            vk::Format format;
+            //! Layout in which the texture is kept while it is used
+            vk::ImageLayout layout;
+            //! Number of stored levels (block-compressed textures keep their chain, the others are generated again)
+            uint32_t mipLevels = 1;
+            //! Texels of all stored levels, packed from level 0
+            std::vector<uint8_t> texels;
+        };
+
+        /**
+         * @brief  Copy the texels of the image to the host
+         *
+         * @param image Image to be read back
+         * @param layout Current layout of the image (restored after reading)
+         * @return Texels of the image
+         */
+        TextureData readBack(Handle<vk2s::Image> image, vk::ImageLayout layout);
+
+    private:
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Reference to scene
+        ec2s::Registry& mScene;
+        //! Reference to geometry pool
+        MeshPool& mMeshPool;
+        //! Reference to texture registry
+        TextureRegistry& mTextureRegistry;
+    };
+}  // namespace palm
+
+#endif
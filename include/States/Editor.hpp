@@ -23,8 +23,21 @@
 
 #include "../include/AppStates.hpp"
 #include "../GraphicsPass.hpp"
-
+#include "../Transform.hpp"
+#include "../Material.hpp"
+#include "../Emitter.hpp"
+#include "../Integrators/Integrator.hpp"
+#include "../FrameRing.hpp"
+#include "../ModelLoader.hpp"
+
+#include <array>
 #include <filesystem>
+#include <future>
+#include <list>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
 namespace palm
 {
@@ -52,13 +65,152 @@ namespace palm
         };
 
         /**
-         * @brief  Parameters per instance (passed to the GPU)
+         * @brief  Parameters per instance (passed to the GPU, must always sync with shader side)
          */
-        struct InstanceUB
+        struct InstanceParams  // std430
         {
             glm::mat4 model;
-            uint32_t matIndex;
-            float padding[3];
+            glm::mat4 modelInvTranspose;
+            uint32_t entitySlot;
+            uint32_t entityIndex;
+            uint32_t materialIndex;
+            uint32_t geometryIndex;
+        };
+
+        /**
+         * @brief  Draw arguments and bounds of a geometry, from which the draw command of each instance is generated (passed to the GPU)
+         */
+        struct DrawGeometryParams  // std430
+        {
+            //! In indices of its index type
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            int32_t vertexOffset;
+            //! Slot of draw commands (0: 32 bit indices, 1: 16 bit indices)
+            uint32_t indexTypeSlot;
+            //! Object-space bounding box (transformed by each instance on the GPU)
+            glm::vec3 aabbMin;
+            float padding0;
+            glm::vec3 aabbMax;
+            float padding1;
+        };
+
+        /**
+         * @brief  Phases of the two-phase occlusion culling
+         * @detail The early phase draws the instances visible in the last frame, the Hi-Z pyramid is built from that depth,
+         *         and the late phase draws the remaining instances that pass the Hi-Z test (and updates the visibility)
+         */
+        enum class CullingPhase : uint32_t
+        {
+            eEarly = 0,
+            eLate  = 1,
+        };
+
+        /**
+         * @brief  Parameters and results of the culling (passed to the GPU, the draw counts are read by drawIndexedIndirectCount)
+         */
+        struct CullingParams  // std430
+        {
+            uint32_t instanceNum;
+            //! Number of commands per slot
+            uint32_t capacity;
+            //! Size of the level 0 of the Hi-Z pyramid (half of the depth buffer)
+            glm::uvec2 hizSize;
+            uint32_t hizLevelNum;
+            //! Whether the occlusion culling is enabled (otherwise only the frustum culling in the early phase)
+            uint32_t occlusionCulling;
+            //! Draw count of each phase and index type slot
+            std::array<uint32_t, 4> drawNum;
+            uint32_t frustumCulledNum;
+            uint32_t occlusionCulledNum;
+        };
+
+        /**
+         * @brief  Level of the Hi-Z pyramid being built (passed to the GPU as dynamic uniform buffer)
+         */
+        struct HiZLevelParams
+        {
+            uint32_t level;
+        };
+
+        /**
+         * @brief  Resources of the GPU-driven geometry pass (per frame)
+         * @detail Instances and materials are written by the CPU, and the draw commands are generated by the culling passes
+         */
+        struct DrawResources
+        {
+            //! Number of instances written this frame
+            uint32_t instanceNum = 0;
+
+            //! InstanceParams (persistently mapped)
+            std::unique_ptr<PooledBuffer> instanceBuffer;
+            //! Material::Params (persistently mapped, texture indices refer to the textures of this frame)
+            std::unique_ptr<PooledBuffer> materialBuffer;
+            //! DrawGeometryParams (persistently mapped)
+            std::unique_ptr<PooledBuffer> geometryBuffer;
+            //! VkDrawIndexedIndirectCommand of 2 phases x 2 slots (written by the culling passes)
+            std::unique_ptr<PooledBuffer> commandBuffer;
+            //! CullingParams (header written by vkCmdUpdateBuffer, counts by the culling passes)
+            std::unique_ptr<PooledBuffer> cullingBuffer;
+            //! Copy of cullingBuffer read by the CPU for statistics
+            std::unique_ptr<PooledBuffer> readbackBuffer;
+
+            //! Textures bound to the bind group (to skip rebinding when unchanged)
+            std::vector<VkImage> boundTextures;
+            //! Version of the DrawScene last written to the buffers of this frame (0: nothing written)
+            uint64_t sceneVersion = 0;
+            //! Instances edited since the last write to the buffers of this frame
+            std::vector<uint32_t> dirtyInstances;
+
+            //! BindGroup of the geometry pass (instances, materials, textures and sampler)
+            UniqueHandle<vk2s::BindGroup> bindGroup;
+            //! BindGroup of the culling passes
+            UniqueHandle<vk2s::BindGroup> cullingBindGroup;
+        };
+
+        /**
+         * @brief  CPU-side copy of the instances drawn by the geometry pass
+         * @detail Rebuilt only when entities are added or removed, edits update just their entries,
+         *         which are then written to the buffers of each frame when that frame is recorded next
+         */
+        struct DrawScene
+        {
+            //! Incremented on every rebuild (frames holding an older version write everything)
+            uint64_t version = 0;
+            //! Entity of each instance
+            std::vector<ec2s::Entity> entities;
+            //! Instance index of each entity
+            std::unordered_map<ec2s::Entity, uint32_t> instanceIndices;
+            std::vector<InstanceParams> instances;
+            //! Material of each instance (texture indices refer to textures)
+            std::vector<Material::Params> materials;
+            std::vector<DrawGeometryParams> geometries;
+            //! Texture table of the geometry pass (padded with the dummy texture)
+            std::vector<Handle<vk2s::Image>> textures;
+        };
+
+        /**
+         * @brief  Envmap decoded on a loading thread with its distribution for importance sampling
+         */
+        struct PreparedEnvmap
+        {
+            DecodedEnvmap image;
+            std::shared_ptr<const EnvmapDistribution> distribution;
+        };
+
+        /**
+         * @brief  Model or envmap being loaded in the background (shown as a placeholder until it is added to the scene)
+         */
+        struct PendingLoad
+        {
+            //! Source path
+            std::filesystem::path path;
+            //! Progress and cancellation shared with the loading thread
+            std::shared_ptr<LoadControl> control;
+            //! Model prepared by the loading thread (valid if a model is loaded)
+            std::future<std::optional<ModelLoader::Prepared>> model;
+            //! Envmap decoded by the loading thread (valid if an envmap is loaded)
+            std::future<std::optional<PreparedEnvmap>> envmap;
         };
 
         /**
@@ -110,12 +262,82 @@ namespace palm
         void onResized();
 
         /** 
-         * @brief  Loads a 3D model from a specified path and adds it to the scene
+         * @brief  Start loading a 3D model from a specified path in the background
+         * @detail The model is imported and its textures are encoded on a worker thread,
+         *         and the entities are added to the scene by updatePendingLoads() once it is done
          *  
          * @param path 3D model path
          */
         void addEntity(const std::filesystem::path& path);
 
+        /** 
+         * @brief  Start loading an image as the envmap of the infinite emitter in the background
+         *  
+         * @param path Image path
+         */
+        void loadEnvmap(const std::filesystem::path& path);
+
+        /** 
+         * @brief  Add the models and envmaps whose loading threads have finished to the scene (called every frame)
+         *  
+         */
+        void updatePendingLoads();
+
+        /** 
+         * @brief  (Re)create the buffers of the GPU-driven geometry pass of all frames and the visibility buffer
+         * @detail The previous resources must not be in use
+         *  
+         * @param capacity Number of instances to hold
+         */
+        void createDrawResources(const uint32_t capacity);
+
+        /** 
+         * @brief  (Re)create the Hi-Z pyramid for the current depth buffer (separated to accommodate window resizing)
+         *  
+         */
+        void createHiZ();
+
+        /** 
+         * @brief  Rebuild mDrawScene from the scene (when entities have been added or removed)
+         *  
+         */
+        void rebuildDrawScene();
+
+        /** 
+         * @brief  Apply the edits of mSceneDelta to mDrawScene and write the changed entries of the current frame
+         *  
+         */
+        void updateDrawResources();
+
+        /** 
+         * @brief  Write the emitters of the current frame to the frame ring
+         *  
+         */
+        void updateEmitters();
+
+        /** 
+         * @brief  Record the culling phase generating the draw commands of the current frame (outside of render pass)
+         *  
+         * @param command Command buffer to record into
+         * @param phase Early or late phase
+         */
+        void recordCulling(Handle<vk2s::Command> command, const CullingPhase phase);
+
+        /** 
+         * @brief  Record the build of the Hi-Z pyramid from the depth buffer drawn by the early phase (outside of render pass)
+         *  
+         * @param command Command buffer to record into
+         */
+        void recordHiZBuild(Handle<vk2s::Command> command);
+
+        /** 
+         * @brief  Record the indirect draws generated by the culling phase (inside of the geometry pass)
+         *  
+         * @param command Command buffer to record into
+         * @param phase Early or late phase
+         */
+        void recordGeometryDraws(Handle<vk2s::Command> command, const CullingPhase phase);
+
         /** 
          * @brief  Delete the specified entity from the scene
          *  
@@ -123,6 +345,46 @@ namespace palm
          */
         void removeEntity(const ec2s::Entity entity);
 
+        /** 
+         * @brief  Delete the specified entities from the scene at once
+         * @detail Textures shared between entities are destroyed only when no remaining entity refers to them
+         *  
+         * @param entities Entities to be deleted
+         */
+        void removeEntities(const std::vector<ec2s::Entity>& entities);
+
+        /** 
+         * @brief  Create instances of the entity sharing its geometry (vertex/index buffers and BLAS)
+         *  
+         * @param source Entity that has Mesh, Material, Transform and EntityInfo
+         * @param transforms Transform of each instance (pos, rot and scale are used)
+         * @return Created entities
+         */
+        std::vector<ec2s::Entity> instantiate(const ec2s::Entity source, const std::vector<Transform>& transforms);
+
+        /** 
+         * @brief  Scatter instances of the entity randomly on the horizontal disk around it
+         *  
+         * @param source Entity to be instantiated
+         * @param count Number of instances
+         * @param radius Radius of the disk
+         */
+        void scatter(const ec2s::Entity source, const int count, const float radius);
+
+        /** 
+         * @brief  Save the whole scene to the palm binary scene file
+         *  
+         * @param path Destination path
+         */
+        void saveScene(const std::filesystem::path& path);
+
+        /** 
+         * @brief  Replace the current scene with the one loaded from the palm binary scene file
+         *  
+         * @param path Scene file path
+         */
+        void loadScene(const std::filesystem::path& path);
+
         /** 
          * @brief  Returns whether the mouse pointer is on the drawing area
          *  
@@ -141,6 +403,20 @@ namespace palm
         constexpr static double kCameraMoveSpeed = 2.0;
         //! Camera viewpoint movement speed
         constexpr static double kCameraViewpointSpeed = 0.7;
+        //! Number of textures bound to the geometry pass (must always sync with shader side)
+        constexpr static uint32_t kMaxRasterTextureNum = 256;
+        //! Workgroup size of the culling (must always sync with shader side)
+        constexpr static uint32_t kCullingThreadNum = 64;
+        //! Workgroup size (per dimension) of the Hi-Z build (must always sync with shader side)
+        constexpr static uint32_t kHiZThreadNum = 8;
+        //! Maximum number of levels of the Hi-Z pyramid (covers 65536 x 65536 depth buffers)
+        constexpr static uint32_t kMaxHiZLevelNum = 16;
+        //! Distance between the HiZLevelParams of adjacent levels (aligned for dynamic offsets)
+        constexpr static vk::DeviceSize kHiZLevelStride = FrameRing::kAlignment;
+        //! Size of the region of each frame in the frame ring (SceneParams and emitters with alignment)
+        constexpr static vk::DeviceSize kFrameRingRegionSize = 64 * 1024;
+        //! Initial number of instances of the draw resources (doubled when exceeded)
+        constexpr static uint32_t kInitialDrawCapacity = 1024;
 
     private:
         //! GPU commands (per frame)
@@ -160,6 +436,54 @@ namespace palm
         //! Lighting path for deferred shading (apply shading to G-Buffer)
         GraphicsPass mLightingPass;
 
+        //! Render pass of the late phase of the geometry pass (loads the G-Buffer drawn by the early phase)
+        UniqueHandle<vk2s::RenderPass> mGeometryLateRenderpass;
+
+        //! Compute shaders of the culling (early and late phase) and the Hi-Z build
+        UniqueHandle<vk2s::Shader> mCullingEarlyShader;
+        UniqueHandle<vk2s::Shader> mCullingLateShader;
+        UniqueHandle<vk2s::Shader> mHiZShader;
+        //! BindLayout shared by the culling and the Hi-Z build
+        UniqueHandle<vk2s::BindLayout> mCullingBindLayout;
+        //! Pipelines of the culling (early and late phase) and the Hi-Z build
+        UniqueHandle<vk2s::Pipeline> mCullingEarlyPipeline;
+        UniqueHandle<vk2s::Pipeline> mCullingLatePipeline;
+        UniqueHandle<vk2s::Pipeline> mHiZPipeline;
+
+        //! Number of instances that the draw resources can hold
+        uint32_t mDrawCapacity = 0;
+        //! Resources of the GPU-driven geometry pass (per frame)
+        std::vector<DrawResources> mDrawResources;
+        //! Visibility of each instance in the last late phase (shared by all frames)
+        std::unique_ptr<PooledBuffer> mVisibilityBuffer;
+        //! Hi-Z pyramid (all levels packed into one buffer, farthest depth of each texel)
+        std::unique_ptr<PooledBuffer> mHiZBuffer;
+        //! HiZLevelParams of each level (persistently mapped)
+        std::unique_ptr<PooledBuffer> mHiZLevelBuffer;
+        //! Size of the level 0 of the Hi-Z pyramid
+        glm::uvec2 mHiZSize = glm::uvec2(1);
+        //! Number of levels of the Hi-Z pyramid
+        uint32_t mHiZLevelNum = 1;
+        //! Whether the occlusion culling is enabled
+        bool mOcclusionCulling = true;
+        //! Culling results of the latest completed frame (for UI)
+        CullingParams mCullingStats = {};
+
+        //! Instances of the geometry pass on the CPU side
+        DrawScene mDrawScene;
+        //! Whether entities have been added or removed since the last rebuild of mDrawScene
+        bool mSceneStructureChanged = true;
+        //! Entities edited in this frame (applied to mDrawScene and the emitters)
+        Integrator::SceneDelta mSceneDelta;
+        //! Texture bound as the envmap of the lighting pass (to skip rebinding when unchanged)
+        VkImage mBoundEnvmap = VK_NULL_HANDLE;
+        //! Write everything every frame (to measure the time saved by the change tracking)
+        bool mForceFullUpload = false;
+        //! CPU time of the last upload of instances, materials and emitters [ms]
+        double mUploadTime = 0.;
+        //! Number of instances written by the last upload
+        uint32_t mUploadedInstanceNum = 0;
+
         //! Sampler with default settings for G-Buffer reading, etc.
         UniqueHandle<vk2s::Sampler> mNearestSampler;
 
@@ -169,17 +493,22 @@ namespace palm
         //! Dummy image for pseudo binding
         UniqueHandle<vk2s::Image> mDummyTexture;
 
-        //! Uniform buffer to write SceneParams
-        UniqueHandle<vk2s::DynamicBuffer> mSceneBuffer;
+        //! Per-frame uniform data (SceneParams and emitters, addressed by dynamic offsets)
+        std::unique_ptr<FrameRing> mFrameRing;
+        //! Offset of SceneParams of the current frame in the frame ring
+        uint32_t mSceneOffset = 0;
+        //! Offset of the emitters of the current frame in the frame ring
+        uint32_t mEmitterOffset = 0;
         //! Buffer to which the GPU writes the entity that is mouse hovering
-        UniqueHandle<vk2s::Buffer> mPickedIDBuffer;
-        //! Uniform buffer to write emitter information
-        UniqueHandle<vk2s::DynamicBuffer> mEmitterBuffer;
+        std::unique_ptr<PooledBuffer> mPickedIDBuffer;
         //! BindGroup for scene information
         UniqueHandle<vk2s::BindGroup> mSceneBindGroup;
         //! BindGroup for Lighting pass informations
         UniqueHandle<vk2s::BindGroup> mLightingBindGroup;
 
+        //! Loads in progress (several loads run concurrently, each on its own thread)
+        std::list<PendingLoad> mPendingLoads;
+
         //! Currently Picked Entity
         std::optional<ec2s::Entity> mPickedEntity;
         //! Entity in scene with camera (always get it first, if not, create it)
@@ -193,10 +522,19 @@ namespace palm
         //! To detect only the first frame mouse clicked
         bool mDragging;
 
+        //! Number of instances created by a scatter operation
+        int mScatterCount = 100;
+        //! Radius of the disk on which instances are scattered
+        float mScatterRadius = 10.f;
+
         //! For envmap texture loading
         ImGui::FileBrowser mEnvmapBrowser;
         //! For material texture loading
         ImGui::FileBrowser mMaterialTexBrowser;
+        //! For scene saving
+        ImGui::FileBrowser mSceneSaveBrowser;
+        //! For scene loading
+        ImGui::FileBrowser mSceneLoadBrowser;
 
         //! Infinite emitter entity
         std::optional<ec2s::Entity> mInfiniteEmitterEntity;
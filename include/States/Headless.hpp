@@ -0,0 +1,87 @@
+/*****************************************************************/ /**
+ * @file   Headless.hpp
+ * @brief  header file of headless (offline rendering) state
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_STATES_HEADLESS_HPP_
+#define PALM_INCLUDE_STATES_HEADLESS_HPP_
+
+#include <EC2S.hpp>
+#include <vk2s/Device.hpp>
+#include <vk2s/Camera.hpp>
+
+#include "../include/AppStates.hpp"
+#include "../include/Integrators/Integrator.hpp"
+
+#include <chrono>
+#include <filesystem>
+
+namespace palm
+{
+    /**
+     * @brief State to render a scene offline without window, swapchain and ImGui
+     * @detail Accumulates samples until the target spp or the time budget is reached, then writes the result and exits
+     */
+    class Headless : public ec2s::State<palm::AppState, palm::CommonRegion>
+    {
+        //! Macro to generate required members
+        GEN_STATE(Headless, palm::AppState, palm::CommonRegion);
+
+    private:
+        /**
+         * @brief Vulkan(vk2s) initialization
+         *
+         */
+        void initVulkan();
+
+        /**
+         * @brief  Build the scene (models, emitters and camera) from the settings
+         *
+         */
+        void loadScene();
+
+        /**
+         * @brief  Save the current outputImage to disk
+         * @detail  Currently supports only png
+         *
+         * @param saveDst  Destination path
+         */
+        void saveImage(const std::filesystem::path& saveDst);
+
+        /**
+         * @brief  Report the error and record the failure in CommonRegion (nothing is rendered after this)
+         *
+         * @param message Error message
+         */
+        void fail(const std::string& message);
+
+    private:
+        //! Interval of the progress reports in seconds
+        constexpr static double kProgressInterval = 5.0;
+
+        //! Image from which the Integrator outputs the current estimated luminance value
+        UniqueHandle<vk2s::Image> mOutputImage;
+        //! Staging buffer for storing output images (persistently mapped, coherent)
+        std::unique_ptr<PooledBuffer> mStagingBuffer;
+
+        //! Selected Integrator
+        std::unique_ptr<Integrator> mIntegrator;
+
+        //! GPU command (only one frame is in flight because integrators write shader resources synchronously)
+        UniqueHandle<vk2s::Command> mCommand;
+        //! Fence to wait for the completion of each frame
+        UniqueHandle<vk2s::Fence> mFence;
+
+        //! Total samples per pixel accumulated so far
+        uint32_t mAccumulatedSpp = 0;
+        //! Time when the rendering started
+        std::chrono::steady_clock::time_point mStartTime;
+        //! Elapsed time of the last progress report in seconds
+        double mLastReportTime = 0.;
+    };
+
+}  // namespace palm
+
+#endif
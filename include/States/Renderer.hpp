@@ -80,12 +80,26 @@ namespace palm
          */
         void updateAndRenderImGui(const double deltaTime);
 
+        /** 
+         * @brief  ImGui window to edit transforms and materials of the scene while rendering
+         * @detail Edited entities are accumulated into mSceneDelta
+         *  
+         */
+        void updateAndRenderSceneImGui();
+
         /** 
          * @brief  Update resources to be bound to the shader
          *  
          */
         void updateShaderResources();
 
+        /** 
+         * @brief  Create the integrator on the shared GPUScene (which is flattened from the scene first if it does not exist)
+         *  
+         * @param name Name of the integrator ("path" or "ReSTIR")
+         */
+        void createIntegrator(const std::string& name);
+
         /** 
          * @brief  Called when the window is resized
          *  
@@ -106,11 +120,17 @@ namespace palm
 
         //! Image from which the Integrator outputs the current estimated luminance value
         UniqueHandle<vk2s::Image> mOutputImage;
-        //! Staging buffer for storing output images
-        UniqueHandle<vk2s::Buffer> mStagingBuffer;
+        //! Staging buffer for storing output images (persistently mapped)
+        std::unique_ptr<PooledBuffer> mStagingBuffer;
 
         //! Selected Integrator
         std::unique_ptr<Integrator> mIntegrator;
+        //! Name of the selected Integrator (recreated only when another one is selected)
+        std::string mIntegratorName;
+        //! Entities edited in this frame (applied to the Integrator without rebuilding)
+        Integrator::SceneDelta mSceneDelta;
+        //! Entity being edited
+        std::optional<ec2s::Entity> mPickedEntity;
 
         //! GPU commands (per frame)
         std::vector<Handle<vk2s::Command>> mCommands;
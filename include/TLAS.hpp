@@ -0,0 +1,115 @@
+/*****************************************************************/ /**
+ * @file   TLAS.hpp
+ * @brief  header file of TLAS class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_TLAS_HPP_
+#define PALM_INCLUDE_TLAS_HPP_
+
+#include <vk2s/Device.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "DeviceMemoryPool.hpp"
+
+namespace palm
+{
+    /**
+     * @brief  Top level acceleration structure that can be updated in place
+     * @detail Built with ALLOW_UPDATE, so changing instance transforms only needs an update (refit) build
+     *         recorded into the frame command instead of reconstructing the whole acceleration structure
+     */
+    class TLAS
+    {
+    public:
+        /**
+         * @brief  Constructor (build the TLAS and wait for the completion)
+         *
+         * @param device vk2s device
+         * @param memoryPool Pool from which the buffers are allocated
+         * @param instances Instances of BLASes
+         */
+        TLAS(vk2s::Device& device, DeviceMemoryPool& memoryPool, const std::vector<vk::AccelerationStructureInstanceKHR>& instances);
+
+        /**
+         * @brief  Destructor
+         *
+         */
+        ~TLAS();
+
+        TLAS(const TLAS&)            = delete;
+        TLAS& operator=(const TLAS&) = delete;
+
+        /**
+         * @brief  Change the transform of the instance (applied by the next recordUpdate())
+         *
+         * @param index Index of the instance
+         * @param transform New transform
+         */
+        void setInstanceTransform(uint32_t index, const vk::TransformMatrixKHR& transform);
+
+        /**
+         * @brief  Whether any instance has been changed since the last update
+         *
+         */
+        bool isDirty() const
+        {
+            return mDirty;
+        }
+
+        /**
+         * @brief  Record the in-place update of the TLAS if any instance has been changed
+         * @detail Barriers against the preceding and following ray tracing are also recorded
+         *
+         * @param command Command buffer to record into (outside of render pass)
+         */
+        void recordUpdate(Handle<vk2s::Command> command);
+
+        /**
+         * @brief  Write the TLAS to the binding of the bind group
+         *
+         * @param bindGroup Destination bind group
+         * @param binding Binding index (eAccelerationStructureKHR)
+         */
+        void bind(Handle<vk2s::BindGroup> bindGroup, uint32_t binding) const;
+
+        /**
+         * @brief  Get the Vulkan handle of the acceleration structure
+         *
+         */
+        vk::AccelerationStructureKHR getVkAccelerationStructure() const
+        {
+            return mAccelerationStructure;
+        }
+
+    private:
+        /**
+         * @brief  Fill the build geometry info for the current instances
+         *
+         * @param mode Build or update
+         */
+        vk::AccelerationStructureBuildGeometryInfoKHR makeBuildInfo(vk::BuildAccelerationStructureModeKHR mode) const;
+
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Number of instances
+        uint32_t mInstanceNum = 0;
+        //! Instances (persistently mapped, read by builds)
+        std::unique_ptr<PooledBuffer> mInstanceBuffer;
+        //! Storage of the acceleration structure
+        std::unique_ptr<PooledBuffer> mStorageBuffer;
+        //! Scratch buffer (sized for both build and update)
+        std::unique_ptr<PooledBuffer> mScratchBuffer;
+        //! Geometry referring to the instance buffer
+        vk::AccelerationStructureGeometryKHR mGeometry;
+        //! Acceleration structure
+        vk::AccelerationStructureKHR mAccelerationStructure;
+        //! Whether instances have been changed since the last update
+        bool mDirty = false;
+    };
+}  // namespace palm
+
+#endif
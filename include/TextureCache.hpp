@@ -0,0 +1,214 @@
+/*****************************************************************/ /**
+ * @file   TextureCache.hpp
+ * @brief  header file of TextureCache and CompressedTexture classes
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_TEXTURECACHE_HPP_
+#define PALM_INCLUDE_TEXTURECACHE_HPP_
+
+#include "MappedFile.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace palm
+{
+    /**
+     * @brief  Role of a texture in the material, which decides its block-compressed format
+     */
+    enum class TextureUsage : uint32_t
+    {
+        //! BC7 (RGBA)
+        eAlbedo = 0,
+        //! BC5 (RG of the tangent space normal, z is reconstructed)
+        eNormalMap,
+        //! BC7 (occlusion, roughness and metalness packed into RGB)
+        eORM,
+    };
+
+    /**
+     * @brief  Block-compressed texture with its full mip chain (the contents of a texture cache file)
+     * @detail The levels are tightly packed from the largest one after the 16 byte aligned header,
+     *         so they can be passed to the GPU directly from the mapped memory
+     */
+    class CompressedTexture
+    {
+    public:
+        /**
+         * @brief  Header at the head of the file
+         */
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            //! Cache key (hash of the source texels combined with the usage)
+            uint64_t key;
+            //! vk::Format of the blocks
+            uint32_t format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mipLevels;
+            //! Total size of the file (to detect truncated files)
+            uint64_t fileSize;
+            uint64_t padding;
+        };
+
+    public:
+        /**
+         * @brief  Construct from the mapped cache file
+         *
+         * @param file Mapped file
+         */
+        explicit CompressedTexture(MappedFile&& file);
+
+        /**
+         * @brief  Construct from the data encoded in memory
+         *
+         * @param data Encoded data
+         */
+        explicit CompressedTexture(std::vector<std::byte>&& data);
+
+        /**
+         * @brief  Validate the header and the size of the levels
+         *
+         * @param key Expected cache key
+         * @return Whether the data can be used
+         */
+        bool isValid(uint64_t key) const;
+
+        const Header& getHeader() const;
+        vk::Format getFormat() const;
+
+        /**
+         * @brief  Get the blocks of all levels (packed from level 0)
+         *
+         */
+        const uint8_t* getTexels() const;
+
+        /**
+         * @brief  Size of the blocks of all levels
+         *
+         */
+        size_t getTexelSize() const;
+
+        /**
+         * @brief  Size of the blocks of each level
+         *
+         */
+        std::vector<size_t> getLevelSizes() const;
+
+        /**
+         * @brief  Size of the blocks of a mip level
+         *
+         * @param format Block-compressed format
+         * @param width Width of level 0
+         * @param height Height of level 0
+         * @param level Mip level
+         */
+        static size_t getLevelSize(vk::Format format, uint32_t width, uint32_t height, uint32_t level);
+
+        /**
+         * @brief  Whether the format is one of the block-compressed formats written by TextureCache
+         *
+         */
+        static bool isCompressedFormat(vk::Format format);
+
+    private:
+        //! Mapped cache file (if loaded from the cache)
+        MappedFile mFile;
+        //! Data encoded in memory (if the cache could not be used)
+        std::vector<std::byte> mMemory;
+        //! View to whichever holds the data
+        std::span<const std::byte> mData;
+    };
+
+    /**
+     * @brief  On-disk cache of textures encoded into BC formats at import
+     * @detail Cache files are keyed by the hash of the source texels and the usage,
+     *         so identical textures of different models share one entry and are encoded only once
+     */
+    class TextureCache
+    {
+    public:
+        //! Magic number at the head of the file ("PLMT")
+        constexpr static uint32_t kMagic = 0x544D4C50;
+        //! Format version (increment when the layout or encoders change)
+        constexpr static uint32_t kVersion = 2;
+        //! Extension of the cache file
+        constexpr static const char* kExtension = ".palmtex";
+        //! Default directory of cache files (relative to the working directory)
+        constexpr static const char* kDefaultDirectory = "cache/textures";
+
+    public:
+        /**
+         * @brief  Constructor
+         *
+         * @param directory Directory where cache files are stored
+         */
+        explicit TextureCache(const std::filesystem::path& directory = kDefaultDirectory);
+
+        /**
+         * @brief  Get the compressed texture, encoding the texels only if no valid cache exists
+         *
+         * @param pTexels Source texels (R8G8B8A8, tightly packed)
+         * @param width Width of the texture
+         * @param height Height of the texture
+         * @param usage Role of the texture in the material
+         * @return Compressed texture (mapped from the cache file if hit)
+         */
+        CompressedTexture acquire(const uint8_t* pTexels, uint32_t width, uint32_t height, TextureUsage usage);
+
+        /**
+         * @brief  Get the compressed texture with the key already computed by computeKey()
+         *
+         * @param key Cache key of the texels
+         * @param pTexels Source texels (R8G8B8A8, tightly packed)
+         * @param width Width of the texture
+         * @param height Height of the texture
+         * @param usage Role of the texture in the material
+         * @return Compressed texture (mapped from the cache file if hit)
+         */
+        CompressedTexture acquire(uint64_t key, const uint8_t* pTexels, uint32_t width, uint32_t height, TextureUsage usage);
+
+        /**
+         * @brief  Compute the cache key of the texels
+         *
+         * @param pTexels Source texels (R8G8B8A8, tightly packed)
+         * @param width Width of the texture
+         * @param height Height of the texture
+         * @param usage Role of the texture in the material
+         * @return Hash of the texels combined with the usage and the format version
+         */
+        static uint64_t computeKey(const uint8_t* pTexels, uint32_t width, uint32_t height, TextureUsage usage);
+
+        /**
+         * @brief  Get the block-compressed format for the usage
+         *
+         */
+        static vk::Format getFormat(TextureUsage usage);
+
+    private:
+        /**
+         * @brief  Build the mip chain of the texels and encode every level
+         *
+         * @param pTexels Source texels (R8G8B8A8, tightly packed)
+         * @param width Width of the texture
+         * @param height Height of the texture
+         * @param usage Role of the texture in the material
+         * @param key Cache key
+         * @return Encoded data
+         */
+        static std::vector<std::byte> compile(const uint8_t* pTexels, uint32_t width, uint32_t height, TextureUsage usage, uint64_t key);
+
+        //! Directory where cache files are stored
+        std::filesystem::path mDirectory;
+    };
+}  // namespace palm
+
+#endif
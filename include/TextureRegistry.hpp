@@ -0,0 +1,101 @@
+/*****************************************************************/ /**
+ * @file   TextureRegistry.hpp
+ * @brief  header file of TextureRegistry class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_TEXTUREREGISTRY_HPP_
+#define PALM_INCLUDE_TEXTUREREGISTRY_HPP_
+
+#include <vk2s/Device.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace palm
+{
+    /**
+     * @brief  Shares texture images between materials (and loads) with the same contents
+     * @detail Images are keyed by the content hash of their texels (TextureCache::computeKey()),
+     *         and the sources they were created from (e.g. a texture of a compiled model) are mapped to the key,
+     *         so loading the same source again needs neither hashing nor uploading.
+     *         The registry does not count references, the owner of the last reference destroys the image through destroy()
+     */
+    class TextureRegistry
+    {
+    public:
+        /**
+         * @brief  Constructor
+         *
+         * @param device vk2s device
+         */
+        explicit TextureRegistry(vk2s::Device& device);
+
+        TextureRegistry(const TextureRegistry&)            = delete;
+        TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+        /**
+         * @brief  Find the image with the contents
+         *
+         * @param key Content hash
+         * @return Registered image (invalid handle if not found)
+         */
+        Handle<vk2s::Image> find(uint64_t key) const;
+
+        /**
+         * @brief  Find the content hash of the image created from the source
+         *
+         * @param source Identifier of the source
+         * @return Content hash (nullopt if the source has not been registered)
+         */
+        std::optional<uint64_t> findKey(const std::string& source) const;
+
+        /**
+         * @brief  Get the content hash of the image
+         *
+         * @param image Image
+         * @return Content hash (nullopt if the image is not registered)
+         */
+        std::optional<uint64_t> getKey(Handle<vk2s::Image> image) const;
+
+        /**
+         * @brief  Register the image created from the contents
+         *
+         * @param key Content hash
+         * @param image Created image
+         * @param source Identifier of the source (not mapped if empty)
+         */
+        void add(uint64_t key, Handle<vk2s::Image> image, const std::string& source = {});
+
+        /**
+         * @brief  Unregister the image and destroy it (images not registered are only destroyed)
+         *
+         * @param image Image to be destroyed
+         */
+        void destroy(Handle<vk2s::Image>& image);
+
+        /**
+         * @brief  Get the number of registered images
+         *
+         */
+        size_t size() const
+        {
+            return mImages.size();
+        }
+
+    private:
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Content hash -> image
+        std::unordered_map<uint64_t, Handle<vk2s::Image>> mImages;
+        //! Source -> content hash
+        std::unordered_map<std::string, uint64_t> mSources;
+        //! Image -> content hash
+        std::unordered_map<VkImage, uint64_t> mKeys;
+    };
+}  // namespace palm
+
+#endif
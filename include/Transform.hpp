@@ -83,10 +83,6 @@ namespace palm
         glm::quat rot   = { 1.f, 0.f, 0.f, 0.f };
         //! Scale vector
         glm::vec3 scale = { 1.f, 1.f, 1.f };
-        //! Uniform buffer to write Params
-        Handle<vk2s::DynamicBuffer> uniformBuffer;
-        //! BindGroup for entityBuffer (only for rasterize)
-        Handle<vk2s::BindGroup> bindGroup;
     };
 }
 
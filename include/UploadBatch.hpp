@@ -0,0 +1,146 @@
+/*****************************************************************/ /**
+ * @file   UploadBatch.hpp
+ * @brief  header file of UploadBatch class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#ifndef PALM_INCLUDE_UPLOADBATCH_HPP_
+#define PALM_INCLUDE_UPLOADBATCH_HPP_
+
+#include <vk2s/Device.hpp>
+
+#include "DeviceMemoryPool.hpp"
+
+#include <span>
+#include <vector>
+
+namespace palm
+{
+    /**
+     * @brief  Collects texture and buffer uploads into device-local memory and submits them at once
+     * @detail The data are packed into a staging ring of a few fixed-size slots, and the copies of each slot are recorded
+     *         into one command buffer, so packing the next slot overlaps with the copies of the previous one
+     *         and the cost depends on the total bytes instead of the number of resources.
+     *         Mip chains are generated on the GPU by blitting each level from the previous one after the copy
+     */
+    class UploadBatch
+    {
+    public:
+        //! Size of each slot of the staging ring (a larger image gets slots of its own size)
+        constexpr static vk::DeviceSize kStagingSlotSize = 64ull * 1024 * 1024;
+        //! Number of slots of the staging ring
+        constexpr static uint32_t kStagingSlotNum = 2;
+        //! Alignment of data in the staging ring (keeps texel block alignment)
+        constexpr static vk::DeviceSize kStagingAlignment = 16;
+
+    public:
+        /**
+         * @brief  Constructor
+         *
+         * @param device vk2s device
+         * @param memoryPool Pool from which the staging ring is allocated
+         */
+        UploadBatch(vk2s::Device& device, DeviceMemoryPool& memoryPool);
+
+        /**
+         * @brief  Create a 2D image and queue the upload of its texels
+         * @detail The texels are not copied until submit(), so they must be kept alive until then.
+         *         The full mip chain is created only if the format supports linear blits, otherwise the image has a single level
+         *
+         * @param width Width of the image
+         * @param height Height of the image
+         * @param format Format of the image (texels must be tightly packed in this format)
+         * @param pTexels Texels of the top level to be uploaded
+         * @param size Size of the texels in bytes
+         * @param finalLayout Layout of the image (all levels) after the upload
+         * @param mipmapped Whether to generate the full mip chain from the texels
+         * @return Created image (its contents are valid after submit())
+         */
+        Handle<vk2s::Image> addImage(uint32_t width, uint32_t height, vk::Format format, const void* pTexels, size_t size, vk::ImageLayout finalLayout, bool mipmapped = false);
+
+        /**
+         * @brief  Create a 2D image whose mip chain is already built (e.g. block-compressed textures) and queue the upload of all levels
+         * @detail The texels are not copied until submit(), so they must be kept alive until then
+         *
+         * @param width Width of level 0
+         * @param height Height of level 0
+         * @param format Format of the image
+         * @param pTexels Texels of all levels, packed from level 0
+         * @param levelSizes Size of each level in bytes (also decides the number of levels)
+         * @param finalLayout Layout of the image (all levels) after the upload
+         * @return Created image (its contents are valid after submit())
+         */
+        Handle<vk2s::Image> addImage(uint32_t width, uint32_t height, vk::Format format, const void* pTexels, std::span<const size_t> levelSizes, vk::ImageLayout finalLayout);
+
+        /**
+         * @brief  Queue the upload of data into a part of a buffer
+         * @detail The buffer must be created with eTransferDst (typically in eDeviceLocal memory),
+         *         and the data are not copied until submit(), so they must be kept alive until then
+         *
+         * @param buffer Destination buffer
+         * @param pData Data to be uploaded
+         * @param size Size of the data in bytes
+         * @param offset Offset in the destination buffer
+         */
+        void addBuffer(vk::Buffer buffer, const void* pData, size_t size, vk::DeviceSize offset = 0);
+
+        /**
+         * @brief  Queue the upload of data into a part of a buffer, taking the ownership of the data
+         * @detail For data converted just for the upload (kept until submit())
+         *
+         * @param buffer Destination buffer
+         * @param data Data to be uploaded
+         * @param offset Offset in the destination buffer
+         */
+        void addBuffer(vk::Buffer buffer, std::vector<std::uint8_t>&& data, vk::DeviceSize offset = 0);
+
+        /**
+         * @brief  Upload all queued data and wait for the completion
+         *
+         */
+        void submit();
+
+    private:
+        /**
+         * @brief  Queued image upload
+         */
+        struct PendingImage
+        {
+            Handle<vk2s::Image> image;
+            vk::Extent3D extent;
+            uint32_t mipLevels;
+            //! Sizes of the given levels (only level 0 if the rest of the chain is generated)
+            std::vector<size_t> levelSizes;
+            vk::ImageLayout finalLayout;
+            const void* pTexels;
+            size_t size;
+        };
+
+        /**
+         * @brief  Queued buffer upload (split so that each fits into a slot)
+         */
+        struct PendingBuffer
+        {
+            vk::Buffer buffer;
+            vk::DeviceSize offset;
+            const void* pData;
+            size_t size;
+        };
+
+        //! Reference to vk2s device
+        vk2s::Device& mDevice;
+        //! Reference to the memory pool
+        DeviceMemoryPool& mMemoryPool;
+        //! Queued image uploads
+        std::vector<PendingImage> mPendingImages;
+        //! Queued buffer uploads
+        std::vector<PendingBuffer> mPendingBuffers;
+        //! Data owned until submit (moving the vectors keeps their storage)
+        std::vector<std::vector<std::uint8_t>> mOwnedData;
+        //! Size of the largest queued image
+        vk::DeviceSize mMaxImageSize = 0;
+    };
+}  // namespace palm
+
+#endif
@@ -0,0 +1,95 @@
+/*****************************************************************/ /**
+ * @file   AliasTable.cpp
+ * @brief  source file of AliasTable class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/AliasTable.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace palm
+{
+    AliasTable::AliasTable(std::span<const float> weights)
+        : mBins(weights.size())
+    {
+        const size_t n = weights.size();
+        if (n == 0)
+        {
+            return;
+        }
+
+        // invalid weights are never sampled
+        const auto weightAt = [&](const size_t i) -> double { return std::isfinite(weights[i]) ? std::max(static_cast<double>(weights[i]), 0.0) : 0.0; };
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            mWeightSum += weightAt(i);
+        }
+
+        // uniform if no weight
+        if (mWeightSum <= 0.0)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                mBins[i] = Bin{ .prob = 1.f, .alias = static_cast<uint32_t>(i), .pdf = 1.f / n };
+            }
+            return;
+        }
+
+        // step 1 : scale the weights so that the average is 1, and split them into the bins under and over the average
+        std::vector<double> scaled(n);
+        std::vector<uint32_t> smalls, larges;
+        smalls.reserve(n);
+        larges.reserve(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            mBins[i].pdf = static_cast<float>(weightAt(i) / mWeightSum);
+            scaled[i]    = weightAt(i) / mWeightSum * n;
+            (scaled[i] < 1.0 ? smalls : larges).emplace_back(static_cast<uint32_t>(i));
+        }
+
+        // step 2 : fill each small bin with the remainder of a large bin
+        while (!smalls.empty() && !larges.empty())
+        {
+            const uint32_t small = smalls.back();
+            const uint32_t large = larges.back();
+            smalls.pop_back();
+
+            mBins[small].prob  = static_cast<float>(scaled[small]);
+            mBins[small].alias = large;
+
+            scaled[large] -= 1.0 - scaled[small];
+            if (scaled[large] < 1.0)
+            {
+                larges.pop_back();
+                smalls.emplace_back(large);
+            }
+        }
+
+        // step 3 : the rest are full (up to rounding errors)
+        for (const auto i : smalls)
+        {
+            mBins[i].prob  = 1.f;
+            mBins[i].alias = i;
+        }
+        for (const auto i : larges)
+        {
+            mBins[i].prob  = 1.f;
+            mBins[i].alias = i;
+        }
+    }
+
+    const std::vector<AliasTable::Bin>& AliasTable::getBins() const
+    {
+        return mBins;
+    }
+
+    double AliasTable::getWeightSum() const
+    {
+        return mWeightSum;
+    }
+}  // namespace palm
@@ -0,0 +1,233 @@
+/*****************************************************************/ /**
+ * @file   BLASBuilder.cpp
+ * @brief  source file of BLAS and BLASBuilder classes
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/BLASBuilder.hpp"
+
+#include "../include/Mesh.hpp"
+#include "../include/MeshPool.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace palm
+{
+    namespace
+    {
+        constexpr vk::DeviceSize alignUp(const vk::DeviceSize value, const vk::DeviceSize alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        double toMiB(const vk::DeviceSize size)
+        {
+            return size / (1024. * 1024.);
+        }
+    }  // namespace
+
+    BLAS::BLAS(vk2s::Device& device, DeviceMemoryPool& memoryPool, const vk::DeviceSize size)
+        : mDevice(device)
+        , mBuffer(device, memoryPool, vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress), MemoryUsage::eDeviceLocal)
+        , mSize(size)
+    {
+        const vk::AccelerationStructureCreateInfoKHR ci({}, mBuffer.getVkBuffer(), 0, size, vk::AccelerationStructureTypeKHR::eBottomLevel);
+        mAccelerationStructure = device.getVkDevice()->createAccelerationStructureKHR(ci);
+        mDeviceAddress         = device.getVkDevice()->getAccelerationStructureAddressKHR(vk::AccelerationStructureDeviceAddressInfoKHR(mAccelerationStructure));
+    }
+
+    BLAS::~BLAS()
+    {
+        mDevice.getVkDevice()->destroyAccelerationStructureKHR(mAccelerationStructure);
+    }
+
+    BLASBuilder::BLASBuilder(vk2s::Device& device, MeshPool& meshPool)
+        : mDevice(device)
+        , mMeshPool(meshPool)
+    {
+    }
+
+    void BLASBuilder::add(MeshGeometry& geometry)
+    {
+        mPendingGeometries.emplace_back(&geometry);
+    }
+
+    BLASBuilder::Stats BLASBuilder::build()
+    {
+        Stats stats;
+        if (mPendingGeometries.empty())
+        {
+            return stats;
+        }
+
+        auto& vkDevice       = mDevice.getVkDevice();
+        const size_t blasNum = mPendingGeometries.size();
+        stats.blasNum        = static_cast<uint32_t>(blasNum);
+
+        std::vector<vk::AccelerationStructureGeometryKHR> geometries(blasNum);
+        std::vector<vk::AccelerationStructureBuildGeometryInfoKHR> buildInfos(blasNum);
+        std::vector<vk::AccelerationStructureBuildRangeInfoKHR> ranges(blasNum);
+        std::vector<vk::DeviceSize> asOffsets(blasNum);
+        std::vector<vk::DeviceSize> asSizes(blasNum);
+        std::vector<vk::DeviceSize> scratchSizes(blasNum);
+
+        // geometries are sub-allocated from the global buffers of the pool
+        const vk::DeviceAddress vertexAddress = mMeshPool.getVertexBuffer().getDeviceAddress();
+        const vk::DeviceAddress indexAddress  = mMeshPool.getIndexBuffer().getDeviceAddress();
+
+        // step 1 : query the sizes of each BLAS
+        for (size_t i = 0; i < blasNum; ++i)
+        {
+            const MeshGeometry& geometry  = *mPendingGeometries[i];
+            const uint32_t primitiveCount = geometry.indexCount / 3;
+
+            vk::AccelerationStructureGeometryTrianglesDataKHR triangles;
+            triangles.vertexFormat             = vk::Format::eR32G32B32Sfloat;
+            triangles.vertexData.deviceAddress = vertexAddress + mMeshPool.getVertexStride() * geometry.firstVertex;
+            triangles.vertexStride             = mMeshPool.getVertexStride();  // position comes first in both formats
+            triangles.maxVertex                = std::max(geometry.vertexCount, 1u) - 1;
+            triangles.indexType                = geometry.indexType;
+            triangles.indexData.deviceAddress  = indexAddress + sizeof(uint32_t) * geometry.firstIndex;
+
+            geometries[i] = vk::AccelerationStructureGeometryKHR(vk::GeometryTypeKHR::eTriangles, triangles, vk::GeometryFlagBitsKHR::eOpaque);
+
+            buildInfos[i].type          = vk::AccelerationStructureTypeKHR::eBottomLevel;
+            buildInfos[i].flags         = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace | vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction;
+            buildInfos[i].mode          = vk::BuildAccelerationStructureModeKHR::eBuild;
+            buildInfos[i].geometryCount = 1;
+            buildInfos[i].pGeometries   = &geometries[i];
+
+            ranges[i] = vk::AccelerationStructureBuildRangeInfoKHR(primitiveCount, 0, 0, 0);
+
+            const auto sizeInfo = vkDevice->getAccelerationStructureBuildSizesKHR(vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfos[i], primitiveCount);
+            asSizes[i]          = sizeInfo.accelerationStructureSize;
+            scratchSizes[i]     = alignUp(sizeInfo.buildScratchSize, kScratchAlignment);
+
+            asOffsets[i] = stats.originalSize;
+            stats.originalSize += alignUp(asSizes[i], kASAlignment);
+        }
+
+        // step 2 : split into batches so that the scratch of each batch fits into the shared scratch buffer
+        const vk::DeviceSize maxScratch = *std::max_element(scratchSizes.begin(), scratchSizes.end());
+        vk::DeviceSize totalScratch     = 0;
+        for (const auto size : scratchSizes)
+        {
+            totalScratch += size;
+        }
+        stats.scratchSize = std::max(maxScratch, std::min(totalScratch, kMaxScratchSize));
+
+        // [begin, end) of each batch and offsets of scratch in each batch
+        std::vector<std::pair<size_t, size_t>> batches;
+        std::vector<vk::DeviceSize> scratchOffsets(blasNum);
+        {
+            size_t begin          = 0;
+            vk::DeviceSize offset = 0;
+            for (size_t i = 0; i < blasNum; ++i)
+            {
+                if (offset + scratchSizes[i] > stats.scratchSize)
+                {
+                    batches.emplace_back(begin, i);
+                    begin  = i;
+                    offset = 0;
+                }
+
+                scratchOffsets[i] = offset;
+                offset += scratchSizes[i];
+            }
+            batches.emplace_back(begin, blasNum);
+        }
+
+        // step 3 : create the original (not compacted) BLASes on one buffer and the shared scratch buffer
+        // (temporary, their ranges return to the pool after the compaction)
+        const auto storageUsage = vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+        const PooledBuffer storageBuffer(mDevice, mMeshPool.getMemoryPool(), vk::BufferCreateInfo({}, stats.originalSize, storageUsage), MemoryUsage::eDeviceLocal);
+
+        const auto scratchUsage                = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+        const PooledBuffer scratchBuffer(mDevice, mMeshPool.getMemoryPool(), vk::BufferCreateInfo({}, stats.scratchSize + kScratchAlignment, scratchUsage), MemoryUsage::eDeviceLocal);
+        const vk::DeviceAddress scratchAddress = alignUp(scratchBuffer.getDeviceAddress(), kScratchAlignment);
+
+        std::vector<vk::UniqueAccelerationStructureKHR> originals;
+        std::vector<vk::AccelerationStructureKHR> originalHandles;
+        originals.reserve(blasNum);
+        originalHandles.reserve(blasNum);
+        for (size_t i = 0; i < blasNum; ++i)
+        {
+            const vk::AccelerationStructureCreateInfoKHR ci({}, storageBuffer.getVkBuffer(), asOffsets[i], asSizes[i], vk::AccelerationStructureTypeKHR::eBottomLevel);
+            originals.emplace_back(vkDevice->createAccelerationStructureKHRUnique(ci));
+            originalHandles.emplace_back(originals.back().get());
+
+            buildInfos[i].dstAccelerationStructure  = originals.back().get();
+            buildInfos[i].scratchData.deviceAddress = scratchAddress + scratchOffsets[i];
+        }
+
+        vk::UniqueQueryPool queryPool = vkDevice->createQueryPoolUnique(vk::QueryPoolCreateInfo({}, vk::QueryType::eAccelerationStructureCompactedSizeKHR, static_cast<uint32_t>(blasNum)));
+
+        UniqueHandle<vk2s::Fence> fence = mDevice.create<vk2s::Fence>();
+        UniqueHandle<vk2s::Command> cmd = mDevice.create<vk2s::Command>();
+
+        // step 4 : build all BLASes and query the compacted sizes in one command
+        {
+            const vk::MemoryBarrier barrier(vk::AccessFlagBits::eAccelerationStructureWriteKHR, vk::AccessFlagBits::eAccelerationStructureReadKHR | vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+
+            fence->reset();
+            cmd->begin(true);
+            auto& commandBuffer = cmd->getVkCommandBuffer();
+
+            commandBuffer->resetQueryPool(queryPool.get(), 0, static_cast<uint32_t>(blasNum));
+
+            for (const auto& [begin, end] : batches)
+            {
+                std::vector<const vk::AccelerationStructureBuildRangeInfoKHR*> pRanges;
+                for (size_t i = begin; i < end; ++i)
+                {
+                    pRanges.emplace_back(&ranges[i]);
+                }
+
+                commandBuffer->buildAccelerationStructuresKHR(static_cast<uint32_t>(end - begin), buildInfos.data() + begin, pRanges.data());
+
+                // the next batch reuses the scratch buffer, and the query reads the results
+                commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, {}, barrier, {}, {});
+            }
+
+            commandBuffer->writeAccelerationStructuresPropertiesKHR(originalHandles, vk::QueryType::eAccelerationStructureCompactedSizeKHR, queryPool.get(), 0);
+
+            cmd->end();
+            cmd->execute(fence);
+            fence->wait();
+        }
+
+        const auto compactedSizes = vkDevice->getQueryPoolResults<vk::DeviceSize>(queryPool.get(), 0, static_cast<uint32_t>(blasNum), blasNum * sizeof(vk::DeviceSize), sizeof(vk::DeviceSize), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait).value;
+
+        // step 5 : copy into the compacted BLASes
+        {
+            fence->reset();
+            cmd->begin(true);
+            auto& commandBuffer = cmd->getVkCommandBuffer();
+
+            for (size_t i = 0; i < blasNum; ++i)
+            {
+                auto blas = std::make_shared<BLAS>(mDevice, mMeshPool.getMemoryPool(), compactedSizes[i]);
+                commandBuffer->copyAccelerationStructureKHR(vk::CopyAccelerationStructureInfoKHR(originalHandles[i], blas->getVkAccelerationStructure(), vk::CopyAccelerationStructureModeKHR::eCompact));
+
+                stats.compactedSize += compactedSizes[i];
+                mPendingGeometries[i]->blas = std::move(blas);
+            }
+
+            cmd->end();
+            cmd->execute(fence);
+            fence->wait();
+        }
+
+        mPendingGeometries.clear();
+
+        std::cout << "BLAS: built " << stats.blasNum << " in " << batches.size() << " batch(es), " << toMiB(stats.originalSize) << " MiB -> " << toMiB(stats.compactedSize) << " MiB after compaction (scratch " << toMiB(stats.scratchSize) << " MiB)" << std::endl;
+
+        const auto poolStats = mMeshPool.getMemoryPool().getStats(MemoryUsage::eDeviceLocal);
+        std::cout << "BLAS: device-local pool holds " << poolStats.allocationNum << " allocation(s) in " << poolStats.blockNum << " block(s), " << toMiB(poolStats.usedSize) << " / " << toMiB(poolStats.reservedSize) << " MiB" << std::endl;
+
+        return stats;
+    }
+}  // namespace palm
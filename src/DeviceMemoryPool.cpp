@@ -0,0 +1,413 @@
+/*****************************************************************/ /**
+ * @file   DeviceMemoryPool.cpp
+ * @brief  source file of DeviceMemoryPool, PooledBuffer and PooledImage classes
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/DeviceMemoryPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace palm
+{
+    namespace
+    {
+        constexpr vk::DeviceSize alignUp(const vk::DeviceSize value, const vk::DeviceSize alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }  // namespace
+
+    DeviceMemoryPool::DeviceMemoryPool(vk2s::Device& device)
+        : mDevice(device)
+    {
+        const auto& physicalDevice = mDevice.getVkPhysicalDevice();
+        mMemoryProperties          = physicalDevice.getMemoryProperties();
+        mGranularity               = std::max<vk::DeviceSize>(physicalDevice.getProperties().limits.bufferImageGranularity, 1);
+    }
+
+    DeviceMemoryPool::~DeviceMemoryPool()
+    {
+        for (auto& blocks : mBlocks)
+        {
+            for (auto& block : blocks)
+            {
+                if (block)
+                {
+                    destroyBlock(block);
+                }
+            }
+        }
+    }
+
+    DeviceMemoryPool::Allocation DeviceMemoryPool::allocate(const vk::MemoryRequirements& requirements, const MemoryUsage usage)
+    {
+        // buffers and images may share a block, so every range is kept apart by the granularity
+        const vk::DeviceSize alignment = std::max(requirements.alignment, mGranularity);
+        const vk::DeviceSize size      = alignUp(requirements.size, mGranularity);
+        const uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, usage);
+        auto& blocks                   = mBlocks[static_cast<size_t>(usage)];
+
+        const auto makeAllocation = [&](const uint32_t blockIndex, const vk::DeviceSize offset)
+        {
+            auto& block = *blocks[blockIndex];
+            ++block.allocationNum;
+            block.usedSize += size;
+
+            return Allocation{
+                .memory          = block.memory,
+                .offset          = offset,
+                .size            = size,
+                .pMapped         = block.pMapped ? reinterpret_cast<std::uint8_t*>(block.pMapped) + offset : nullptr,
+                .usage           = usage,
+                .blockIndex      = blockIndex,
+                .memoryTypeIndex = memoryTypeIndex,
+            };
+        };
+
+        // large resources get a block of their own
+        if (size > kBlockSize / 2)
+        {
+            return makeAllocation(insertBlock(usage, createBlock(size, memoryTypeIndex, usage, true)), 0);
+        }
+
+        // first fit in the existing blocks
+        for (uint32_t i = 0; i < blocks.size(); ++i)
+        {
+            if (!blocks[i] || blocks[i]->dedicated || blocks[i]->memoryTypeIndex != memoryTypeIndex)
+            {
+                continue;
+            }
+
+            auto& freeRanges = blocks[i]->freeRanges;
+            for (auto itr = freeRanges.begin(); itr != freeRanges.end(); ++itr)
+            {
+                const auto [rangeOffset, rangeSize] = *itr;
+                const vk::DeviceSize offset         = alignUp(rangeOffset, alignment);
+                if (offset + size > rangeOffset + rangeSize)
+                {
+                    continue;
+                }
+
+                // the padding before and the rest after the allocation stay free
+                freeRanges.erase(itr);
+                if (offset > rangeOffset)
+                {
+                    freeRanges.emplace(rangeOffset, offset - rangeOffset);
+                }
+                if (offset + size < rangeOffset + rangeSize)
+                {
+                    freeRanges.emplace(offset + size, rangeOffset + rangeSize - offset - size);
+                }
+
+                return makeAllocation(i, offset);
+            }
+        }
+
+        // no block has room
+        auto block = createBlock(kBlockSize, memoryTypeIndex, usage, false);
+        block->freeRanges.emplace(size, kBlockSize - size);
+
+        return makeAllocation(insertBlock(usage, std::move(block)), 0);
+    }
+
+    void DeviceMemoryPool::free(const Allocation& allocation)
+    {
+        auto& blocks = mBlocks[static_cast<size_t>(allocation.usage)];
+        auto& block  = blocks[allocation.blockIndex];
+
+        --block->allocationNum;
+        block->usedSize -= allocation.size;
+
+        if (block->dedicated)
+        {
+            destroyBlock(block);
+            return;
+        }
+
+        // return the range (merged with adjacent free ranges)
+        auto& freeRanges      = block->freeRanges;
+        vk::DeviceSize offset = allocation.offset;
+        vk::DeviceSize size   = allocation.size;
+
+        if (const auto next = freeRanges.find(offset + size); next != freeRanges.end())
+        {
+            size += next->second;
+            freeRanges.erase(next);
+        }
+
+        bool merged = false;
+        if (auto prev = freeRanges.lower_bound(offset); prev != freeRanges.begin())
+        {
+            --prev;
+            if (prev->first + prev->second == offset)
+            {
+                prev->second += size;
+                merged = true;
+            }
+        }
+
+        if (!merged)
+        {
+            freeRanges.emplace(offset, size);
+        }
+
+        // an empty block is freed if another empty one is kept for the usage
+        if (block->allocationNum == 0)
+        {
+            const bool hasSpare = std::any_of(blocks.begin(), blocks.end(), [&](const std::unique_ptr<Block>& other) { return other && other != block && !other->dedicated && other->allocationNum == 0; });
+            if (hasSpare)
+            {
+                destroyBlock(block);
+            }
+        }
+    }
+
+    DeviceMemoryPool::Stats DeviceMemoryPool::getStats(const MemoryUsage usage) const
+    {
+        Stats stats;
+        for (const auto& block : mBlocks[static_cast<size_t>(usage)])
+        {
+            if (!block)
+            {
+                continue;
+            }
+
+            ++stats.blockNum;
+            stats.allocationNum += block->allocationNum;
+            stats.reservedSize += block->size;
+            stats.usedSize += block->usedSize;
+        }
+
+        return stats;
+    }
+
+    uint32_t DeviceMemoryPool::findMemoryType(const uint32_t typeBits, const MemoryUsage usage) const
+    {
+        using Flags = vk::MemoryPropertyFlagBits;
+
+        vk::MemoryPropertyFlags required;
+        vk::MemoryPropertyFlags preferred;
+        switch (usage)
+        {
+        case MemoryUsage::eDeviceLocal:
+            required  = Flags::eDeviceLocal;
+            preferred = required;
+            break;
+        case MemoryUsage::eUpload:
+            required  = Flags::eHostVisible | Flags::eHostCoherent;
+            preferred = required;
+            break;
+        case MemoryUsage::eReadback:
+            required  = Flags::eHostVisible | Flags::eHostCoherent;
+            preferred = required | Flags::eHostCached;
+            break;
+        default:
+            break;
+        }
+
+        for (const auto flags : { preferred, required })
+        {
+            for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; ++i)
+            {
+                if ((typeBits & (1u << i)) && (mMemoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+                {
+                    return i;
+                }
+            }
+        }
+
+        throw std::runtime_error("no memory type is suitable for the pooled resource");
+    }
+
+    std::unique_ptr<DeviceMemoryPool::Block> DeviceMemoryPool::createBlock(const vk::DeviceSize size, const uint32_t memoryTypeIndex, const MemoryUsage usage, const bool dedicated)
+    {
+        auto& vkDevice = mDevice.getVkDevice();
+
+        // pooled buffers may be referred to by device addresses (e.g. acceleration structure storage)
+        const vk::MemoryAllocateFlagsInfo flagsInfo(vk::MemoryAllocateFlagBits::eDeviceAddress);
+        const vk::MemoryAllocateInfo ai(size, memoryTypeIndex, &flagsInfo);
+
+        auto block             = std::make_unique<Block>();
+        block->memory          = vkDevice->allocateMemory(ai);
+        block->size            = size;
+        block->memoryTypeIndex = memoryTypeIndex;
+        block->dedicated       = dedicated;
+
+        if (usage != MemoryUsage::eDeviceLocal)
+        {
+            block->pMapped = vkDevice->mapMemory(block->memory, 0, size);
+        }
+
+        return block;
+    }
+
+    uint32_t DeviceMemoryPool::insertBlock(const MemoryUsage usage, std::unique_ptr<Block> block)
+    {
+        auto& blocks = mBlocks[static_cast<size_t>(usage)];
+
+        const auto itr = std::find(blocks.begin(), blocks.end(), nullptr);
+        if (itr != blocks.end())
+        {
+            *itr = std::move(block);
+            return static_cast<uint32_t>(itr - blocks.begin());
+        }
+
+        blocks.emplace_back(std::move(block));
+        return static_cast<uint32_t>(blocks.size() - 1);
+    }
+
+    void DeviceMemoryPool::destroyBlock(std::unique_ptr<Block>& block)
+    {
+        auto& vkDevice = mDevice.getVkDevice();
+        if (block->pMapped)
+        {
+            vkDevice->unmapMemory(block->memory);
+        }
+        vkDevice->freeMemory(block->memory);
+        block.reset();
+    }
+
+    PooledBuffer::PooledBuffer(vk2s::Device& device, DeviceMemoryPool& pool, const vk::BufferCreateInfo& ci, const MemoryUsage usage)
+        : mDevice(device)
+        , mPool(pool)
+        , mSize(ci.size)
+    {
+        auto& vkDevice = device.getVkDevice();
+
+        mBuffer     = vkDevice->createBuffer(ci);
+        mAllocation = pool.allocate(vkDevice->getBufferMemoryRequirements(mBuffer), usage);
+        vkDevice->bindBufferMemory(mBuffer, mAllocation.memory, mAllocation.offset);
+    }
+
+    PooledBuffer::~PooledBuffer()
+    {
+        mDevice.getVkDevice()->destroyBuffer(mBuffer);
+        mPool.free(mAllocation);
+    }
+
+    vk::DeviceAddress PooledBuffer::getDeviceAddress() const
+    {
+        return mDevice.getVkDevice()->getBufferAddress(vk::BufferDeviceAddressInfo(mBuffer));
+    }
+
+    void PooledBuffer::bind(Handle<vk2s::BindGroup> bindGroup, const uint32_t binding, const vk::DescriptorType type, const vk::DeviceSize range) const
+    {
+        const vk::DescriptorBufferInfo bufferInfo(mBuffer, 0, range);
+
+        vk::WriteDescriptorSet write;
+        write.dstSet          = bindGroup->getVkDescriptorSet().get();
+        write.dstBinding      = binding;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+        write.descriptorType  = type;
+        write.pBufferInfo     = &bufferInfo;
+
+        mDevice.getVkDevice()->updateDescriptorSets(write, {});
+    }
+
+    void PooledBuffer::write(const void* pData, const size_t size, const vk::DeviceSize offset) const
+    {
+        if (!mAllocation.pMapped || offset + size > mSize)
+        {
+            throw std::runtime_error("the pooled buffer is not mapped or the range is out of the buffer");
+        }
+
+        std::memcpy(static_cast<std::uint8_t*>(mAllocation.pMapped) + offset, pData, size);
+    }
+
+    PooledImage::PooledImage(vk2s::Device& device, DeviceMemoryPool& pool, const vk::ImageCreateInfo& ci, const vk::ImageAspectFlags aspect)
+        : mDevice(device)
+        , mPool(pool)
+        , mExtent(ci.extent)
+    {
+        auto& vkDevice = device.getVkDevice();
+
+        mImage      = vkDevice->createImage(ci);
+        mAllocation = pool.allocate(vkDevice->getImageMemoryRequirements(mImage), MemoryUsage::eDeviceLocal);
+        bindMemory(ci, aspect);
+    }
+
+    PooledImage::PooledImage(vk2s::Device& device, const PooledImage& aliased, const vk::ImageCreateInfo& ci, const vk::ImageAspectFlags aspect)
+        : mDevice(device)
+        , mPool(aliased.mPool)
+        , mAlias(true)
+        , mExtent(ci.extent)
+    {
+        auto& vkDevice = device.getVkDevice();
+
+        mImage                  = vkDevice->createImage(ci);
+        const auto requirements = vkDevice->getImageMemoryRequirements(mImage);
+        mAllocation             = aliased.mAllocation;
+
+        if (requirements.size > mAllocation.size || mAllocation.offset % requirements.alignment != 0 || !(requirements.memoryTypeBits & (1u << mAllocation.memoryTypeIndex)))
+        {
+            vkDevice->destroyImage(mImage);
+            throw std::runtime_error("the image does not fit in the memory of the aliased image");
+        }
+
+        bindMemory(ci, aspect);
+    }
+
+    PooledImage::~PooledImage()
+    {
+        auto& vkDevice = mDevice.getVkDevice();
+        vkDevice->destroyImageView(mImageView);
+        vkDevice->destroyImage(mImage);
+
+        if (!mAlias)
+        {
+            mPool.free(mAllocation);
+        }
+    }
+
+    void PooledImage::bind(Handle<vk2s::BindGroup> bindGroup, const uint32_t binding, const vk::DescriptorType type, const vk::ImageLayout layout) const
+    {
+        const vk::DescriptorImageInfo imageInfo({}, mImageView, layout);
+
+        vk::WriteDescriptorSet write;
+        write.dstSet          = bindGroup->getVkDescriptorSet().get();
+        write.dstBinding      = binding;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+        write.descriptorType  = type;
+        write.pImageInfo      = &imageInfo;
+
+        mDevice.getVkDevice()->updateDescriptorSets(write, {});
+    }
+
+    void PooledImage::recordTransition(Handle<vk2s::Command> command, const vk::ImageLayout from, const vk::ImageLayout to) const
+    {
+        vk::ImageMemoryBarrier barrier;
+        // a full barrier, as the transitions are recorded only on (re)creation and when an alias takes over the memory
+        barrier.srcAccessMask       = vk::AccessFlagBits::eMemoryWrite;
+        barrier.dstAccessMask       = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+        barrier.oldLayout           = from;
+        barrier.newLayout           = to;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image               = mImage;
+        barrier.subresourceRange    = mSubresourceRange;
+
+        command->getVkCommandBuffer()->pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands, {}, {}, {}, barrier);
+    }
+
+    void PooledImage::bindMemory(const vk::ImageCreateInfo& ci, const vk::ImageAspectFlags aspect)
+    {
+        auto& vkDevice = mDevice.getVkDevice();
+        vkDevice->bindImageMemory(mImage, mAllocation.memory, mAllocation.offset);
+
+        mSubresourceRange = vk::ImageSubresourceRange(aspect, 0, ci.mipLevels, 0, ci.arrayLayers);
+
+        vk::ImageViewCreateInfo vci;
+        vci.image            = mImage;
+        vci.viewType         = ci.imageType == vk::ImageType::e3D ? vk::ImageViewType::e3D : (ci.arrayLayers > 1 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D);
+        vci.format           = ci.format;
+        vci.subresourceRange = mSubresourceRange;
+        mImageView           = vkDevice->createImageView(vci);
+    }
+}  // namespace palm
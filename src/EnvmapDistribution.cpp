@@ -0,0 +1,196 @@
+/*****************************************************************/ /**
+ * @file   EnvmapDistribution.cpp
+ * @brief  source file of EnvmapDistribution class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/EnvmapDistribution.hpp"
+
+#include <stb_image.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+
+namespace palm
+{
+    DecodedEnvmap DecodedEnvmap::load(const std::filesystem::path& path)
+    {
+        const std::string pathStr = path.string();
+
+        DecodedEnvmap ret;
+        int width = 0, height = 0, channels = 0;
+        void* pPixels    = nullptr;
+        size_t texelSize = 0;
+
+        // radiance is kept in float for HDR images, so that the sun is not clamped
+        if (stbi_is_hdr(pathStr.c_str()))
+        {
+            pPixels    = stbi_loadf(pathStr.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            ret.format = vk::Format::eR32G32B32A32Sfloat;
+            texelSize  = sizeof(float) * STBI_rgb_alpha;
+        }
+        else
+        {
+            pPixels    = stbi_load(pathStr.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            ret.format = vk::Format::eR8G8B8A8Unorm;
+            texelSize  = sizeof(stbi_uc) * STBI_rgb_alpha;
+        }
+
+        if (!pPixels)
+        {
+            throw std::runtime_error(std::string("failed to decode the image (") + stbi_failure_reason() + ")");
+        }
+
+        ret.width  = static_cast<uint32_t>(width);
+        ret.height = static_cast<uint32_t>(height);
+        ret.texels.resize(static_cast<size_t>(width) * height * texelSize);
+        std::memcpy(ret.texels.data(), pPixels, ret.texels.size());
+        stbi_image_free(pPixels);
+
+        return ret;
+    }
+
+    EnvmapDistribution::EnvmapDistribution(const void* pTexels, const vk::Format format, const uint32_t width, const uint32_t height)
+        : mWidth(width)
+        , mHeight(height)
+    {
+        if (!isSupportedFormat(format))
+        {
+            throw std::runtime_error("invalid texture format for building the envmap distribution!");
+        }
+
+        mData.resize(kHeaderSize + (height + 1) + static_cast<size_t>(height) * (width + 1));
+        mData[0] = std::bit_cast<float>(width);
+        mData[1] = std::bit_cast<float>(height);
+
+        float* const pMarginal    = mData.data() + kHeaderSize;
+        float* const pConditional = pMarginal + height + 1;
+
+        const auto luminance = [&](const size_t index) -> double
+        {
+            double rgb[3] = {};
+            switch (format)
+            {
+            case vk::Format::eR32G32B32A32Sfloat:
+            {
+                const float* p = reinterpret_cast<const float*>(pTexels) + index * 4;
+                rgb[0] = p[0], rgb[1] = p[1], rgb[2] = p[2];
+                break;
+            }
+            case vk::Format::eR8G8B8A8Srgb:
+            {
+                const uint8_t* p = reinterpret_cast<const uint8_t*>(pTexels) + index * 4;
+                for (int c = 0; c < 3; ++c)
+                {
+                    const double v = p[c] / 255.0;
+                    rgb[c]         = v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+                }
+                break;
+            }
+            default:  // eR8G8B8A8Unorm
+            {
+                const uint8_t* p = reinterpret_cast<const uint8_t*>(pTexels) + index * 4;
+                rgb[0] = p[0] / 255.0, rgb[1] = p[1] / 255.0, rgb[2] = p[2] / 255.0;
+                break;
+            }
+            }
+
+            // ITU-R (same as Emitter::toGray()), invalid texels are never sampled
+            const double ret = 0.299 * rgb[0] + 0.587 * rgb[1] + 0.114 * rgb[2];
+            return std::isfinite(ret) ? std::max(ret, 0.0) : 0.0;
+        };
+
+        // step 1 : conditional CDF of each row and the integral of the row weighted by sin(theta)
+        std::vector<double> rowIntegrals(height, 0.0);
+        {
+            omp_set_num_threads(omp_get_max_threads());
+#pragma omp parallel for schedule(dynamic)
+            for (int v = 0; v < static_cast<int>(height); ++v)  // int for OpenMP
+            {
+                const size_t rowHead = static_cast<size_t>(v) * width;
+                float* pCDF          = pConditional + static_cast<size_t>(v) * (width + 1);
+
+                double sum = 0.0;
+                for (uint32_t u = 0; u < width; ++u)
+                {
+                    sum += luminance(rowHead + u);
+                }
+
+                // black rows are sampled uniformly (their marginal probability is 0 anyway)
+                double partial = 0.0;
+                pCDF[0]        = 0.f;
+                for (uint32_t u = 0; u < width; ++u)
+                {
+                    partial += luminance(rowHead + u);
+                    pCDF[u + 1] = sum > 0.0 ? static_cast<float>(partial / sum) : static_cast<float>(u + 1) / width;
+                }
+                pCDF[width] = 1.f;
+
+                const double sinTheta = std::sin(std::numbers::pi * (v + 0.5) / height);
+                rowIntegrals[v]       = sum * sinTheta;
+            }
+        }
+
+        // step 2 : marginal CDF over the rows (uniform if the envmap is black)
+        {
+            double sum = 0.0;
+            for (const double integral : rowIntegrals)
+            {
+                sum += integral;
+            }
+
+            double partial = 0.0;
+            pMarginal[0]   = 0.f;
+            for (uint32_t v = 0; v < height; ++v)
+            {
+                partial += rowIntegrals[v];
+                pMarginal[v + 1] = sum > 0.0 ? static_cast<float>(partial / sum) : static_cast<float>(v + 1) / height;
+            }
+            pMarginal[height] = 1.f;
+
+            // each texel covers (2 pi / width) * (pi / height) * sin(theta) steradians of 4 pi
+            mAverageLuminance = static_cast<float>(sum * std::numbers::pi / (2.0 * width * height));
+        }
+    }
+
+    bool EnvmapDistribution::isSupportedFormat(const vk::Format format)
+    {
+        return format == vk::Format::eR8G8B8A8Unorm || format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eR32G32B32A32Sfloat;
+    }
+
+    std::span<const float> EnvmapDistribution::getData() const
+    {
+        return mData;
+    }
+
+    std::span<const float> EnvmapDistribution::getUniformData()
+    {
+        // width and height of 0
+        constexpr static float kUniform[kHeaderSize] = { 0.f, 0.f };
+        return kUniform;
+    }
+
+    float EnvmapDistribution::getAverageLuminance() const
+    {
+        return mAverageLuminance;
+    }
+
+    uint32_t EnvmapDistribution::getWidth() const
+    {
+        return mWidth;
+    }
+
+    uint32_t EnvmapDistribution::getHeight() const
+    {
+        return mHeight;
+    }
+}  // namespace palm
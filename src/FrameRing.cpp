@@ -0,0 +1,79 @@
+/*****************************************************************/ /**
+ * @file   FrameRing.cpp
+ * @brief  source file of FrameRing class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/FrameRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace palm
+{
+    namespace
+    {
+        constexpr vk::DeviceSize alignUp(const vk::DeviceSize value, const vk::DeviceSize alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }  // namespace
+
+    FrameRing::FrameRing(vk2s::Device& device, DeviceMemoryPool& memoryPool, const vk::DeviceSize regionSize, const uint32_t frameCount)
+        : mDevice(device)
+        , mRegionSize(alignUp(regionSize, kAlignment))
+        , mBuffer(device, memoryPool, vk::BufferCreateInfo({}, mRegionSize * frameCount, vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer), MemoryUsage::eUpload)
+        , mpMapped(reinterpret_cast<std::uint8_t*>(mBuffer.getMappedPointer()))
+    {
+    }
+
+    void FrameRing::begin(const uint32_t frameIndex)
+    {
+        mRegionOffset = mRegionSize * frameIndex;
+        mHead         = 0;
+    }
+
+    uint32_t FrameRing::allocate(const vk::DeviceSize size, void** ppMapped)
+    {
+        const vk::DeviceSize offset = mHead;
+        if (offset + size > mRegionSize)
+        {
+            throw std::runtime_error("frame ring exhausted (region size: " + std::to_string(mRegionSize) + " bytes)");
+        }
+
+        mHead = alignUp(offset + size, kAlignment);
+        mPeak = std::max(mPeak, mHead);
+
+        *ppMapped = mpMapped + mRegionOffset + offset;
+        return static_cast<uint32_t>(mRegionOffset + offset);
+    }
+
+    uint32_t FrameRing::push(const void* pData, const vk::DeviceSize size)
+    {
+        void* p               = nullptr;
+        const uint32_t offset = allocate(size, &p);
+        std::memcpy(p, pData, size);
+
+        return offset;
+    }
+
+    void FrameRing::bind(Handle<vk2s::BindGroup> bindGroup, const uint32_t binding, const vk::DeviceSize range) const
+    {
+        // the range is fixed in the descriptor, and each draw selects its data by the dynamic offset
+        const vk::DescriptorBufferInfo bufferInfo(mBuffer.getVkBuffer(), 0, range);
+
+        vk::WriteDescriptorSet write;
+        write.dstSet          = bindGroup->getVkDescriptorSet().get();
+        write.dstBinding      = binding;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+        write.descriptorType  = vk::DescriptorType::eUniformBufferDynamic;
+        write.pBufferInfo     = &bufferInfo;
+
+        mDevice.getVkDevice()->updateDescriptorSets(write, {});
+    }
+}  // namespace palm
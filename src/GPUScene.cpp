@@ -0,0 +1,825 @@
+/*****************************************************************/ /**
+ * @file   GPUScene.cpp
+ * @brief  source file of GPUScene class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/GPUScene.hpp"
+
+#include "../include/Mesh.hpp"
+#include "../include/MeshPool.hpp"
+#include "../include/Transform.hpp"
+#include "../include/BLASBuilder.hpp"
+#include "../include/UploadBatch.hpp"
+#include "../include/AliasTable.hpp"
+
+#include "omp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numbers>
+
+namespace palm
+{
+    namespace
+    {
+        constexpr float kPi = std::numbers::pi_v<float>;
+        //! Relative change of the metric of a world matrix under which the areas of faces are regarded as unchanged
+        constexpr float kMetricTolerance = 1e-5f;
+
+        // ITU-R (same as Emitter::toGray())
+        float luminance(const glm::vec3& c)
+        {
+            return 0.299f * c.r + 0.587f * c.g + 0.114f * c.b;
+        }
+    }  // namespace
+
+    GPUScene::GPUScene(vk2s::Device& device, ec2s::Registry& scene, MeshPool& meshPool)
+        : mDevice(device)
+        , mScene(scene)
+        , mMeshPool(meshPool)
+    {
+        createDummyTexture();
+
+        mScene.each<Emitter>(
+            [&](const Emitter& emitter)
+            {
+                switch (emitter.params.type)
+                {
+                case static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::ePoint):
+                    ++mEmitterNum;
+                    break;
+                case static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eArea):
+                    mEmitterNum += emitter.params.faceNum;
+                    break;
+                case static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eInfinite):
+                    ++mEmitterNum;
+                    break;
+                }
+            });
+
+        // geometry shared by instances -> index in the geometry table (instanceCustomIndex)
+        std::unordered_map<const MeshGeometry*, uint32_t> geometryIndices;
+
+        // static scene data live in device-local memory (edits are copied by recordUpdate())
+        // (suballocated from the memory pool of the mesh pool instead of one allocation per buffer)
+        const auto usage        = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+        const auto createBuffer = [&](const vk::DeviceSize size) { return std::make_unique<PooledBuffer>(mDevice, mMeshPool.getMemoryPool(), vk::BufferCreateInfo({}, size, usage), MemoryUsage::eDeviceLocal); };
+        UploadBatch uploadBatch(mDevice, getMemoryPool());
+        std::vector<InstanceParams> instanceParams;
+        std::vector<GeometryParams> geometryParams;
+        std::vector<Material::Params> materialParams;
+        std::vector<vk::AccelerationStructureInstanceKHR> asInstances;
+        std::vector<AliasTable::Bin> emitterBins;
+        std::vector<int32_t> instanceEmitters;
+
+        // assign stable indices in one pass over the registry (the instance index is shared by the instance, material and TLAS instance)
+        std::vector<ec2s::Entity> instances;
+        std::vector<const Mesh*> instanceMeshes;
+        std::vector<const Transform*> instanceTransforms;
+        std::vector<uint32_t> instanceGeometries;
+        mScene.each<Mesh, Transform>(
+            [&](const ec2s::Entity entity, const Mesh& mesh, const Transform& transform)
+            {
+                mInstanceIndices[entity] = static_cast<uint32_t>(instances.size());
+                instances.emplace_back(entity);
+                instanceMeshes.emplace_back(&mesh);
+                instanceTransforms.emplace_back(&transform);
+
+                if (!geometryIndices.contains(mesh.geometry.get()))
+                {
+                    geometryIndices[mesh.geometry.get()] = static_cast<uint32_t>(geometryParams.size());
+                    uint32_t flags = 0;
+                    flags |= mesh.geometry->vertexFormat == VertexFormat::eCompact ? GeometryParams::kCompactVertexFlag : 0;
+                    flags |= mesh.geometry->indexType == vk::IndexType::eUint16 ? GeometryParams::kIndex16Flag : 0;
+
+                    geometryParams.emplace_back(GeometryParams{
+                        .firstVertex = mesh.geometry->firstVertex,
+                        .firstIndex  = mesh.geometry->firstIndex,
+                        .indexCount  = mesh.geometry->indexCount,
+                        .flags       = flags,
+                    });
+                }
+                instanceGeometries.emplace_back(geometryIndices[mesh.geometry.get()]);
+            });
+
+        // flatten instances and TLAS instances in parallel (each element depends only on its instance)
+        {
+            vk::AccelerationStructureInstanceKHR templateDesc{};
+            templateDesc.instanceCustomIndex                    = 0;
+            templateDesc.mask                                   = 0xFF;
+            templateDesc.flags                                  = 0;
+            templateDesc.instanceShaderBindingTableRecordOffset = 0;
+
+            instanceParams.resize(instances.size());
+            asInstances.resize(instances.size(), templateDesc);
+
+#pragma omp parallel for
+            for (int i = 0; i < static_cast<int>(instances.size()); ++i)
+            {
+                const auto& transform           = *instanceTransforms[i];
+                instanceParams[i].world         = transform.params.world;
+                instanceParams[i].worldInvTrans = transform.params.worldInvTranspose;
+
+                auto& asInstance                          = asInstances[i];
+                asInstance.instanceCustomIndex            = instanceGeometries[i];
+                asInstance.transform                      = transform.params.convert();
+                asInstance.accelerationStructureReference = instanceMeshes[i]->geometry->blas->getVkDeviceAddress();
+            }
+        }
+
+        // materials are indexed by the instance (instances without Material are drawn with the default parameters)
+        // the texture table is filled in this order, so it is kept sequential
+        materialParams.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); ++i)
+        {
+            if (mScene.contains<Material>(instances[i]))
+            {
+                materialParams[i] = *resolveTextureIndices(mScene.get<Material>(instances[i]), true);
+            }
+        }
+
+        // create instance buffer
+        {
+            const auto size = sizeof(InstanceParams) * std::max(instanceParams.size(), size_t(1));
+            mInstanceBuffer = createBuffer(size);
+            uploadBatch.addBuffer(mInstanceBuffer->getVkBuffer(), instanceParams.data(), sizeof(InstanceParams) * instanceParams.size());
+        }
+
+        // create geometry table (ranges in the global buffers of the pool)
+        {
+            const auto size = sizeof(GeometryParams) * std::max(geometryParams.size(), size_t(1));
+            mGeometryBuffer = createBuffer(size);
+            uploadBatch.addBuffer(mGeometryBuffer->getVkBuffer(), geometryParams.data(), sizeof(GeometryParams) * geometryParams.size());
+        }
+
+        // create material buffer
+        {
+            const auto size = sizeof(Material::Params) * std::max(materialParams.size(), size_t(1));
+            mMaterialBuffer = createBuffer(size);
+            uploadBatch.addBuffer(mMaterialBuffer->getVkBuffer(), materialParams.data(), sizeof(Material::Params) * materialParams.size());
+        }
+
+        // create emitter buffer
+        std::span<const float> envmapDistribution = EnvmapDistribution::getUniformData();
+        {
+            std::vector<Emitter::Params>& params = mEmitterParams;
+
+            // WARN: ensures that the infinity light source is the first element of the emitterParams if exists
+            mScene.each<Emitter>(
+                [&](const ec2s::Entity entity, Emitter& emitter)
+                {
+                    if (emitter.params.type != static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eInfinite))
+                    {
+                        return;
+                    }
+
+                    // register envmap texture and its distribution for importance sampling (built once per envmap)
+                    if (emitter.emissiveTex)
+                    {
+                        emitter.params.texIndex = registerTexture(emitter.emissiveTex);
+
+                        // the shaders sample the envmap of the first element only
+                        if (params.empty())
+                        {
+                            if (!emitter.distribution)
+                            {
+                                emitter.buildDistribution(mDevice, getMemoryPool());
+                            }
+                            envmapDistribution = emitter.distribution->getData();
+                        }
+                    }
+
+                    emitter.params.pos      = glm::vec3(0.0);
+                    mEmitterIndices[entity] = static_cast<uint32_t>(params.size());
+                    params.emplace_back(emitter.params);
+                });
+
+            // for emitter with transform
+            mScene.each<Emitter, Transform>(
+                [&](const ec2s::Entity entity, Emitter& emitter, Transform& transform)
+                {
+                    if (emitter.params.type == static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eInfinite))
+                    {
+                        return;
+                    }
+
+                    emitter.params.pos           = transform.pos;
+                    emitter.params.firstTriangle = -1;
+
+                    if (mScene.contains<Mesh>(entity))
+                    {
+                        const Mesh& mesh             = mScene.get<Mesh>(entity);
+                        emitter.params.meshIndex     = geometryIndices[mesh.geometry.get()];
+                        emitter.params.instanceIndex = mInstanceIndices[entity];
+
+                        const bool isArea = emitter.params.type == static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eArea);
+
+                        // object-space faces for their power and bounds (read back once per geometry)
+                        if (isArea && !mEmissiveFaces.contains(emitter.params.meshIndex))
+                        {
+                            std::vector<Mesh::Vertex> vertices;
+                            std::vector<uint32_t> indices;
+                            mMeshPool.download(*mesh.geometry, vertices, indices);
+
+                            auto& faces = mEmissiveFaces[emitter.params.meshIndex];
+                            faces.reserve(indices.size() / 3 * 3);
+                            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+                            {
+                                faces.emplace_back(vertices[indices[i]].pos);
+                                faces.emplace_back(vertices[indices[i + 1]].pos);
+                                faces.emplace_back(vertices[indices[i + 2]].pos);
+                            }
+                        }
+
+                        // faces of area emitters are consecutive in the emissive triangle table and refer to this entry
+                        if (isArea)
+                        {
+                            const auto emitterIndex      = static_cast<uint32_t>(params.size());
+                            const auto faceNum           = static_cast<uint32_t>(mEmissiveFaces[emitter.params.meshIndex].size() / 3);
+                            emitter.params.firstTriangle = static_cast<int32_t>(mEmissiveTriangles.size());
+                            for (uint32_t primitive = 0; primitive < faceNum; ++primitive)
+                            {
+                                mEmissiveTriangles.emplace_back(EmissiveTriangle{ .emitterIndex = emitterIndex, .primitiveIndex = primitive, .area = 0.f, .power = 0.f });
+                            }
+                            updateEmissiveTriangles(emitter.params, transform.params.world);
+                        }
+                    }
+
+                    mEmitterIndices[entity] = static_cast<uint32_t>(params.size());
+                    params.emplace_back(emitter.params);
+                });
+
+            const auto size = sizeof(Emitter::Params) * std::max(params.size(), size_t(1));
+            mEmittersBuffer = createBuffer(size);
+            uploadBatch.addBuffer(mEmittersBuffer->getVkBuffer(), params.data(), sizeof(Emitter::Params) * params.size());
+        }
+
+        // create emissive triangle table
+        {
+            const auto size         = sizeof(EmissiveTriangle) * std::max(mEmissiveTriangles.size(), size_t(1));
+            mEmissiveTriangleBuffer = createBuffer(size);
+            uploadBatch.addBuffer(mEmissiveTriangleBuffer->getVkBuffer(), mEmissiveTriangles.data(), sizeof(EmissiveTriangle) * mEmissiveTriangles.size());
+        }
+
+        // create alias table of the emitters weighted by their power, and the first emitter of each instance (to look up the faces hit by BSDF sampling)
+        const auto emitterPowers = computeEmitterPowers();
+        mEmitterPowers           = emitterPowers;
+        {
+            emitterBins = AliasTable(emitterPowers).getBins();
+
+            const auto size     = sizeof(AliasTable::Bin) * std::max(emitterBins.size(), size_t(1));
+            mEmitterAliasBuffer = createBuffer(size);
+            uploadBatch.addBuffer(mEmitterAliasBuffer->getVkBuffer(), emitterBins.data(), sizeof(AliasTable::Bin) * emitterBins.size());
+
+            instanceEmitters.resize(std::max(instanceParams.size(), size_t(1)), -1);
+            for (const auto& params : mEmitterParams)
+            {
+                if (params.firstTriangle >= 0)
+                {
+                    instanceEmitters[params.instanceIndex] = static_cast<int32_t>(mEmitterParams.size()) + params.firstTriangle;
+                }
+            }
+
+            mInstanceEmitterBuffer = createBuffer(sizeof(int32_t) * instanceEmitters.size());
+            uploadBatch.addBuffer(mInstanceEmitterBuffer->getVkBuffer(), instanceEmitters.data(), sizeof(int32_t) * instanceEmitters.size());
+        }
+
+        // create light BVH over the bounded emitters (sized for all emitters so that it can be refit or rebuilt in place after edits)
+        {
+            const auto bounds  = computeEmitterBounds(emitterPowers);
+            mLightBVH          = std::make_unique<LightBVH>(bounds);
+            const auto& nodes  = mLightBVH->getNodes();
+            const auto& trails = mLightBVH->getTrails();
+
+            const auto nodeSize = sizeof(LightBVH::Node) * std::max(2 * (mEmitterParams.size() + mEmissiveTriangles.size()), size_t(2));
+            mLightBVHBuffer     = createBuffer(nodeSize);
+            uploadBatch.addBuffer(mLightBVHBuffer->getVkBuffer(), nodes.data(), sizeof(LightBVH::Node) * nodes.size());
+
+            const auto trailSize = sizeof(uint64_t) * std::max(trails.size(), size_t(1));
+            mLightBVHTrailBuffer = createBuffer(trailSize);
+            uploadBatch.addBuffer(mLightBVHTrailBuffer->getVkBuffer(), trails.data(), sizeof(uint64_t) * trails.size());
+        }
+
+        // create envmap distribution buffer (the uniform one if no envmap is used)
+        {
+            const auto size           = envmapDistribution.size_bytes();
+            mEnvmapDistributionBuffer = createBuffer(size);
+            uploadBatch.addBuffer(mEnvmapDistributionBuffer->getVkBuffer(), envmapDistribution.data(), size);
+        }
+
+        // the binding cannot be empty, so the dummy is bound if no texture is used
+        if (mTextures.empty())
+        {
+            mTextures.emplace_back(mDummyTexture.get());
+        }
+
+        // upload instances, geometries, materials, emitters and their sampling data at once
+        uploadBatch.submit();
+
+        // create sampler (trilinear, the level is selected by the ray cones in the shaders)
+        {
+            vk::SamplerCreateInfo ci({}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear);
+            ci.maxLod = VK_LOD_CLAMP_NONE;
+            mSampler  = mDevice.create<vk2s::Sampler>(ci);
+        }
+
+        // create TLAS (updatable in place)
+        mTLAS = std::make_unique<TLAS>(mDevice, getMemoryPool(), asInstances);
+    }
+
+    GPUScene::~GPUScene()
+    {
+        // integrators using the scene resources may still be in flight
+        mDevice.waitIdle();
+        // WARN: VB, IB and textures have no ownership
+    }
+
+    bool GPUScene::applyDelta(const SceneDelta& delta)
+    {
+        // the GPU is idle here, so the copies recorded by the last recordUpdate() have been completed
+        mRetiredStagingBuffers.clear();
+
+        bool emittersChanged = !delta.emitters.empty();
+
+        // transforms : instance buffer and TLAS instances
+        for (const auto entity : delta.transforms)
+        {
+            if (!mScene.contains<Transform>(entity))
+            {
+                return false;
+            }
+
+            const auto& transform = mScene.get<Transform>(entity);
+
+            if (const auto itr = mInstanceIndices.find(entity); itr != mInstanceIndices.end())
+            {
+                const InstanceParams params{
+                    .world         = transform.params.world,
+                    .worldInvTrans = transform.params.worldInvTranspose,
+                };
+
+                queueBufferWrite(mInstanceBuffer->getVkBuffer(), &params, sizeof(InstanceParams), sizeof(InstanceParams) * itr->second);
+                mTLAS->setInstanceTransform(itr->second, transform.params.convert());
+            }
+
+            // emitters follow the position of the entity
+            if (mScene.contains<Emitter>(entity))
+            {
+                if (!updateEmitter(entity))
+                {
+                    return false;
+                }
+                emittersChanged = true;
+            }
+        }
+
+        // materials (materials of entities without an instance are never read by the shaders)
+        for (const auto entity : delta.materials)
+        {
+            const auto itr = mInstanceIndices.find(entity);
+            if (itr == mInstanceIndices.end())
+            {
+                if (mScene.contains<Mesh>(entity))
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            if (!mScene.contains<Material>(entity))
+            {
+                return false;
+            }
+
+            // a texture not bound yet changes the texture table
+            const auto texIndexModified = resolveTextureIndices(mScene.get<Material>(entity), false);
+            if (!texIndexModified)
+            {
+                return false;
+            }
+
+            queueBufferWrite(mMaterialBuffer->getVkBuffer(), &*texIndexModified, sizeof(Material::Params), sizeof(Material::Params) * itr->second);
+        }
+
+        // emitters
+        for (const auto entity : delta.emitters)
+        {
+            if (!updateEmitter(entity))
+            {
+                return false;
+            }
+        }
+
+        // the power of the emitters changes with their emissive and area (the number of bins is unchanged)
+        // and the bounds with their transform (the tree never has more nodes than the buffer allocated for all emitters)
+        if (emittersChanged && !mEmitterParams.empty())
+        {
+            const auto powers = computeEmitterPowers();
+
+            // moving or rotating emitters keeps their power, and the alias table is rebuilt only if a power has changed
+            if (powers != mEmitterPowers)
+            {
+                const AliasTable aliasTable(powers);
+                const auto& bins = aliasTable.getBins();
+                queueBufferWrite(mEmitterAliasBuffer->getVkBuffer(), bins.data(), sizeof(AliasTable::Bin) * bins.size(), 0);
+                mEmitterPowers = powers;
+            }
+
+            // the tree is refit in place while the same emitters are in it (only the changed nodes are rewritten)
+            const auto bounds = computeEmitterBounds(powers);
+            if (!mLightBVH->refit(bounds))
+            {
+                mLightBVH          = std::make_unique<LightBVH>(bounds);
+                const auto& trails = mLightBVH->getTrails();
+                queueBufferWrite(mLightBVHTrailBuffer->getVkBuffer(), trails.data(), sizeof(uint64_t) * trails.size(), 0);
+            }
+
+            const auto [first, last] = mLightBVH->getDirtyRange();
+            if (first < last)
+            {
+                queueBufferWrite(mLightBVHBuffer->getVkBuffer(), mLightBVH->getNodes().data() + first, sizeof(LightBVH::Node) * (last - first), sizeof(LightBVH::Node) * first);
+            }
+        }
+
+        return true;
+    }
+
+    void GPUScene::bind(Handle<vk2s::BindGroup> bindGroup)
+    {
+        // pooled buffers are written to the descriptor set directly
+        mTLAS->bind(bindGroup, 0);
+        mMeshPool.getVertexBuffer().bind(bindGroup, 4, vk::DescriptorType::eStorageBuffer);
+        mMeshPool.getIndexBuffer().bind(bindGroup, 5, vk::DescriptorType::eStorageBuffer);
+        mInstanceBuffer->bind(bindGroup, 6, vk::DescriptorType::eStorageBuffer);
+        mMaterialBuffer->bind(bindGroup, 7, vk::DescriptorType::eStorageBuffer);
+        mEmittersBuffer->bind(bindGroup, 8, vk::DescriptorType::eStorageBuffer);
+        bindGroup->bind(9, vk::DescriptorType::eSampledImage, mTextures);
+        bindGroup->bind(10, mSampler.get());
+        mGeometryBuffer->bind(bindGroup, 11, vk::DescriptorType::eStorageBuffer);
+        mEnvmapDistributionBuffer->bind(bindGroup, 15, vk::DescriptorType::eStorageBuffer);
+        mEmitterAliasBuffer->bind(bindGroup, 16, vk::DescriptorType::eStorageBuffer);
+        mInstanceEmitterBuffer->bind(bindGroup, 17, vk::DescriptorType::eStorageBuffer);
+        mLightBVHBuffer->bind(bindGroup, 18, vk::DescriptorType::eStorageBuffer);
+        mLightBVHTrailBuffer->bind(bindGroup, 19, vk::DescriptorType::eStorageBuffer);
+        mEmissiveTriangleBuffer->bind(bindGroup, 20, vk::DescriptorType::eStorageBuffer);
+    }
+
+    void GPUScene::recordUpdate(Handle<vk2s::Command> command)
+    {
+        if (!mPendingWrites.empty())
+        {
+            auto& commandBuffer = command->getVkCommandBuffer();
+
+            // wait for the ray tracing of the previous frames reading the buffers
+            const vk::MemoryBarrier before(vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite);
+            commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::PipelineStageFlagBits::eTransfer, {}, before, {}, {});
+
+            // small edits are written inline, and large ones are copied from their staging buffers
+            for (auto& write : mPendingWrites)
+            {
+                if (write.staging)
+                {
+                    commandBuffer->copyBuffer(write.staging->getVkBuffer(), write.buffer, vk::BufferCopy(0, write.offset, write.staging->getSize()));
+                    mRetiredStagingBuffers.emplace_back(std::move(write.staging));
+                }
+                else
+                {
+                    commandBuffer->updateBuffer(write.buffer, write.offset, write.data.size(), write.data.data());
+                }
+            }
+
+            const vk::MemoryBarrier after(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
+            commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eRayTracingShaderKHR, {}, after, {}, {});
+
+            mPendingWrites.clear();
+        }
+
+        if (mTLAS)
+        {
+            mTLAS->recordUpdate(command);
+        }
+    }
+
+    uint32_t GPUScene::getEmitterNum() const
+    {
+        return mEmitterNum;
+    }
+
+    uint32_t GPUScene::getTextureNum() const
+    {
+        return static_cast<uint32_t>(mTextures.size());
+    }
+
+    DeviceMemoryPool& GPUScene::getMemoryPool() const
+    {
+        return mMeshPool.getMemoryPool();
+    }
+
+    void GPUScene::createDummyTexture()
+    {
+#ifndef NDEBUG
+        constexpr uint8_t kDummyColor[] = { 255, 0, 255, 0 };  // Magenta
+#else
+        constexpr uint8_t kDummyColor[] = { 0, 0, 0, 0 };  // Black
+#endif
+        const auto format   = vk::Format::eR8G8B8A8Srgb;
+        const uint32_t size = vk2s::Compiler::getSizeOfFormat(format);  // 1 * 1
+
+        vk::ImageCreateInfo ci;
+        ci.arrayLayers   = 1;
+        ci.extent        = vk::Extent3D(1, 1, 1);  // 1 * 1
+        ci.format        = format;
+        ci.imageType     = vk::ImageType::e2D;
+        ci.mipLevels     = 1;
+        ci.usage         = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+        ci.initialLayout = vk::ImageLayout::eUndefined;
+
+        mDummyTexture = mDevice.create<vk2s::Image>(ci, vk::MemoryPropertyFlagBits::eDeviceLocal, size, vk::ImageAspectFlagBits::eColor);
+        mDummyTexture->write(kDummyColor, size);
+
+        UniqueHandle<vk2s::Command> cmd = mDevice.create<vk2s::Command>();
+        cmd->begin(true);
+        cmd->transitionImageLayout(mDummyTexture.get(), vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal);
+        cmd->end();
+        cmd->execute();
+    }
+
+    void GPUScene::queueBufferWrite(vk::Buffer buffer, const void* pData, const size_t size, const size_t offset)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+
+        if (size > kMaxInlineWriteSize)
+        {
+            auto staging = std::make_unique<PooledBuffer>(mDevice, getMemoryPool(), vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferSrc), MemoryUsage::eUpload);
+            std::memcpy(staging->getMappedPointer(), pData, size);
+            mPendingWrites.emplace_back(PendingWrite{ buffer, offset, {}, std::move(staging) });
+            return;
+        }
+
+        const auto* p = reinterpret_cast<const std::uint8_t*>(pData);
+        mPendingWrites.emplace_back(PendingWrite{ buffer, offset, std::vector<std::uint8_t>(p, p + size), nullptr });
+    }
+
+    std::vector<float> GPUScene::computeEmitterPowers() const
+    {
+        std::vector<float> powers(mEmitterParams.size() + mEmissiveTriangles.size(), 0.f);
+
+        // radius of the bounding sphere of the scene, through which the infinite emitter enters
+        glm::vec3 sceneMin(std::numeric_limits<float>::max());
+        glm::vec3 sceneMax(std::numeric_limits<float>::lowest());
+        mScene.each<Mesh, Transform>(
+            [&](const Mesh& mesh, const Transform& transform)
+            {
+                for (int corner = 0; corner < 8; ++corner)
+                {
+                    const glm::vec3 local((corner & 1) ? mesh.geometry->aabbMax.x : mesh.geometry->aabbMin.x, (corner & 2) ? mesh.geometry->aabbMax.y : mesh.geometry->aabbMin.y, (corner & 4) ? mesh.geometry->aabbMax.z : mesh.geometry->aabbMin.z);
+                    const glm::vec3 world = transform.params.world * glm::vec4(local, 1.0);
+                    sceneMin              = glm::min(sceneMin, world);
+                    sceneMax              = glm::max(sceneMax, world);
+                }
+            });
+        const float sceneRadius = sceneMin.x <= sceneMax.x ? 0.5f * glm::length(sceneMax - sceneMin) : 1.f;
+
+        for (const auto& [entity, index] : mEmitterIndices)
+        {
+            const auto& emitter = mScene.get<Emitter>(entity);
+
+            switch (emitter.params.type)
+            {
+            case static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::ePoint):
+                powers[index] = 4.f * kPi * luminance(emitter.params.emissive);
+                break;
+            case static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eInfinite):
+            {
+                const float average = emitter.emissiveTex && emitter.distribution ? emitter.distribution->getAverageLuminance() : luminance(emitter.params.emissive);
+                powers[index]       = 4.f * kPi * kPi * sceneRadius * sceneRadius * average;
+                break;
+            }
+            default:  // area emitters are sampled by their faces
+                break;
+            }
+        }
+
+        // faces of the area emitters (area emitters without mesh cannot be sampled)
+        for (size_t i = 0; i < mEmissiveTriangles.size(); ++i)
+        {
+            powers[mEmitterParams.size() + i] = mEmissiveTriangles[i].power;
+        }
+
+        return powers;
+    }
+
+    std::vector<LightBVH::LightBounds> GPUScene::computeEmitterBounds(std::span<const float> powers) const
+    {
+        std::vector<LightBVH::LightBounds> bounds(mEmitterParams.size() + mEmissiveTriangles.size());
+
+        for (const auto& [entity, index] : mEmitterIndices)
+        {
+            const auto& params = mEmitterParams[index];
+
+            switch (params.type)
+            {
+            case static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::ePoint):
+            {
+                // emits to all directions
+                auto& b     = bounds[index];
+                b.boundsMin = b.boundsMax = params.pos;
+                b.phi                     = powers[index];
+                b.cosThetaO               = -1.f;
+                b.cosThetaE               = 0.f;
+                break;
+            }
+            case static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eArea):
+            {
+                const auto itr = mEmissiveFaces.find(params.meshIndex);
+                if (params.firstTriangle < 0 || itr == mEmissiveFaces.end() || !mScene.contains<Transform>(entity))
+                {
+                    break;
+                }
+
+                // each face emits around its normal to both sides (same as the shaders)
+                const glm::mat4& world = mScene.get<Transform>(entity).params.world;
+                const auto& faces      = itr->second;
+#pragma omp parallel for
+                for (int i = 0; i < static_cast<int>(faces.size() / 3); ++i)
+                {
+                    const glm::vec3 p0     = world * glm::vec4(faces[3 * i], 1.0);
+                    const glm::vec3 p1     = world * glm::vec4(faces[3 * i + 1], 1.0);
+                    const glm::vec3 p2     = world * glm::vec4(faces[3 * i + 2], 1.0);
+                    const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                    if (glm::dot(normal, normal) == 0.f)
+                    {
+                        continue;
+                    }
+
+                    const size_t lightIndex = mEmitterParams.size() + params.firstTriangle + i;
+                    auto& b                 = bounds[lightIndex];
+                    b.boundsMin             = glm::min(p0, glm::min(p1, p2));
+                    b.boundsMax             = glm::max(p0, glm::max(p1, p2));
+                    b.phi                   = powers[lightIndex];
+                    b.axis                  = glm::normalize(normal);
+                    b.cosThetaO             = 1.f;
+                    b.cosThetaE             = 0.f;
+                    b.twoSided              = true;
+                }
+                break;
+            }
+            default:  // the infinite emitter is sampled apart from the tree
+                break;
+            }
+        }
+
+        return bounds;
+    }
+
+    int32_t GPUScene::registerTexture(Handle<vk2s::Image> image)
+    {
+        const VkImage key = image->getVkImage().get();
+        if (const auto itr = mTextureIndices.find(key); itr != mTextureIndices.end())
+        {
+            return itr->second;
+        }
+
+        mTextures.emplace_back(image);
+        return mTextureIndices[key] = static_cast<int32_t>(mTextures.size() - 1);
+    }
+
+    std::optional<Material::Params> GPUScene::resolveTextureIndices(const Material& mat, const bool registerNew)
+    {
+        Material::Params ret = mat.params;
+        bool resolved        = true;
+
+        const auto resolve = [&](Handle<vk2s::Image> image, int32_t& index)
+        {
+            index = Material::Params::kInvalidTexIndex;
+            if (!image)
+            {
+                return;
+            }
+
+            if (registerNew)
+            {
+                index = registerTexture(image);
+            }
+            else if (const auto itr = mTextureIndices.find(image->getVkImage().get()); itr != mTextureIndices.end())
+            {
+                index = itr->second;
+            }
+            else
+            {
+                resolved = false;
+            }
+        };
+
+        resolve(mat.albedoTex, ret.albedoTexIndex);
+        resolve(mat.ormTex, ret.ormTexIndex);
+        resolve(mat.normalMapTex, ret.normalMapTexIndex);
+
+        if (!resolved)
+        {
+            return std::nullopt;
+        }
+
+        return ret;
+    }
+
+    bool GPUScene::updateEmitter(const ec2s::Entity entity)
+    {
+        const auto itr = mEmitterIndices.find(entity);
+        if (itr == mEmitterIndices.end() || !mScene.contains<Emitter>(entity))
+        {
+            return false;
+        }
+
+        const uint32_t index  = itr->second;
+        const auto& emitter   = mScene.get<Emitter>(entity);
+        auto& params          = mEmitterParams[index];
+        const bool isInfinite = emitter.params.type == static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eInfinite);
+        const bool isArea     = emitter.params.type == static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eArea);
+
+        // the faces in the emissive triangle table must be unchanged
+        const uint32_t faceNum    = isArea && mScene.contains<Mesh>(entity) ? mScene.get<Mesh>(entity).geometry->indexCount / 3 : 0;
+        const uint32_t oldFaceNum = params.firstTriangle >= 0 ? static_cast<uint32_t>(mEmissiveFaces[params.meshIndex].size() / 3) : 0;
+        if (faceNum != oldFaceNum || params.type != emitter.params.type)
+        {
+            return false;
+        }
+
+        // keep indices assigned at creation
+        const auto meshIndex     = params.meshIndex;
+        const auto firstTriangle = params.firstTriangle;
+        const auto instanceIndex = params.instanceIndex;
+        const auto texIndex      = params.texIndex;
+        params                   = emitter.params;
+        params.meshIndex         = meshIndex;
+        params.firstTriangle     = firstTriangle;
+        params.instanceIndex     = instanceIndex;
+        params.texIndex          = texIndex;
+        params.pos               = isInfinite || !mScene.contains<Transform>(entity) ? glm::vec3(0.0) : mScene.get<Transform>(entity).pos;
+
+        queueBufferWrite(mEmittersBuffer->getVkBuffer(), &params, sizeof(Emitter::Params), sizeof(Emitter::Params) * index);
+
+        // area and power of the faces follow the scale and the emissive (moving or rotating the emitter rewrites nothing)
+        if (firstTriangle >= 0 && mScene.contains<Transform>(entity))
+        {
+            const uint32_t count = updateEmissiveTriangles(params, mScene.get<Transform>(entity).params.world);
+            queueBufferWrite(mEmissiveTriangleBuffer->getVkBuffer(), mEmissiveTriangles.data() + firstTriangle, sizeof(EmissiveTriangle) * count, sizeof(EmissiveTriangle) * firstTriangle);
+        }
+
+        return true;
+    }
+
+    uint32_t GPUScene::updateEmissiveTriangles(const Emitter::Params& params, const glm::mat4& world)
+    {
+        const auto itr = mEmissiveFaces.find(params.meshIndex);
+        if (params.firstTriangle < 0 || itr == mEmissiveFaces.end())
+        {
+            return 0;
+        }
+
+        const glm::mat3 linear(world);
+        const glm::mat3 metric = glm::transpose(linear) * linear;
+        const float radiance   = kPi * luminance(params.emissive);
+
+        // the area of a face depends only on the metric (|La x Lb|^2 = (a.Ga)(b.Gb) - (a.Gb)^2)
+        if (const auto source = mEmissiveSources.find(params.firstTriangle); source != mEmissiveSources.end() && source->second.radiance == radiance)
+        {
+            float scale = 0.f, diff = 0.f;
+            for (int c = 0; c < 3; ++c)
+            {
+                for (int r = 0; r < 3; ++r)
+                {
+                    scale = std::max(scale, std::abs(metric[c][r]));
+                    diff  = std::max(diff, std::abs(metric[c][r] - source->second.metric[c][r]));
+                }
+            }
+
+            // tolerate the rounding of rotations
+            if (diff <= kMetricTolerance * scale)
+            {
+                return 0;
+            }
+        }
+        mEmissiveSources[params.firstTriangle] = EmissiveSource{ .metric = metric, .radiance = radiance };
+
+        const auto& faces    = itr->second;
+        const uint32_t count = static_cast<uint32_t>(faces.size() / 3);
+#pragma omp parallel for
+        for (int i = 0; i < static_cast<int>(count); ++i)
+        {
+            auto& triangle = mEmissiveTriangles[params.firstTriangle + i];
+            triangle.area  = 0.5f * glm::length(glm::cross(linear * (faces[3 * i + 1] - faces[3 * i]), linear * (faces[3 * i + 2] - faces[3 * i])));
+            triangle.power = radiance * triangle.area;
+        }
+
+        return count;
+    }
+}  // namespace palm
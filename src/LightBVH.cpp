@@ -0,0 +1,346 @@
+/*****************************************************************/ /**
+ * @file   LightBVH.cpp
+ * @brief  source file of LightBVH class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/LightBVH.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numbers>
+
+namespace palm
+{
+    namespace
+    {
+        constexpr float kPi = std::numbers::pi_v<float>;
+        //! Number of the buckets of the candidate splits for each axis
+        constexpr int kBucketNum = 12;
+        //! Depth from which the ranges are split at the median (keeps the bit trails under 63 bits)
+        constexpr uint32_t kMedianSplitDepth = 32;
+
+        float safeAcos(const float x)
+        {
+            return std::acos(std::clamp(x, -1.f, 1.f));
+        }
+
+        /**
+         * @brief  Smallest cone containing both cones
+         */
+        void unionCone(const glm::vec3& axisA, const float cosA, const glm::vec3& axisB, const float cosB, glm::vec3& axis, float& cosTheta)
+        {
+            const float thetaA = safeAcos(cosA);
+            const float thetaB = safeAcos(cosB);
+            const float thetaD = safeAcos(glm::dot(axisA, axisB));
+
+            // one contains the other
+            if (std::min(thetaD + thetaB, kPi) <= thetaA)
+            {
+                axis = axisA, cosTheta = cosA;
+                return;
+            }
+            if (std::min(thetaD + thetaA, kPi) <= thetaB)
+            {
+                axis = axisB, cosTheta = cosB;
+                return;
+            }
+
+            // spread to the whole sphere
+            const float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+            const glm::vec3 wr = glm::cross(axisA, axisB);
+            if (thetaO >= kPi || glm::dot(wr, wr) == 0.f)
+            {
+                axis = axisA, cosTheta = -1.f;
+                return;
+            }
+
+            // rotate axisA toward axisB by thetaO - thetaA (Rodrigues' rotation formula)
+            const float thetaR = thetaO - thetaA;
+            const glm::vec3 k  = glm::normalize(wr);
+            axis               = glm::normalize(axisA * std::cos(thetaR) + glm::cross(k, axisA) * std::sin(thetaR) + k * glm::dot(k, axisA) * (1.f - std::cos(thetaR)));
+            cosTheta           = std::cos(thetaO);
+        }
+
+        LightBVH::LightBounds unionBounds(const LightBVH::LightBounds& a, const LightBVH::LightBounds& b)
+        {
+            if (a.phi == 0.f)
+            {
+                return b;
+            }
+            if (b.phi == 0.f)
+            {
+                return a;
+            }
+
+            LightBVH::LightBounds ret;
+            ret.boundsMin = glm::min(a.boundsMin, b.boundsMin);
+            ret.boundsMax = glm::max(a.boundsMax, b.boundsMax);
+            ret.phi       = a.phi + b.phi;
+            unionCone(a.axis, a.cosThetaO, b.axis, b.cosThetaO, ret.axis, ret.cosThetaO);
+            ret.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+            ret.twoSided  = a.twoSided || b.twoSided;
+
+            return ret;
+        }
+
+        /**
+         * @brief  Cost of a child in the surface area orientation heuristic (pbrt-v4)
+         */
+        float evaluateCost(const LightBVH::LightBounds& b, const glm::vec3& parentDiagonal, const int dim)
+        {
+            const float thetaO    = safeAcos(b.cosThetaO);
+            const float thetaE    = safeAcos(b.cosThetaE);
+            const float thetaW    = std::min(thetaO + thetaE, kPi);
+            const float sinThetaO = std::sqrt(std::max(0.f, 1.f - b.cosThetaO * b.cosThetaO));
+            const float mOmega    = 2.f * kPi * (1.f - b.cosThetaO) + kPi / 2.f * (2.f * thetaW * sinThetaO - std::cos(thetaO - 2.f * thetaW) - 2.f * thetaO * sinThetaO + b.cosThetaO);
+
+            // regularize long and thin nodes
+            const float kr = std::max({ parentDiagonal.x, parentDiagonal.y, parentDiagonal.z }) / parentDiagonal[dim];
+
+            const glm::vec3 d = b.boundsMax - b.boundsMin;
+            const float area  = 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+
+            return b.phi * mOmega * kr * area;
+        }
+
+        LightBVH::Node toNode(const LightBVH::LightBounds& b, const uint32_t child, const uint32_t flags)
+        {
+            return LightBVH::Node{
+                .boundsMin = b.boundsMin,
+                .phi       = b.phi,
+                .boundsMax = b.boundsMax,
+                .cosThetaO = b.cosThetaO,
+                .axis      = b.axis,
+                .cosThetaE = b.cosThetaE,
+                .child     = child,
+                .flags     = flags | (b.twoSided ? LightBVH::kTwoSidedFlag : 0u),
+            };
+        }
+
+        LightBVH::LightBounds toBounds(const LightBVH::Node& node)
+        {
+            return LightBVH::LightBounds{
+                .boundsMin = node.boundsMin,
+                .boundsMax = node.boundsMax,
+                .phi       = node.phi,
+                .axis      = node.axis,
+                .cosThetaO = node.cosThetaO,
+                .cosThetaE = node.cosThetaE,
+                .twoSided  = (node.flags & LightBVH::kTwoSidedFlag) != 0,
+            };
+        }
+    }  // namespace
+
+    LightBVH::LightBVH(std::span<const LightBounds> lights)
+        : mLights(lights)
+        , mTrails(lights.size(), kNotInTree)
+    {
+        for (uint32_t i = 0; i < lights.size(); ++i)
+        {
+            if (lights[i].phi > 0.f && std::isfinite(lights[i].phi))
+            {
+                mIndices.emplace_back(i);
+            }
+        }
+
+        if (mIndices.empty())
+        {
+            // root without power (nothing is sampled from the tree)
+            mNodes.emplace_back(Node{ .phi = 0.f, .child = 0, .flags = kLeafFlag });
+            mDirtyEnd = 1;
+            return;
+        }
+
+        mNodes.reserve(2 * mIndices.size() - 1);
+        build(0, mIndices.size(), 0, 0);
+        mDirtyEnd = static_cast<uint32_t>(mNodes.size());
+    }
+
+    const std::vector<LightBVH::Node>& LightBVH::getNodes() const
+    {
+        return mNodes;
+    }
+
+    const std::vector<uint64_t>& LightBVH::getTrails() const
+    {
+        return mTrails;
+    }
+
+    bool LightBVH::refit(std::span<const LightBounds> lights)
+    {
+        if (lights.size() != mTrails.size())
+        {
+            return false;
+        }
+
+        // the leaves must be the same emitters
+        for (size_t i = 0; i < lights.size(); ++i)
+        {
+            const bool inTree = lights[i].phi > 0.f && std::isfinite(lights[i].phi);
+            if (inTree != (mTrails[i] != kNotInTree))
+            {
+                return false;
+            }
+        }
+
+        mLights     = lights;
+        mDirtyBegin = static_cast<uint32_t>(mNodes.size());
+        mDirtyEnd   = 0;
+        if (mIndices.empty())
+        {
+            return true;
+        }
+
+        // flags of the changed nodes
+        const int nodeNum = static_cast<int>(mNodes.size());
+        std::vector<uint8_t> changed(nodeNum, 0);
+
+        const auto refitNode = [&](const int nodeIndex, const Node& node)
+        {
+            if (std::memcmp(&mNodes[nodeIndex], &node, sizeof(Node)) != 0)
+            {
+                mNodes[nodeIndex]  = node;
+                changed[nodeIndex] = 1;
+            }
+        };
+
+        // step 1 : leaves (independent of each other)
+#pragma omp parallel for
+        for (int i = 0; i < nodeNum; ++i)
+        {
+            if (mNodes[i].flags & kLeafFlag)
+            {
+                refitNode(i, toNode(mLights[mNodes[i].child], mNodes[i].child, kLeafFlag));
+            }
+        }
+
+        // step 2 : interior nodes bottom-up (children always follow their parent in depth-first order)
+        for (int i = nodeNum - 1; i >= 0; --i)
+        {
+            const Node& node = mNodes[i];
+            if (!(node.flags & kLeafFlag))
+            {
+                refitNode(i, toNode(unionBounds(toBounds(mNodes[i + 1]), toBounds(mNodes[node.child])), node.child, 0));
+            }
+        }
+
+        // step 3 : range to be uploaded
+        const auto first = std::find(changed.begin(), changed.end(), 1);
+        if (first != changed.end())
+        {
+            mDirtyBegin = static_cast<uint32_t>(first - changed.begin());
+            mDirtyEnd   = static_cast<uint32_t>(changed.rend() - std::find(changed.rbegin(), changed.rend(), 1));
+        }
+
+        return true;
+    }
+
+    std::pair<uint32_t, uint32_t> LightBVH::getDirtyRange() const
+    {
+        return { mDirtyBegin, mDirtyEnd };
+    }
+
+    uint32_t LightBVH::build(const size_t begin, const size_t end, const uint64_t trail, const uint32_t depth)
+    {
+        const uint32_t nodeIndex = static_cast<uint32_t>(mNodes.size());
+
+        // leaf
+        if (end - begin == 1)
+        {
+            const uint32_t lightIndex = mIndices[begin];
+            mNodes.emplace_back(toNode(mLights[lightIndex], lightIndex, kLeafFlag));
+            mTrails[lightIndex] = trail;
+            return nodeIndex;
+        }
+
+        // step 1 : bounds of the range and of the centroids
+        LightBounds bounds;
+        glm::vec3 centroidMin(std::numeric_limits<float>::max());
+        glm::vec3 centroidMax(std::numeric_limits<float>::lowest());
+        for (size_t i = begin; i < end; ++i)
+        {
+            const auto& light       = mLights[mIndices[i]];
+            const glm::vec3 centroid = 0.5f * (light.boundsMin + light.boundsMax);
+            bounds                   = unionBounds(bounds, light);
+            centroidMin              = glm::min(centroidMin, centroid);
+            centroidMax              = glm::max(centroidMax, centroid);
+        }
+
+        const auto centroidOf = [&](const uint32_t lightIndex, const int dim) { return 0.5f * (mLights[lightIndex].boundsMin[dim] + mLights[lightIndex].boundsMax[dim]); };
+        const auto bucketOf   = [&](const uint32_t lightIndex, const int dim)
+        { return std::clamp(static_cast<int>(kBucketNum * (centroidOf(lightIndex, dim) - centroidMin[dim]) / (centroidMax[dim] - centroidMin[dim])), 0, kBucketNum - 1); };
+
+        // step 2 : find the cheapest split among the buckets of each axis
+        float minCost = std::numeric_limits<float>::infinity();
+        int minDim = -1, minBucket = -1;
+        if (depth < kMedianSplitDepth)
+        {
+            const glm::vec3 diagonal = bounds.boundsMax - bounds.boundsMin;
+            for (int dim = 0; dim < 3; ++dim)
+            {
+                if (centroidMax[dim] == centroidMin[dim])
+                {
+                    continue;
+                }
+
+                std::array<LightBounds, kBucketNum> buckets;
+                for (size_t i = begin; i < end; ++i)
+                {
+                    auto& bucket = buckets[bucketOf(mIndices[i], dim)];
+                    bucket       = unionBounds(bucket, mLights[mIndices[i]]);
+                }
+
+                for (int split = 0; split < kBucketNum - 1; ++split)
+                {
+                    LightBounds below, above;
+                    for (int b = 0; b <= split; ++b)
+                    {
+                        below = unionBounds(below, buckets[b]);
+                    }
+                    for (int b = split + 1; b < kBucketNum; ++b)
+                    {
+                        above = unionBounds(above, buckets[b]);
+                    }
+
+                    const float cost = evaluateCost(below, diagonal, dim) + evaluateCost(above, diagonal, dim);
+                    if (cost > 0.f && cost < minCost)
+                    {
+                        minCost   = cost;
+                        minDim    = dim;
+                        minBucket = split;
+                    }
+                }
+            }
+        }
+
+        // step 3 : partition the range (at the median of the longest axis if no split is found)
+        size_t mid = begin;
+        if (minDim != -1)
+        {
+            mid = std::partition(mIndices.begin() + begin, mIndices.begin() + end, [&](const uint32_t lightIndex) { return bucketOf(lightIndex, minDim) <= minBucket; }) - mIndices.begin();
+        }
+        if (mid == begin || mid == end)
+        {
+            const glm::vec3 extent = centroidMax - centroidMin;
+            const int dim          = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+            mid = (begin + end) / 2;
+            std::nth_element(mIndices.begin() + begin, mIndices.begin() + mid, mIndices.begin() + end, [&](const uint32_t a, const uint32_t b) { return centroidOf(a, dim) < centroidOf(b, dim); });
+        }
+
+        // step 4 : children in depth-first order (the first child follows this node)
+        // the node is the union of its children, the same as refit() computes
+        mNodes.emplace_back();
+        build(begin, mid, trail, depth + 1);
+        const uint32_t secondChild = build(mid, end, trail | (1ull << depth), depth + 1);
+        mNodes[nodeIndex]          = toNode(unionBounds(toBounds(mNodes[nodeIndex + 1]), toBounds(mNodes[secondChild])), secondChild, 0);
+
+        return nodeIndex;
+    }
+}  // namespace palm
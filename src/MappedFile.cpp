@@ -0,0 +1,146 @@
+/*****************************************************************/ /**
+ * @file   MappedFile.cpp
+ * @brief  source file of MappedFile class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/MappedFile.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stdexcept>
+#include <utility>
+
+namespace palm
+{
+    MappedFile::MappedFile(const std::filesystem::path& path)
+    {
+#ifdef _WIN32
+        mFileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (mFileHandle == INVALID_HANDLE_VALUE)
+        {
+            mFileHandle = nullptr;
+            throw std::runtime_error("failed to open file for mapping: " + path.string());
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(mFileHandle, &size) || size.QuadPart == 0)
+        {
+            close();
+            throw std::runtime_error("failed to get size of (or empty) mapped file: " + path.string());
+        }
+        mSize = static_cast<size_t>(size.QuadPart);
+
+        mMappingHandle = CreateFileMappingW(mFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mMappingHandle)
+        {
+            close();
+            throw std::runtime_error("failed to create file mapping: " + path.string());
+        }
+
+        mpData = reinterpret_cast<const std::byte*>(MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (!mpData)
+        {
+            close();
+            throw std::runtime_error("failed to map view of file: " + path.string());
+        }
+#else
+        mFileDescriptor = ::open(path.c_str(), O_RDONLY);
+        if (mFileDescriptor < 0)
+        {
+            throw std::runtime_error("failed to open file for mapping: " + path.string());
+        }
+
+        struct stat st;
+        if (::fstat(mFileDescriptor, &st) != 0 || st.st_size == 0)
+        {
+            close();
+            throw std::runtime_error("failed to get size of (or empty) mapped file: " + path.string());
+        }
+        mSize = static_cast<size_t>(st.st_size);
+
+        void* p = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFileDescriptor, 0);
+        if (p == MAP_FAILED)
+        {
+            close();
+            throw std::runtime_error("failed to map file: " + path.string());
+        }
+        mpData = reinterpret_cast<const std::byte*>(p);
+
+        // contents are read front to back when uploading
+        ::madvise(p, mSize, MADV_SEQUENTIAL);
+#endif
+    }
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+
+            mpData = std::exchange(other.mpData, nullptr);
+            mSize  = std::exchange(other.mSize, 0);
+#ifdef _WIN32
+            mFileHandle    = std::exchange(other.mFileHandle, nullptr);
+            mMappingHandle = std::exchange(other.mMappingHandle, nullptr);
+#else
+            mFileDescriptor = std::exchange(other.mFileDescriptor, -1);
+#endif
+        }
+
+        return *this;
+    }
+
+    void MappedFile::close()
+    {
+#ifdef _WIN32
+        if (mpData)
+        {
+            UnmapViewOfFile(mpData);
+        }
+        if (mMappingHandle)
+        {
+            CloseHandle(mMappingHandle);
+        }
+        if (mFileHandle)
+        {
+            CloseHandle(mFileHandle);
+        }
+        mMappingHandle = nullptr;
+        mFileHandle    = nullptr;
+#else
+        if (mpData)
+        {
+            ::munmap(const_cast<std::byte*>(mpData), mSize);
+        }
+        if (mFileDescriptor >= 0)
+        {
+            ::close(mFileDescriptor);
+        }
+        mFileDescriptor = -1;
+#endif
+        mpData = nullptr;
+        mSize  = 0;
+    }
+}  // namespace palm
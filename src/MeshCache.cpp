@@ -0,0 +1,435 @@
+/*****************************************************************/ /**
+ * @file   MeshCache.cpp
+ * @brief  source file of MeshCache and CompiledModel classes
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/MeshCache.hpp"
+
+#include <vk2s/Scene.hpp>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+
+namespace palm
+{
+    namespace
+    {
+        // FNV-1a
+        constexpr uint64_t kFNVOffsetBasis = 0xcbf29ce484222325ull;
+        constexpr uint64_t kFNVPrime       = 0x100000001b3ull;
+
+        uint64_t hashBytes(const void* data, size_t size, uint64_t hash = kFNVOffsetBasis)
+        {
+            const auto* p = reinterpret_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash = (hash ^ p[i]) * kFNVPrime;
+            }
+
+            return hash;
+        }
+
+        constexpr size_t align16(const size_t offset)
+        {
+            return (offset + 15) & ~size_t(15);
+        }
+
+        // ORM texture packed from separate roughness and metalness maps (appended after the textures of the source)
+        struct PackedORM
+        {
+            int32_t roughnessTex;
+            int32_t metalnessTex;
+            uint32_t width;
+            uint32_t height;
+        };
+
+        // roughness is read from G and metalness from B (same as glTF, and grayscale maps have the value in all channels),
+        // occlusion is left 1 and sources of another size are sampled with the nearest texel
+        void packORM(const vk2s::Texture* pRoughness, const vk2s::Texture* pMetalness, const uint32_t width, const uint32_t height, uint8_t* pDst)
+        {
+            const auto fetch = [](const vk2s::Texture* pTexture, const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height, const uint32_t channel) -> uint8_t
+            {
+                if (!pTexture)
+                {
+                    return 255;
+                }
+
+                const uint32_t sx = static_cast<uint32_t>(uint64_t(x) * pTexture->width / width);
+                const uint32_t sy = static_cast<uint32_t>(uint64_t(y) * pTexture->height / height);
+                return reinterpret_cast<const uint8_t*>(pTexture->pData)[(static_cast<size_t>(sy) * pTexture->width + sx) * 4 + channel];
+            };
+
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    uint8_t* pTexel = pDst + (static_cast<size_t>(y) * width + x) * 4;
+                    pTexel[0]       = 255;
+                    pTexel[1]       = fetch(pRoughness, x, y, width, height, 1);
+                    pTexel[2]       = fetch(pMetalness, x, y, width, height, 2);
+                    pTexel[3]       = 255;
+                }
+            }
+        }
+
+        // for casting path UTF-8 string to normal string
+        std::string toUTF8String(const std::filesystem::path& path)
+        {
+            const auto u8str = path.u8string();
+            return std::string(reinterpret_cast<const char*>(u8str.data()), u8str.size());
+        }
+    }  // namespace
+
+    CompiledModel::CompiledModel(MappedFile&& file)
+        : mFile(std::move(file))
+        , mData(mFile.data(), mFile.size())
+    {
+    }
+
+    CompiledModel::CompiledModel(std::vector<std::byte>&& data)
+        : mMemory(std::move(data))
+        , mData(mMemory.data(), mMemory.size())
+    {
+    }
+
+    bool CompiledModel::isValid(const uint64_t key) const
+    {
+        if (mData.size() < sizeof(Header))
+        {
+            return false;
+        }
+
+        const auto& header = getHeader();
+        if (header.magic != MeshCache::kMagic || header.version != MeshCache::kVersion || header.key != key || header.fileSize != mData.size())
+        {
+            return false;
+        }
+
+        const auto inRange = [&](const uint64_t offset, const uint64_t size) { return offset <= mData.size() && size <= mData.size() - offset; };
+
+        const size_t tableEnd = sizeof(Header) + header.meshNum * sizeof(MeshRecord) + header.materialNum * sizeof(MaterialRecord) + header.textureNum * sizeof(TextureRecord);
+        if (tableEnd > mData.size())
+        {
+            return false;
+        }
+
+        for (const auto& mesh : getMeshes())
+        {
+            if (!inRange(mesh.vertexOffset, uint64_t(mesh.vertexCount) * sizeof(Mesh::Vertex)) || !inRange(mesh.indexOffset, uint64_t(mesh.indexCount) * sizeof(uint32_t)) || !inRange(mesh.nameOffset, mesh.nameLength) || mesh.materialIndex >= header.materialNum)
+            {
+                return false;
+            }
+        }
+
+        for (const auto& material : getMaterials())
+        {
+            const auto textureNum = static_cast<int32_t>(header.textureNum);
+            if (material.albedoTex >= textureNum || material.ormTex >= textureNum || material.normalMapTex >= textureNum)
+            {
+                return false;
+            }
+        }
+
+        for (const auto& texture : getTextures())
+        {
+            if (!inRange(texture.texelOffset, getTexelSize(texture)))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    const CompiledModel::Header& CompiledModel::getHeader() const
+    {
+        return *reinterpret_cast<const Header*>(mData.data());
+    }
+
+    std::span<const CompiledModel::MeshRecord> CompiledModel::getMeshes() const
+    {
+        const auto* p = reinterpret_cast<const MeshRecord*>(mData.data() + sizeof(Header));
+        return std::span(p, getHeader().meshNum);
+    }
+
+    std::span<const CompiledModel::MaterialRecord> CompiledModel::getMaterials() const
+    {
+        const auto* p = reinterpret_cast<const MaterialRecord*>(getMeshes().data() + getHeader().meshNum);
+        return std::span(p, getHeader().materialNum);
+    }
+
+    std::span<const CompiledModel::TextureRecord> CompiledModel::getTextures() const
+    {
+        const auto* p = reinterpret_cast<const TextureRecord*>(getMaterials().data() + getHeader().materialNum);
+        return std::span(p, getHeader().textureNum);
+    }
+
+    std::string_view CompiledModel::getName(const MeshRecord& mesh) const
+    {
+        return std::string_view(reinterpret_cast<const char*>(mData.data() + mesh.nameOffset), mesh.nameLength);
+    }
+
+    const Mesh::Vertex* CompiledModel::getVertices(const MeshRecord& mesh) const
+    {
+        return reinterpret_cast<const Mesh::Vertex*>(mData.data() + mesh.vertexOffset);
+    }
+
+    const uint32_t* CompiledModel::getIndices(const MeshRecord& mesh) const
+    {
+        return reinterpret_cast<const uint32_t*>(mData.data() + mesh.indexOffset);
+    }
+
+    const uint8_t* CompiledModel::getTexels(const TextureRecord& texture) const
+    {
+        return reinterpret_cast<const uint8_t*>(mData.data() + texture.texelOffset);
+    }
+
+    MeshCache::MeshCache(const std::filesystem::path& directory)
+        : mDirectory(directory)
+    {
+    }
+
+    CompiledModel MeshCache::acquire(const std::filesystem::path& source)
+    {
+        const uint64_t key = computeKey(source);
+
+        char keyStr[17];
+        std::snprintf(keyStr, sizeof(keyStr), "%016llx", static_cast<unsigned long long>(key));
+        const auto cachePath = mDirectory / (std::string(keyStr) + kExtension);
+
+        // cache hit
+        if (std::filesystem::exists(cachePath))
+        {
+            try
+            {
+                CompiledModel cached(MappedFile{ cachePath });
+                if (cached.isValid(key))
+                {
+                    return cached;
+                }
+            }
+            catch (std::exception& e)
+            {
+                std::cerr << e.what() << "\n";
+            }
+
+            std::cerr << "invalid mesh cache, recompiling: " << cachePath.string() << "\n";
+        }
+
+        // cache miss
+        auto compiled = compile(source, key);
+
+        // write to a temporary file first, not to leave a broken cache file
+        std::error_code ec;
+        std::filesystem::create_directories(mDirectory, ec);
+        // (named per thread, since concurrent loads may write the same entry)
+        const auto tmpPath = std::filesystem::path(cachePath).concat("." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp");
+        {
+            std::ofstream ofs(tmpPath, std::ios::binary);
+            ofs.write(reinterpret_cast<const char*>(compiled.data()), compiled.size());
+        }
+        std::filesystem::rename(tmpPath, cachePath, ec);
+        if (ec)
+        {
+            std::cerr << "failed to write mesh cache (" << ec.message() << "): " << cachePath.string() << "\n";
+            std::filesystem::remove(tmpPath, ec);
+        }
+
+        return CompiledModel(std::move(compiled));
+    }
+
+    uint64_t MeshCache::computeKey(const std::filesystem::path& source)
+    {
+        uint64_t hash = kFNVOffsetBasis;
+
+        {
+            MappedFile file(source);
+            hash = hashBytes(file.data(), file.size(), hash);
+        }
+
+        // import options (the conversion result depends on these)
+        const uint32_t options[] = { kVersion, static_cast<uint32_t>(sizeof(Mesh::Vertex)) };
+        hash                     = hashBytes(options, sizeof(options), hash);
+
+        return hash;
+    }
+
+    std::vector<std::byte> MeshCache::compile(const std::filesystem::path& source, const uint64_t key)
+    {
+        vk2s::Scene model(toUTF8String(source));
+
+        const std::vector<vk2s::Mesh>& hostMeshes        = model.getMeshes();
+        const std::vector<vk2s::Material>& hostMaterials = model.getMaterials();
+        const std::vector<vk2s::Texture>& hostTextures   = model.getTextures();
+
+        assert(hostMaterials.size() == hostMeshes.size() || !"The number of mesh is different from the number of material!");
+
+        std::vector<CompiledModel::MaterialRecord> materialRecords(hostMaterials.size());
+
+        // ORM textures packed from separate maps (shared by the materials using the same pair)
+        std::vector<PackedORM> packedORMs;
+        std::map<std::pair<int32_t, int32_t>, int32_t> packedIndices;
+
+        for (size_t i = 0; i < hostMaterials.size(); ++i)
+        {
+            const auto& hostMaterial = hostMaterials[i];
+            auto& record             = materialRecords[i];
+
+            record.albedo       = glm::vec3(hostMaterial.albedo);
+            record.roughness    = hostMaterial.roughness.x;
+            record.IOR          = hostMaterial.eta.r;
+            record.emissive     = glm::vec3(hostMaterial.emissive);
+            record.albedoTex    = hostMaterial.albedoTex;
+            record.normalMapTex = hostMaterial.normalMapTex;
+
+            const int32_t roughnessTex = hostMaterial.roughnessTex;
+            const int32_t metalnessTex = hostMaterial.metalnessTex;
+            record.ormChannels         = (roughnessTex != -1 ? CompiledModel::MaterialRecord::eRoughness : 0u) | (metalnessTex != -1 ? CompiledModel::MaterialRecord::eMetalness : 0u);
+
+            if (roughnessTex == -1 && metalnessTex == -1)
+            {
+                record.ormTex = -1;
+            }
+            else if (roughnessTex == metalnessTex)
+            {
+                // already packed by the source (glTF metallicRoughness)
+                record.ormTex = roughnessTex;
+            }
+            else
+            {
+                const auto [itr, inserted] = packedIndices.try_emplace({ roughnessTex, metalnessTex }, static_cast<int32_t>(hostTextures.size() + packedORMs.size()));
+                if (inserted)
+                {
+                    const vk2s::Texture* pRoughness = roughnessTex != -1 ? &hostTextures[roughnessTex] : nullptr;
+                    const vk2s::Texture* pMetalness = metalnessTex != -1 ? &hostTextures[metalnessTex] : nullptr;
+                    packedORMs.emplace_back(PackedORM{
+                        .roughnessTex = roughnessTex,
+                        .metalnessTex = metalnessTex,
+                        .width        = std::max(pRoughness ? pRoughness->width : 0u, pMetalness ? pMetalness->width : 0u),
+                        .height       = std::max(pRoughness ? pRoughness->height : 0u, pMetalness ? pMetalness->height : 0u),
+                    });
+                }
+                record.ormTex = itr->second;
+            }
+        }
+
+        // layout : header | mesh records | material records | texture records | names | (vertices, indices)... | texels... | packed texels...
+        CompiledModel::Header header{};
+        header.magic       = kMagic;
+        header.version     = kVersion;
+        header.key         = key;
+        header.meshNum     = static_cast<uint32_t>(hostMeshes.size());
+        header.materialNum = static_cast<uint32_t>(hostMaterials.size());
+        header.textureNum  = static_cast<uint32_t>(hostTextures.size() + packedORMs.size());
+
+        std::vector<CompiledModel::MeshRecord> meshRecords(hostMeshes.size());
+        std::vector<CompiledModel::TextureRecord> textureRecords(header.textureNum);
+
+        size_t offset = sizeof(CompiledModel::Header) + sizeof(CompiledModel::MeshRecord) * meshRecords.size() + sizeof(CompiledModel::MaterialRecord) * materialRecords.size() + sizeof(CompiledModel::TextureRecord) * textureRecords.size();
+
+        for (size_t i = 0; i < hostMeshes.size(); ++i)
+        {
+            meshRecords[i].nameOffset = static_cast<uint32_t>(offset);
+            meshRecords[i].nameLength = static_cast<uint32_t>(hostMeshes[i].nodeName.size());
+            offset += hostMeshes[i].nodeName.size();
+        }
+
+        for (size_t i = 0; i < hostMeshes.size(); ++i)
+        {
+            auto& record         = meshRecords[i];
+            record.vertexCount   = static_cast<uint32_t>(hostMeshes[i].vertices.size());
+            record.indexCount    = static_cast<uint32_t>(hostMeshes[i].indices.size());
+            record.materialIndex = static_cast<uint32_t>(i);
+
+            offset              = align16(offset);
+            record.vertexOffset = offset;
+            offset += sizeof(Mesh::Vertex) * record.vertexCount;
+
+            offset             = align16(offset);
+            record.indexOffset = offset;
+            offset += sizeof(uint32_t) * record.indexCount;
+        }
+
+        for (size_t i = 0; i < textureRecords.size(); ++i)
+        {
+            auto& record  = textureRecords[i];
+            record.width  = i < hostTextures.size() ? hostTextures[i].width : packedORMs[i - hostTextures.size()].width;
+            record.height = i < hostTextures.size() ? hostTextures[i].height : packedORMs[i - hostTextures.size()].height;
+
+            offset             = align16(offset);
+            record.texelOffset = offset;
+            offset += CompiledModel::getTexelSize(record);
+        }
+
+        header.fileSize = align16(offset);
+
+        std::vector<std::byte> data(header.fileSize);
+        std::byte* const pData = data.data();
+
+        // convert each mesh in parallel (each destination range is disjoint)
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < static_cast<int>(hostMeshes.size()); ++i)
+        {
+            const auto& hostMesh = hostMeshes[i];
+            auto& record         = meshRecords[i];
+
+            std::memcpy(pData + record.nameOffset, hostMesh.nodeName.data(), record.nameLength);
+
+            // convert vertices (only once, at compile time) and compute bounds
+            auto* vertices = reinterpret_cast<Mesh::Vertex*>(pData + record.vertexOffset);
+            record.aabbMin = glm::vec3(std::numeric_limits<float>::max());
+            record.aabbMax = glm::vec3(std::numeric_limits<float>::lowest());
+            for (size_t v = 0; v < hostMesh.vertices.size(); ++v)
+            {
+                vertices[v].pos    = hostMesh.vertices[v].pos;
+                vertices[v].normal = hostMesh.vertices[v].normal;
+                vertices[v].u      = hostMesh.vertices[v].uv.x;
+                vertices[v].v      = hostMesh.vertices[v].uv.y;
+
+                record.aabbMin = glm::min(record.aabbMin, vertices[v].pos);
+                record.aabbMax = glm::max(record.aabbMax, vertices[v].pos);
+            }
+
+            std::memcpy(pData + record.indexOffset, hostMesh.indices.data(), sizeof(uint32_t) * record.indexCount);
+        }
+
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < static_cast<int>(hostTextures.size()); ++i)
+        {
+            std::memcpy(pData + textureRecords[i].texelOffset, hostTextures[i].pData, CompiledModel::getTexelSize(textureRecords[i]));
+        }
+
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < static_cast<int>(packedORMs.size()); ++i)
+        {
+            const auto& packed = packedORMs[i];
+            auto* pDst         = reinterpret_cast<uint8_t*>(pData + textureRecords[hostTextures.size() + i].texelOffset);
+            packORM(packed.roughnessTex != -1 ? &hostTextures[packed.roughnessTex] : nullptr, packed.metalnessTex != -1 ? &hostTextures[packed.metalnessTex] : nullptr, packed.width, packed.height, pDst);
+        }
+
+        // tables
+        std::byte* p = pData;
+        std::memcpy(p, &header, sizeof(header));
+        p += sizeof(header);
+        std::memcpy(p, meshRecords.data(), sizeof(CompiledModel::MeshRecord) * meshRecords.size());
+        p += sizeof(CompiledModel::MeshRecord) * meshRecords.size();
+        std::memcpy(p, materialRecords.data(), sizeof(CompiledModel::MaterialRecord) * materialRecords.size());
+        p += sizeof(CompiledModel::MaterialRecord) * materialRecords.size();
+        std::memcpy(p, textureRecords.data(), sizeof(CompiledModel::TextureRecord) * textureRecords.size());
+
+        return data;
+    }
+}  // namespace palm
@@ -0,0 +1,350 @@
+/*****************************************************************/ /**
+ * @file   MeshPool.cpp
+ * @brief  source file of MeshPool class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/MeshPool.hpp"
+
+#include "../include/UploadBatch.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace palm
+{
+    namespace
+    {
+        // FNV-1a (over 64 bit words)
+        constexpr uint64_t kFNVOffsetBasis = 0xcbf29ce484222325ull;
+        constexpr uint64_t kFNVPrime       = 0x100000001b3ull;
+
+        uint64_t hashWords(const void* data, const size_t size, uint64_t hash)
+        {
+            const auto* p      = reinterpret_cast<const uint8_t*>(data);
+            const size_t words = size / sizeof(uint64_t);
+            for (size_t i = 0; i < words; ++i)
+            {
+                uint64_t word;
+                std::memcpy(&word, p + i * sizeof(uint64_t), sizeof(uint64_t));
+                hash = (hash ^ word) * kFNVPrime;
+            }
+
+            for (size_t i = words * sizeof(uint64_t); i < size; ++i)
+            {
+                hash = (hash ^ p[i]) * kFNVPrime;
+            }
+
+            return hash;
+        }
+
+        // static data fetched by closest hit shaders, only written through staging copies (and read back when saved or reallocated)
+        constexpr vk::BufferUsageFlags kCommonUsage = vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+        constexpr vk::BufferUsageFlags kVertexUsage = kCommonUsage | vk::BufferUsageFlagBits::eVertexBuffer;
+        constexpr vk::BufferUsageFlags kIndexUsage  = kCommonUsage | vk::BufferUsageFlagBits::eIndexBuffer;
+
+        // layouts read by the shaders as 32 bit words (Geometry.slang)
+        static_assert(sizeof(Mesh::Vertex) == 32);
+        static_assert(sizeof(Mesh::CompactVertex) == 20);
+    }  // namespace
+
+    std::optional<uint32_t> MeshPool::FreeList::allocate(const uint32_t count)
+    {
+        for (auto itr = mRanges.begin(); itr != mRanges.end(); ++itr)
+        {
+            const auto [offset, size] = *itr;
+            if (size < count)
+            {
+                continue;
+            }
+
+            mRanges.erase(itr);
+            if (size > count)
+            {
+                mRanges.emplace(offset + count, size - count);
+            }
+
+            return offset;
+        }
+
+        return std::nullopt;
+    }
+
+    void MeshPool::FreeList::release(uint32_t offset, uint32_t count)
+    {
+        // merge with the following range
+        if (const auto next = mRanges.find(offset + count); next != mRanges.end())
+        {
+            count += next->second;
+            mRanges.erase(next);
+        }
+
+        // merge with the preceding range
+        if (auto prev = mRanges.lower_bound(offset); prev != mRanges.begin())
+        {
+            --prev;
+            if (prev->first + prev->second == offset)
+            {
+                prev->second += count;
+                return;
+            }
+        }
+
+        mRanges.emplace(offset, count);
+    }
+
+    MeshPool::MeshPool(vk2s::Device& device, DeviceMemoryPool& memoryPool)
+        : mDevice(device)
+        , mMemoryPool(memoryPool)
+        , mVertexCapacity(kInitialVertexCapacity)
+        , mIndexCapacity(kInitialIndexCapacity)
+    {
+        mVertexBuffer = std::make_unique<PooledBuffer>(mDevice, mMemoryPool, vk::BufferCreateInfo({}, getVertexStride() * mVertexCapacity, kVertexUsage), MemoryUsage::eDeviceLocal);
+        mIndexBuffer  = std::make_unique<PooledBuffer>(mDevice, mMemoryPool, vk::BufferCreateInfo({}, sizeof(uint32_t) * mIndexCapacity, kIndexUsage), MemoryUsage::eDeviceLocal);
+        mVertexFreeList.release(0, mVertexCapacity);
+        mIndexFreeList.release(0, mIndexCapacity);
+    }
+
+    bool MeshPool::setVertexFormat(const VertexFormat format)
+    {
+        if (format == mVertexFormat)
+        {
+            return true;
+        }
+
+        if (size() != 0)
+        {
+            return false;
+        }
+
+        // nothing alive, so the contents need not be kept
+        mVertexFormat = format;
+        mVertexBuffer.reset();
+        mVertexBuffer = std::make_unique<PooledBuffer>(mDevice, mMemoryPool, vk::BufferCreateInfo({}, getVertexStride() * mVertexCapacity, kVertexUsage), MemoryUsage::eDeviceLocal);
+
+        return true;
+    }
+
+    size_t MeshPool::getVertexStride() const
+    {
+        return mVertexFormat == VertexFormat::eCompact ? sizeof(Mesh::CompactVertex) : sizeof(Mesh::Vertex);
+    }
+
+    uint32_t MeshPool::getIndexWordCount(const MeshGeometry& geometry)
+    {
+        // empty geometries still occupy one word so that every range is distinct
+        const uint32_t words = geometry.indexType == vk::IndexType::eUint16 ? (geometry.indexCount + 1) / 2 : geometry.indexCount;
+        return std::max(words, 1u);
+    }
+
+    uint64_t MeshPool::computeHash(std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices)
+    {
+        uint64_t hash        = kFNVOffsetBasis;
+        const uint64_t num[] = { vertices.size(), indices.size() };
+        hash                 = hashWords(num, sizeof(num), hash);
+        hash                 = hashWords(vertices.data(), vertices.size_bytes(), hash);
+        hash                 = hashWords(indices.data(), indices.size_bytes(), hash);
+
+        return hash;
+    }
+
+    std::shared_ptr<MeshGeometry> MeshPool::find(const uint64_t hash, const uint32_t vertexCount, const uint32_t indexCount)
+    {
+        const auto itr = mGeometries.find(hash);
+        if (itr == mGeometries.end())
+        {
+            return nullptr;
+        }
+
+        auto geometry = itr->second.lock();
+        if (!geometry)
+        {
+            // released
+            mGeometries.erase(itr);
+            return nullptr;
+        }
+
+        if (geometry->vertexCount != vertexCount || geometry->indexCount != indexCount)
+        {
+            return nullptr;
+        }
+
+        return geometry;
+    }
+
+    std::shared_ptr<MeshGeometry> MeshPool::create(const uint64_t hash, const uint32_t vertexCount, const uint32_t indexCount, const glm::vec3& aabbMin, const glm::vec3& aabbMax)
+    {
+        // ranges are released through the deleter, so the pool must outlive all meshes
+        std::shared_ptr<MeshGeometry> geometry(new MeshGeometry(),
+                                               [this](MeshGeometry* p)
+                                               {
+                                                   release(*p);
+                                                   delete p;
+                                               });
+        geometry->hash        = hash;
+        geometry->vertexCount = vertexCount;
+        geometry->indexCount  = indexCount;
+        geometry->aabbMin      = aabbMin;
+        geometry->aabbMax      = aabbMax;
+        geometry->vertexFormat = mVertexFormat;
+        geometry->indexType    = vertexCount <= kMaxIndex16VertexCount ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+
+        // empty geometries still occupy one element so that every range is distinct
+        const uint32_t vertexNum = std::max(vertexCount, 1u);
+        const uint32_t indexNum  = getIndexWordCount(*geometry);
+
+        auto firstVertex = mVertexFreeList.allocate(vertexNum);
+        if (!firstVertex)
+        {
+            grow(mVertexBuffer, mVertexCapacity, mVertexFreeList, vertexNum, getVertexStride(), kVertexUsage);
+            firstVertex = mVertexFreeList.allocate(vertexNum);
+        }
+
+        auto firstIndex = mIndexFreeList.allocate(indexNum);
+        if (!firstIndex)
+        {
+            grow(mIndexBuffer, mIndexCapacity, mIndexFreeList, indexNum, sizeof(uint32_t), kIndexUsage);
+            firstIndex = mIndexFreeList.allocate(indexNum);
+        }
+
+        geometry->firstVertex = *firstVertex;
+        geometry->firstIndex  = *firstIndex;
+
+        // a geometry with the same hash but different contents (collision) is simply not shared afterwards
+        mGeometries[hash] = geometry;
+
+        return geometry;
+    }
+
+    void MeshPool::upload(UploadBatch& uploadBatch, const MeshGeometry& geometry, std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices)
+    {
+        // vertices
+        if (geometry.vertexFormat == VertexFormat::eCompact)
+        {
+            std::vector<std::uint8_t> data(sizeof(Mesh::CompactVertex) * vertices.size());
+            auto* pDst = reinterpret_cast<Mesh::CompactVertex*>(data.data());
+
+#pragma omp parallel for
+            for (int i = 0; i < static_cast<int>(vertices.size()); ++i)
+            {
+                pDst[i] = Mesh::CompactVertex::encode(vertices[i]);
+            }
+
+            uploadBatch.addBuffer(mVertexBuffer->getVkBuffer(), std::move(data), sizeof(Mesh::CompactVertex) * geometry.firstVertex);
+        }
+        else
+        {
+            uploadBatch.addBuffer(mVertexBuffer->getVkBuffer(), vertices.data(), vertices.size_bytes(), sizeof(Mesh::Vertex) * geometry.firstVertex);
+        }
+
+        // indices
+        if (geometry.indexType == vk::IndexType::eUint16)
+        {
+            std::vector<std::uint8_t> data(sizeof(uint32_t) * getIndexWordCount(geometry), 0);
+            auto* pDst = reinterpret_cast<uint16_t*>(data.data());
+
+#pragma omp parallel for
+            for (int i = 0; i < static_cast<int>(indices.size()); ++i)
+            {
+                pDst[i] = static_cast<uint16_t>(indices[i]);
+            }
+
+            uploadBatch.addBuffer(mIndexBuffer->getVkBuffer(), std::move(data), sizeof(uint32_t) * geometry.firstIndex);
+        }
+        else
+        {
+            uploadBatch.addBuffer(mIndexBuffer->getVkBuffer(), indices.data(), indices.size_bytes(), sizeof(uint32_t) * geometry.firstIndex);
+        }
+    }
+
+    void MeshPool::download(const MeshGeometry& geometry, std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        vertices.resize(geometry.vertexCount);
+        indices.resize(geometry.indexCount);
+
+        // vertices
+        if (geometry.vertexFormat == VertexFormat::eCompact)
+        {
+            std::vector<Mesh::CompactVertex> compact(geometry.vertexCount);
+            readBack(mVertexBuffer->getVkBuffer(), compact.data(), sizeof(Mesh::CompactVertex) * compact.size(), sizeof(Mesh::CompactVertex) * geometry.firstVertex);
+            std::transform(compact.begin(), compact.end(), vertices.begin(), [](const Mesh::CompactVertex& v) { return v.decode(); });
+        }
+        else
+        {
+            readBack(mVertexBuffer->getVkBuffer(), vertices.data(), sizeof(Mesh::Vertex) * vertices.size(), sizeof(Mesh::Vertex) * geometry.firstVertex);
+        }
+
+        // indices
+        if (geometry.indexType == vk::IndexType::eUint16)
+        {
+            std::vector<uint16_t> packed(geometry.indexCount);
+            readBack(mIndexBuffer->getVkBuffer(), packed.data(), sizeof(uint16_t) * packed.size(), sizeof(uint32_t) * geometry.firstIndex);
+            std::copy(packed.begin(), packed.end(), indices.begin());
+        }
+        else
+        {
+            readBack(mIndexBuffer->getVkBuffer(), indices.data(), sizeof(uint32_t) * indices.size(), sizeof(uint32_t) * geometry.firstIndex);
+        }
+    }
+
+    size_t MeshPool::size()
+    {
+        std::erase_if(mGeometries, [](const auto& pair) { return pair.second.expired(); });
+        return mGeometries.size();
+    }
+
+    void MeshPool::grow(std::unique_ptr<PooledBuffer>& buffer, uint32_t& capacity, FreeList& freeList, const uint32_t required, const size_t stride, const vk::BufferUsageFlags usage)
+    {
+        // at least double to keep reallocations rare
+        const uint32_t newCapacity = std::max(capacity * 2, capacity + required);
+
+        auto newBuffer = std::make_unique<PooledBuffer>(mDevice, mMemoryPool, vk::BufferCreateInfo({}, stride * newCapacity, usage), MemoryUsage::eDeviceLocal);
+
+        // the old buffer may still be read by frames in flight
+        mDevice.waitIdle();
+
+        UniqueHandle<vk2s::Fence> fence = mDevice.create<vk2s::Fence>();
+        fence->reset();
+        UniqueHandle<vk2s::Command> cmd = mDevice.create<vk2s::Command>();
+        cmd->begin(true);
+        cmd->getVkCommandBuffer()->copyBuffer(buffer->getVkBuffer(), newBuffer->getVkBuffer(), vk::BufferCopy(0, 0, stride * capacity));
+        cmd->end();
+        cmd->execute(fence);
+        fence->wait();
+
+        buffer = std::move(newBuffer);
+        freeList.release(capacity, newCapacity - capacity);
+        capacity = newCapacity;
+    }
+
+    void MeshPool::release(const MeshGeometry& geometry)
+    {
+        mVertexFreeList.release(geometry.firstVertex, std::max(geometry.vertexCount, 1u));
+        mIndexFreeList.release(geometry.firstIndex, getIndexWordCount(geometry));
+    }
+
+    void MeshPool::readBack(vk::Buffer buffer, void* pDst, const size_t size, const size_t offset)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+
+        const PooledBuffer stagingBuffer(mDevice, mMemoryPool, vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferDst), MemoryUsage::eReadback);
+
+        UniqueHandle<vk2s::Fence> fence = mDevice.create<vk2s::Fence>();
+        fence->reset();
+        UniqueHandle<vk2s::Command> cmd = mDevice.create<vk2s::Command>();
+        cmd->begin(true);
+        cmd->getVkCommandBuffer()->copyBuffer(buffer, stagingBuffer.getVkBuffer(), vk::BufferCopy(offset, 0, size));
+        cmd->end();
+        cmd->execute(fence);
+        fence->wait();
+
+        std::memcpy(pDst, stagingBuffer.getMappedPointer(), size);
+    }
+}  // namespace palm
@@ -0,0 +1,294 @@
+/*****************************************************************/ /**
+ * @file   ModelLoader.cpp
+ * @brief  source file of ModelLoader class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/ModelLoader.hpp"
+
+#include "../include/Mesh.hpp"
+#include "../include/Material.hpp"
+#include "../include/EntityInfo.hpp"
+#include "../include/Transform.hpp"
+#include "../include/Emitter.hpp"
+#include "../include/UploadBatch.hpp"
+#include "../include/BLASBuilder.hpp"
+#include "../include/MeshPool.hpp"
+#include "../include/TextureRegistry.hpp"
+
+#include <omp.h>
+
+#include <cstdio>
+
+namespace palm
+{
+    ModelLoader::ModelLoader(vk2s::Device& device, ec2s::Registry& scene, MeshPool& meshPool, TextureRegistry& textureRegistry)
+        : mDevice(device)
+        , mScene(scene)
+        , mMeshPool(meshPool)
+        , mTextureRegistry(textureRegistry)
+    {
+    }
+
+    std::vector<ec2s::Entity> ModelLoader::load(const std::filesystem::path& path)
+    {
+        return add(*prepare(path, supportsCompressedTextures()));
+    }
+
+    bool ModelLoader::supportsCompressedTextures() const
+    {
+        const auto bcFeatures = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+        return (mDevice.getVkPhysicalDevice().getFormatProperties(TextureCache::getFormat(TextureUsage::eAlbedo)).optimalTilingFeatures & bcFeatures) == bcFeatures;
+    }
+
+    std::optional<ModelLoader::Prepared> ModelLoader::prepare(const std::filesystem::path& path, const bool compressTextures, LoadControl* pControl)
+    {
+        const auto cancelled = [&]() { return pControl && pControl->cancelled.load(); };
+        const auto report    = [&](const float progress)
+        {
+            if (pControl)
+            {
+                pControl->progress = progress;
+            }
+        };
+
+        // step 0 : imported with Assimp only if no valid compiled cache exists
+        MeshCache cache;
+        Prepared ret{ .path = path, .model = cache.acquire(path) };
+        report(0.4f);
+        if (cancelled())
+        {
+            return std::nullopt;
+        }
+
+        const CompiledModel& model = ret.model;
+        const auto meshRecords     = model.getMeshes();
+        const auto textureRecords  = model.getTextures();
+
+        // step 1 : hash the contents of each mesh (in parallel) to share geometries already loaded
+        ret.meshHashes.resize(meshRecords.size());
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < static_cast<int>(meshRecords.size()); ++i)
+        {
+            const auto& meshRecord = meshRecords[i];
+            ret.meshHashes[i]      = MeshPool::computeHash(std::span(model.getVertices(meshRecord), meshRecord.vertexCount), std::span(model.getIndices(meshRecord), meshRecord.indexCount));
+        }
+        report(0.5f);
+
+        // step 2 : hash the textures used by the materials, and block-compress them (encoded only if no valid cache exists)
+        for (const auto& materialRecord : model.getMaterials())
+        {
+            const std::pair<int32_t, TextureUsage> uses[] = {
+                { materialRecord.albedoTex, TextureUsage::eAlbedo },
+                { materialRecord.ormTex, TextureUsage::eORM },
+                { materialRecord.normalMapTex, TextureUsage::eNormalMap },
+            };
+
+            for (const auto& use : uses)
+            {
+                if (use.first != -1)
+                {
+                    ret.textures.try_emplace(use);
+                }
+            }
+        }
+
+        TextureCache textureCache;
+        size_t preparedNum = 0;
+        for (auto& [use, texture] : ret.textures)
+        {
+            if (cancelled())
+            {
+                return std::nullopt;
+            }
+
+            const auto& [textureIndex, usage] = use;
+            const auto& textureRecord         = textureRecords[textureIndex];
+            const uint8_t* pTexels            = model.getTexels(textureRecord);
+
+            texture.key = TextureCache::computeKey(pTexels, textureRecord.width, textureRecord.height, usage);
+            if (compressTextures)
+            {
+                texture.compressed.emplace(textureCache.acquire(texture.key, pTexels, textureRecord.width, textureRecord.height, usage));
+            }
+
+            report(0.5f + 0.5f * static_cast<float>(++preparedNum) / ret.textures.size());
+        }
+
+        report(1.f);
+        return ret;
+    }
+
+    std::vector<ec2s::Entity> ModelLoader::add(const Prepared& prepared)
+    {
+        const auto& path           = prepared.path;
+        const CompiledModel& model = prepared.model;
+        const auto& hashes         = prepared.meshHashes;
+
+        const auto meshRecords     = model.getMeshes();
+        const auto materialRecords = model.getMaterials();
+        const auto textureRecords  = model.getTextures();
+
+        std::vector<ec2s::Entity> entities;
+        entities.reserve(meshRecords.size());
+
+        // all textures and geometries are uploaded through one staging ring
+        UploadBatch uploadBatch(mDevice, mMeshPool.getMemoryPool());
+
+        // textures are shared through the registry by their contents, so each unique texture is created only once
+        // (sources are identified by the compiled model key, which changes with the file, and the texture record)
+        const uint64_t modelKey   = model.getHeader().key;
+        const auto acquireTexture = [&](const int32_t textureIndex, const TextureUsage usage) -> Handle<vk2s::Image>
+        {
+            char source[64];
+            std::snprintf(source, sizeof(source), "%016llx#%d#%u", static_cast<unsigned long long>(modelKey), textureIndex, static_cast<uint32_t>(usage));
+
+            // already loaded from the same source
+            if (const auto key = mTextureRegistry.findKey(source))
+            {
+                return mTextureRegistry.find(*key);
+            }
+
+            const auto& textureRecord = textureRecords[textureIndex];
+            const auto& texture       = prepared.textures.at({ textureIndex, usage });
+
+            // same contents loaded from another source
+            Handle<vk2s::Image> image = mTextureRegistry.find(texture.key);
+            if (!image)
+            {
+                if (const auto& compressed = texture.compressed)
+                {
+                    image = uploadBatch.addImage(textureRecord.width, textureRecord.height, compressed->getFormat(), compressed->getTexels(), compressed->getLevelSizes(), vk::ImageLayout::eShaderReadOnlyOptimal);
+                }
+                else
+                {
+                    image = uploadBatch.addImage(textureRecord.width, textureRecord.height, vk::Format::eR8G8B8A8Unorm, model.getTexels(textureRecord), CompiledModel::getTexelSize(textureRecord), vk::ImageLayout::eShaderReadOnlyOptimal, true);
+                }
+            }
+
+            mTextureRegistry.add(texture.key, image, source);
+            return image;
+        };
+
+        // geometries created by this load (index of the mesh record and geometry), the others are shared
+        std::vector<std::pair<size_t, std::shared_ptr<MeshGeometry>>> newGeometries;
+
+        // step 3 : create entities and GPU resources (device object creation is serialized)
+        for (size_t i = 0; i < meshRecords.size(); ++i)
+        {
+            const auto& meshRecord = meshRecords[i];
+
+            const auto entity = mScene.create<Mesh, Material, EntityInfo, Transform>();
+            auto& mesh        = mScene.get<Mesh>(entity);
+            auto& material    = mScene.get<Material>(entity);
+            auto& info        = mScene.get<EntityInfo>(entity);
+            auto& transform   = mScene.get<Transform>(entity);
+
+            const auto& materialRecord = materialRecords[meshRecord.materialIndex];
+
+            {  // geometry
+                mesh.geometry = mMeshPool.find(hashes[i], meshRecord.vertexCount, meshRecord.indexCount);
+                if (!mesh.geometry)
+                {
+                    mesh.geometry = mMeshPool.create(hashes[i], meshRecord.vertexCount, meshRecord.indexCount, meshRecord.aabbMin, meshRecord.aabbMax);
+                    newGeometries.emplace_back(i, mesh.geometry);
+                }
+            }
+
+            {  // materials
+                // params initialize
+                material.params.albedo    = materialRecord.albedo;
+                material.params.roughness = materialRecord.roughness;
+                material.params.IOR       = materialRecord.IOR;
+                material.params.emissive  = materialRecord.emissive;
+
+                // add emitter component if the material has emissive value
+                if (glm::dot(material.params.emissive, material.params.emissive) > 0.0)
+                {
+                    mScene.add<Emitter>(entity);
+
+                    auto& emitter          = mScene.get<Emitter>(entity);
+                    emitter.attachedEntity = entity;
+
+                    emitter.params.emissive = material.params.emissive;
+                    emitter.params.type     = static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eArea);
+                    emitter.params.faceNum  = mesh.geometry->indexCount / 3;
+                }
+
+                // textures (indices are resolved by the users of the material, so only validity is set here)
+                if (materialRecord.albedoTex != -1)
+                {
+                    material.albedoTex             = acquireTexture(materialRecord.albedoTex, TextureUsage::eAlbedo);
+                    material.params.albedoTexIndex = 0;  // not Material::Params::kInvalidTexIndex
+                }
+                if (materialRecord.ormTex != -1)
+                {
+                    material.ormTex             = acquireTexture(materialRecord.ormTex, TextureUsage::eORM);
+                    material.params.ormTexIndex = 0;
+
+                    // the textured channels are scaled by the factors, which start from 1 to use the texture as authored
+                    if (materialRecord.ormChannels & CompiledModel::MaterialRecord::eRoughness)
+                    {
+                        material.params.roughness = 1.0f;
+                    }
+                    if (materialRecord.ormChannels & CompiledModel::MaterialRecord::eMetalness)
+                    {
+                        material.params.metallic = 1.0f;
+                    }
+                }
+                if (materialRecord.normalMapTex != -1)
+                {
+                    material.normalMapTex             = acquireTexture(materialRecord.normalMapTex, TextureUsage::eNormalMap);
+                    material.params.normalMapTexIndex = 0;
+                }
+            }
+
+            {  // information
+                info.entityName = std::string(model.getName(meshRecord));
+                info.entityID   = entity;
+                info.editable   = true;
+
+                info.groupName      = path.filename().string();
+                const size_t dotPos = info.groupName.find_last_of('.');
+                if (dotPos != std::string_view::npos)
+                {
+                    info.groupName = info.groupName.substr(0, dotPos);
+                }
+            }
+
+            {  // transform
+                transform.params.world             = glm::identity<glm::mat4>();
+                transform.params.worldInvTranspose = glm::identity<glm::mat4>();
+                transform.params.vel               = glm::vec3(0.f);
+                transform.params.entitySlot        = static_cast<uint32_t>(entity >> ec2s::kEntitySlotShiftWidth);
+                transform.params.entityIndex       = static_cast<uint32_t>(entity & ec2s::kEntityIndexMask);
+            }
+
+            entities.emplace_back(entity);
+        }
+
+        // step 4 : queue vertices and indices of new geometries from the compiled data (kept mapped until submit)
+        // (after all geometries are created, since creating may reallocate the global buffers)
+        for (const auto& [recordIndex, geometry] : newGeometries)
+        {
+            const auto& meshRecord = meshRecords[recordIndex];
+
+            mMeshPool.upload(uploadBatch, *geometry, std::span(model.getVertices(meshRecord), meshRecord.vertexCount), std::span(model.getIndices(meshRecord), meshRecord.indexCount));
+        }
+
+        // step 5 : upload all textures and geometries into device-local memory
+        uploadBatch.submit();
+
+        // step 6 : build all new BLASes at once
+        BLASBuilder blasBuilder(mDevice, mMeshPool);
+        for (const auto& [recordIndex, geometry] : newGeometries)
+        {
+            blasBuilder.add(*geometry);
+        }
+        blasBuilder.build();
+
+        return entities;
+    }
+}  // namespace palm
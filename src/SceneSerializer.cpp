@@ -0,0 +1,541 @@
+/*****************************************************************/ /**
+ * @file   SceneSerializer.cpp
+ * @brief  source file of SceneSerializer class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/SceneSerializer.hpp"
+
+#include "../include/Mesh.hpp"
+#include "../include/Material.hpp"
+#include "../include/EntityInfo.hpp"
+#include "../include/Transform.hpp"
+#include "../include/Emitter.hpp"
+#include "../include/UploadBatch.hpp"
+#include "../include/BLASBuilder.hpp"
+#include "../include/MeshPool.hpp"
+#include "../include/TextureCache.hpp"
+#include "../include/TextureRegistry.hpp"
+
+#include <vk2s/Camera.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <tuple>
+#include <unordered_map>
+
+namespace palm
+{
+    namespace
+    {
+        template <typename T>
+        void writeValue(std::ofstream& ofs, const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        template <typename T>
+        T readValue(std::ifstream& ifs)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            T value{};
+            ifs.read(reinterpret_cast<char*>(&value), sizeof(T));
+            return value;
+        }
+
+        void writeString(std::ofstream& ofs, const std::string& str)
+        {
+            writeValue(ofs, static_cast<uint32_t>(str.size()));
+            ofs.write(str.data(), str.size());
+        }
+
+        std::string readString(std::ifstream& ifs)
+        {
+            std::string str(readValue<uint32_t>(ifs), '\0');
+            ifs.read(str.data(), str.size());
+            return str;
+        }
+
+        template <typename T>
+        void writeArray(std::ofstream& ofs, const std::vector<T>& data)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            writeValue(ofs, static_cast<uint64_t>(data.size()));
+            ofs.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(T));
+        }
+
+        template <typename T>
+        std::vector<T> readArray(std::ifstream& ifs)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            std::vector<T> data(readValue<uint64_t>(ifs));
+            ifs.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(T));
+            return data;
+        }
+    }  // namespace
+
+    SceneSerializer::SceneSerializer(vk2s::Device& device, ec2s::Registry& scene, MeshPool& meshPool, TextureRegistry& textureRegistry)
+        : mDevice(device)
+        , mScene(scene)
+        , mMeshPool(meshPool)
+        , mTextureRegistry(textureRegistry)
+    {
+    }
+
+    bool SceneSerializer::save(const std::filesystem::path& path)
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs)
+        {
+            std::cerr << "failed to open scene file: " << path.string() << "\n";
+            return false;
+        }
+
+        std::vector<ec2s::Entity> entities;
+        mScene.each<EntityInfo>([&](const ec2s::Entity entity, const EntityInfo& info) { entities.emplace_back(entity); });
+
+        // texture table (images referenced by several components are stored once)
+        std::vector<TextureData> textures;
+        std::unordered_map<VkImage, int32_t> textureIndices;
+        const auto registerTexture = [&](Handle<vk2s::Image> image, const vk::ImageLayout layout) -> int32_t
+        {
+            if (!image)
+            {
+                return -1;
+            }
+
+            const VkImage key = image->getVkImage().get();
+            if (const auto itr = textureIndices.find(key); itr != textureIndices.end())
+            {
+                return itr->second;
+            }
+
+            auto& texture = textures.emplace_back(readBack(image, layout));
+            texture.key   = mTextureRegistry.getKey(image).value_or(0);
+            return textureIndices[key] = static_cast<int32_t>(textures.size() - 1);
+        };
+
+        // geometry table (geometries shared by several meshes are stored once)
+        std::vector<const MeshGeometry*> geometries;
+        std::unordered_map<const MeshGeometry*, int32_t> geometryIndices;
+
+        std::unordered_map<ec2s::Entity, std::array<int32_t, Material::kDefaultTexNum>> materialTexRefs;
+        std::unordered_map<ec2s::Entity, int32_t> emitterTexRefs;
+        for (const auto entity : entities)
+        {
+            if (mScene.contains<Mesh>(entity))
+            {
+                const MeshGeometry* key = mScene.get<Mesh>(entity).geometry.get();
+                if (!geometryIndices.contains(key))
+                {
+                    geometries.emplace_back(key);
+                    geometryIndices[key] = static_cast<int32_t>(geometries.size() - 1);
+                }
+            }
+
+            if (mScene.contains<Material>(entity))
+            {
+                const auto& material     = mScene.get<Material>(entity);
+                materialTexRefs[entity] = {
+                    registerTexture(material.albedoTex, vk::ImageLayout::eShaderReadOnlyOptimal),
+                    registerTexture(material.ormTex, vk::ImageLayout::eShaderReadOnlyOptimal),
+                    registerTexture(material.normalMapTex, vk::ImageLayout::eShaderReadOnlyOptimal),
+                };
+            }
+
+            if (mScene.contains<Emitter>(entity))
+            {
+                // envmap loaded from file is kept in general layout
+                emitterTexRefs[entity] = registerTexture(mScene.get<Emitter>(entity).emissiveTex, vk::ImageLayout::eGeneral);
+            }
+        }
+
+        // header
+        writeValue(ofs, kMagic);
+        writeValue(ofs, kVersion);
+        writeValue(ofs, static_cast<uint32_t>(textures.size()));
+        writeValue(ofs, static_cast<uint32_t>(geometries.size()));
+        writeValue(ofs, static_cast<uint32_t>(entities.size()));
+
+        for (const auto& texture : textures)
+        {
+            writeValue(ofs, texture.key);
+            writeValue(ofs, texture.width);
+            writeValue(ofs, texture.height);
+            writeValue(ofs, texture.format);
+            writeValue(ofs, texture.layout);
+            writeValue(ofs, texture.mipLevels);
+            writeArray(ofs, texture.texels);
+        }
+
+        for (const auto* geometry : geometries)
+        {
+            // read the converted data back from the GPU (always stored in full format)
+            std::vector<Mesh::Vertex> vertices;
+            std::vector<uint32_t> indices;
+            mMeshPool.download(*geometry, vertices, indices);
+
+            writeValue(ofs, geometry->aabbMin);
+            writeValue(ofs, geometry->aabbMax);
+            writeArray(ofs, vertices);
+            writeArray(ofs, indices);
+        }
+
+        for (const auto entity : entities)
+        {
+            uint32_t flags = 0;
+            flags |= mScene.contains<Mesh>(entity) ? eMesh : 0;
+            flags |= mScene.contains<Material>(entity) ? eMaterial : 0;
+            flags |= mScene.contains<Transform>(entity) ? eTransform : 0;
+            flags |= mScene.contains<Emitter>(entity) ? eEmitter : 0;
+            flags |= mScene.contains<vk2s::Camera>(entity) ? eCamera : 0;
+            writeValue(ofs, flags);
+
+            {  // information
+                const auto& info = mScene.get<EntityInfo>(entity);
+                writeString(ofs, info.groupName);
+                writeString(ofs, info.entityName);
+                writeValue(ofs, static_cast<uint8_t>(info.editable));
+            }
+
+            if (flags & eTransform)
+            {
+                const auto& transform = mScene.get<Transform>(entity);
+                writeValue(ofs, transform.pos);
+                writeValue(ofs, transform.rot);
+                writeValue(ofs, transform.scale);
+            }
+
+            if (flags & eMesh)
+            {
+                writeValue(ofs, geometryIndices[mScene.get<Mesh>(entity).geometry.get()]);
+            }
+
+            if (flags & eMaterial)
+            {
+                writeValue(ofs, mScene.get<Material>(entity).params);
+                writeValue(ofs, materialTexRefs[entity]);
+            }
+
+            if (flags & eEmitter)
+            {
+                writeValue(ofs, mScene.get<Emitter>(entity).params);
+                writeValue(ofs, emitterTexRefs[entity]);
+            }
+
+            if (flags & eCamera)
+            {
+                const auto& camera = mScene.get<vk2s::Camera>(entity);
+                writeValue(ofs, camera.getPos());
+                writeValue(ofs, camera.getLookAt());
+                writeValue(ofs, camera.getFOV());
+                writeValue(ofs, camera.getAspect());
+                writeValue(ofs, camera.getNear());
+                writeValue(ofs, camera.getFar());
+            }
+        }
+
+        return ofs.good();
+    }
+
+    std::vector<ec2s::Entity> SceneSerializer::load(const std::filesystem::path& path)
+    {
+        std::vector<ec2s::Entity> entities;
+
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs)
+        {
+            std::cerr << "failed to open scene file: " << path.string() << "\n";
+            return entities;
+        }
+
+        // header
+        const auto magic   = readValue<uint32_t>(ifs);
+        const auto version = readValue<uint32_t>(ifs);
+        if (magic != kMagic || version != kVersion)
+        {
+            std::cerr << "invalid scene file (or unsupported version): " << path.string() << "\n";
+            return entities;
+        }
+
+        const auto textureNum  = readValue<uint32_t>(ifs);
+        const auto geometryNum = readValue<uint32_t>(ifs);
+        const auto entityNum   = readValue<uint32_t>(ifs);
+
+        std::vector<TextureData> textures(textureNum);
+        for (auto& texture : textures)
+        {
+            texture.key       = readValue<uint64_t>(ifs);
+            texture.width     = readValue<uint32_t>(ifs);
+            texture.height    = readValue<uint32_t>(ifs);
+            texture.format    = readValue<vk::Format>(ifs);
+            texture.layout    = readValue<vk::ImageLayout>(ifs);
+            texture.mipLevels = readValue<uint32_t>(ifs);
+            texture.texels    = readArray<uint8_t>(ifs);
+        }
+
+        if (!ifs)
+        {
+            std::cerr << "scene file is corrupted: " << path.string() << "\n";
+            return entities;
+        }
+
+        // texture table (textures already in the registry are shared, the others are uploaded at once with the geometries)
+        std::vector<Handle<vk2s::Image>> images;
+        images.reserve(textures.size());
+        UploadBatch uploadBatch(mDevice, mMeshPool.getMemoryPool());
+        for (const auto& texture : textures)
+        {
+            auto& image = images.emplace_back(texture.key != 0 ? mTextureRegistry.find(texture.key) : Handle<vk2s::Image>());
+            if (image)
+            {
+                continue;
+            }
+
+            if (texture.mipLevels > 1)
+            {
+                std::vector<size_t> levelSizes(texture.mipLevels);
+                for (uint32_t level = 0; level < texture.mipLevels; ++level)
+                {
+                    levelSizes[level] = CompressedTexture::getLevelSize(texture.format, texture.width, texture.height, level);
+                }
+                image = uploadBatch.addImage(texture.width, texture.height, texture.format, texture.texels.data(), levelSizes, texture.layout);
+            }
+            else
+            {
+                // only the top level is stored, the mip chains of material textures are generated again (envmaps are kept in eGeneral without mips)
+                const bool mipmapped = texture.layout == vk::ImageLayout::eShaderReadOnlyOptimal;
+                image                = uploadBatch.addImage(texture.width, texture.height, texture.format, texture.texels.data(), texture.texels.size(), texture.layout, mipmapped);
+            }
+
+            if (texture.key != 0)
+            {
+                mTextureRegistry.add(texture.key, image);
+            }
+        }
+
+        // geometry table (geometries already in the pool are shared)
+        std::vector<std::shared_ptr<MeshGeometry>> geometries;
+        geometries.reserve(geometryNum);
+        // new geometries and their contents (kept alive until the upload)
+        std::vector<std::tuple<std::shared_ptr<MeshGeometry>, std::vector<Mesh::Vertex>, std::vector<uint32_t>>> newGeometries;
+        BLASBuilder blasBuilder(mDevice, mMeshPool);
+        for (uint32_t i = 0; i < geometryNum && ifs; ++i)
+        {
+            const auto aabbMin = readValue<glm::vec3>(ifs);
+            const auto aabbMax = readValue<glm::vec3>(ifs);
+            auto vertices      = readArray<Mesh::Vertex>(ifs);
+            auto indices       = readArray<uint32_t>(ifs);
+
+            const auto hash        = MeshPool::computeHash(vertices, indices);
+            const auto vertexCount = static_cast<uint32_t>(vertices.size());
+            const auto indexCount  = static_cast<uint32_t>(indices.size());
+
+            auto& geometry = geometries.emplace_back(mMeshPool.find(hash, vertexCount, indexCount));
+            if (!geometry)
+            {
+                // already converted, uploaded as is
+                geometry = mMeshPool.create(hash, vertexCount, indexCount, aabbMin, aabbMax);
+                newGeometries.emplace_back(geometry, std::move(vertices), std::move(indices));
+                blasBuilder.add(*geometry);
+            }
+        }
+
+        // queued after all geometries are created, since creating may reallocate the global buffers
+        for (const auto& [geometry, vertices, indices] : newGeometries)
+        {
+            mMeshPool.upload(uploadBatch, *geometry, vertices, indices);
+        }
+
+        uploadBatch.submit();
+        newGeometries.clear();
+
+        // build all new BLASes at once
+        blasBuilder.build();
+
+        const auto selectGeometry = [&](const int32_t ref) -> std::shared_ptr<MeshGeometry>
+        {
+            if (ref < 0 || ref >= geometries.size())
+            {
+                return nullptr;
+            }
+
+            return geometries[ref];
+        };
+
+        const auto selectTexture = [&](const int32_t ref) -> Handle<vk2s::Image>
+        {
+            if (ref < 0 || ref >= images.size())
+            {
+                return Handle<vk2s::Image>();
+            }
+
+            return images[ref];
+        };
+
+        entities.reserve(entityNum);
+        for (uint32_t i = 0; i < entityNum && ifs; ++i)
+        {
+            const auto flags  = readValue<uint32_t>(ifs);
+            const auto entity = mScene.create<EntityInfo>();
+            entities.emplace_back(entity);
+
+            {  // information
+                auto& info      = mScene.get<EntityInfo>(entity);
+                info.groupName  = readString(ifs);
+                info.entityName = readString(ifs);
+                info.editable   = readValue<uint8_t>(ifs) != 0;
+                info.entityID   = entity;
+            }
+
+            if (flags & eTransform)
+            {
+                mScene.add<Transform>(entity);
+                auto& transform = mScene.get<Transform>(entity);
+                transform.pos   = readValue<glm::vec3>(ifs);
+                transform.rot   = readValue<glm::quat>(ifs);
+                transform.scale = readValue<glm::vec3>(ifs);
+
+                transform.params.update(transform.pos, transform.rot, transform.scale);
+                transform.params.vel         = glm::vec3(0.f);
+                transform.params.entitySlot  = static_cast<uint32_t>(entity >> ec2s::kEntitySlotShiftWidth);
+                transform.params.entityIndex = static_cast<uint32_t>(entity & ec2s::kEntityIndexMask);
+            }
+
+            if (flags & eMesh)
+            {
+                mScene.add<Mesh>(entity);
+                auto& mesh = mScene.get<Mesh>(entity);
+
+                mesh.geometry = selectGeometry(readValue<int32_t>(ifs));
+            }
+
+            if (flags & eMaterial)
+            {
+                mScene.add<Material>(entity);
+                auto& material = mScene.get<Material>(entity);
+
+                material.params    = readValue<Material::Params>(ifs);
+                const auto texRefs = readValue<std::array<int32_t, Material::kDefaultTexNum>>(ifs);
+
+                material.albedoTex    = selectTexture(texRefs[0]);
+                material.ormTex       = selectTexture(texRefs[1]);
+                material.normalMapTex = selectTexture(texRefs[2]);
+            }
+
+            if (flags & eEmitter)
+            {
+                mScene.add<Emitter>(entity);
+                auto& emitter = mScene.get<Emitter>(entity);
+
+                emitter.params      = readValue<Emitter::Params>(ifs);
+                emitter.emissiveTex = selectTexture(readValue<int32_t>(ifs));
+
+                if (flags & eMesh)
+                {
+                    emitter.attachedEntity = entity;
+                }
+            }
+
+            if (flags & eCamera)
+            {
+                const auto pos       = readValue<glm::vec3>(ifs);
+                const auto lookAt    = readValue<glm::vec3>(ifs);
+                const auto fov       = readValue<double>(ifs);
+                const auto aspect    = readValue<double>(ifs);
+                const auto nearPlane = readValue<double>(ifs);  // "near" is already defined by windows.h
+                const auto farPlane  = readValue<double>(ifs);  // "far" is already defined by windows.h
+
+                mScene.add<vk2s::Camera>(entity);
+                auto& camera = mScene.get<vk2s::Camera>(entity);
+                camera       = vk2s::Camera(fov, aspect);
+                camera.setPos(pos);
+                camera.setLookAt(lookAt);
+                camera.setNear(nearPlane);
+                camera.setFar(farPlane);
+            }
+        }
+
+        if (!ifs)
+        {
+            std::cerr << "scene file is corrupted (loaded partially): " << path.string() << "\n";
+        }
+
+        return entities;
+    }
+
+    SceneSerializer::TextureData SceneSerializer::readBack(Handle<vk2s::Image> image, const vk::ImageLayout layout)
+    {
+        TextureData ret;
+
+        const auto extent = image->getVkExtent();
+        ret.width         = extent.width;
+        ret.height        = extent.height;
+        ret.format        = image->getVkFormat();
+        ret.layout        = layout;
+
+        // block-compressed textures are stored with their chain (it cannot be blitted again), the others only with level 0
+        std::vector<vk::BufferImageCopy> copyRegions;
+        uint32_t size = 0;
+        if (CompressedTexture::isCompressedFormat(ret.format))
+        {
+            ret.mipLevels = static_cast<uint32_t>(std::bit_width(std::max(extent.width, extent.height)));
+            for (uint32_t level = 0; level < ret.mipLevels; ++level)
+            {
+                const vk::Extent3D levelExtent(std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), 1);
+                copyRegions.emplace_back(vk::BufferImageCopy().setBufferOffset(size).setBufferRowLength(0).setBufferImageHeight(0).setImageSubresource({ vk::ImageAspectFlagBits::eColor, level, 0, 1 }).setImageOffset({ 0, 0, 0 }).setImageExtent(levelExtent));
+                size += static_cast<uint32_t>(CompressedTexture::getLevelSize(ret.format, extent.width, extent.height, level));
+            }
+        }
+        else
+        {
+            size = extent.width * extent.height * vk2s::Compiler::getSizeOfFormat(ret.format);
+            copyRegions.emplace_back(vk::BufferImageCopy().setBufferOffset(0).setBufferRowLength(0).setBufferImageHeight(0).setImageSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 }).setImageOffset({ 0, 0, 0 }).setImageExtent(extent));
+        }
+        ret.texels.resize(size);
+
+        const PooledBuffer stagingBuffer(mDevice, mMeshPool.getMemoryPool(), vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferDst), MemoryUsage::eReadback);
+
+        UniqueHandle<vk2s::Fence> fence = mDevice.create<vk2s::Fence>();
+        fence->reset();
+        UniqueHandle<vk2s::Command> cmd = mDevice.create<vk2s::Command>();
+        cmd->begin(true);
+        {
+            // all stored levels are transitioned
+            vk::ImageMemoryBarrier barrier;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image               = image->getVkImage().get();
+            barrier.subresourceRange    = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, ret.mipLevels, 0, 1);
+
+            auto& commandBuffer   = cmd->getVkCommandBuffer();
+            barrier.oldLayout     = layout;
+            barrier.newLayout     = vk::ImageLayout::eTransferSrcOptimal;
+            barrier.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+            barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+            commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+
+            commandBuffer->copyImageToBuffer(image->getVkImage().get(), vk::ImageLayout::eTransferSrcOptimal, stagingBuffer.getVkBuffer(), copyRegions);
+
+            barrier.oldLayout     = vk::ImageLayout::eTransferSrcOptimal;
+            barrier.newLayout     = layout;
+            barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+            barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, {}, {}, barrier);
+        }
+        cmd->end();
+        cmd->execute(fence);
+        fence->wait();
+
+        std::memcpy(ret.texels.data(), stagingBuffer.getMappedPointer(), size);
+
+        return ret;
+    }
+}  // namespace palm
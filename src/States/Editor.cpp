@@ -12,19 +12,30 @@
 #include "../include/EntityInfo.hpp"
 #include "../include/Transform.hpp"
 #include "../include/Emitter.hpp"
+#include "../include/ModelLoader.hpp"
+#include "../include/SceneSerializer.hpp"
+#include "../include/UploadBatch.hpp"
 
 #include <stb_image.h>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include <glm/gtc/constants.hpp>
 
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 #include <ImGuizmo.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
+#include <optional>
+#include <random>
+#include <unordered_map>
 
 namespace palm
 {
@@ -38,233 +49,349 @@ namespace palm
     void Editor::addEntity(const std::filesystem::path& path)
     {
         auto& device = common()->device;
-        auto& window = common()->window;
         auto& scene  = common()->scene;
 
-        vk2s::Scene model(to_string(path));
+        const bool compressTextures = ModelLoader(device, scene, common()->meshPool, common()->textureRegistry).supportsCompressedTextures();
 
-        const std::vector<vk2s::Mesh>& hostMeshes        = model.getMeshes();
-        const std::vector<vk2s::Material>& hostMaterials = model.getMaterials();
-        const std::vector<vk2s::Texture>& hostTextures   = model.getTextures();
+        auto& load   = mPendingLoads.emplace_back();
+        load.path    = path;
+        load.control = std::make_shared<LoadControl>();
+        load.model   = std::async(std::launch::async, [path, compressTextures, control = load.control]() { return ModelLoader::prepare(path, compressTextures, control.get()); });
+    }
 
-        assert(hostMaterials.size() == hostMeshes.size() || !"The number of mesh is different from the number of material!");
+    void Editor::loadEnvmap(const std::filesystem::path& path)
+    {
+        auto& load   = mPendingLoads.emplace_back();
+        load.path    = path;
+        load.control = std::make_shared<LoadControl>();
+        load.envmap  = std::async(std::launch::async,
+                                 [path, control = load.control]() -> std::optional<PreparedEnvmap>
+                                 {
+                                     PreparedEnvmap ret{ .image = DecodedEnvmap::load(path) };
+                                     control->progress = 0.5f;
+                                     if (control->cancelled)
+                                     {
+                                         return std::nullopt;
+                                     }
+
+                                     const auto& image = ret.image;
+                                     ret.distribution  = std::make_shared<const EnvmapDistribution>(image.texels.data(), image.format, image.width, image.height);
+                                     control->progress = 1.f;
+
+                                     return ret;
+                                 });
+    }
 
-        for (size_t instanceIndex = 0; instanceIndex < hostMeshes.size(); ++instanceIndex)
-        {
-            const auto entity = scene.create<Mesh, Material, EntityInfo, Transform>();
-            auto& mesh        = scene.get<Mesh>(entity);
-            auto& material    = scene.get<Material>(entity);
-            auto& info        = scene.get<EntityInfo>(entity);
-            auto& transform   = scene.get<Transform>(entity);
+    void Editor::updatePendingLoads()
+    {
+        auto& device = common()->device;
+        auto& scene  = common()->scene;
 
-            const auto& hostMesh     = hostMeshes[instanceIndex];
-            const auto& hostMaterial = hostMaterials[instanceIndex];
+        const auto isReady = [](const auto& future) { return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; };
 
-            mesh.hostMesh = hostMesh;
+        for (auto itr = mPendingLoads.begin(); itr != mPendingLoads.end();)
+        {
+            auto& load = *itr;
+            if (!isReady(load.model) && !isReady(load.envmap))
+            {
+                ++itr;
+                continue;
+            }
 
-            {  // vertex buffer
-                std::vector<Mesh::Vertex> vertices;
-                vertices.resize(mesh.hostMesh.vertices.size());
-                for (int i = 0; i < mesh.hostMesh.vertices.size(); ++i)
+            try
+            {
+                if (load.model.valid())
                 {
-                    vertices[i].pos    = mesh.hostMesh.vertices[i].pos;
-                    vertices[i].normal = mesh.hostMesh.vertices[i].normal;
-                    vertices[i].u      = mesh.hostMesh.vertices[i].uv.x;
-                    vertices[i].v      = mesh.hostMesh.vertices[i].uv.y;
+                    // GPU resources are created and uploaded here, on the thread owning the scene
+                    const auto prepared = load.model.get();
+                    if (prepared && !load.control->cancelled)
+                    {
+                        ModelLoader loader(device, scene, common()->meshPool, common()->textureRegistry);
+                        for (const auto entity : loader.add(*prepared))
+                        {
+                            // select added entity
+                            mPickedEntity = entity;
+                        }
+
+                        mSceneStructureChanged = true;
+                        std::cout << "loaded model: " << to_string(load.path) << std::endl;
+                    }
                 }
+                else if (const auto prepared = load.envmap.get(); prepared && !load.control->cancelled && mInfiniteEmitterEntity)
+                {
+                    auto& emitter       = scene.get<Emitter>(*mInfiniteEmitterEntity);
+                    emitter.params.type = static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eInfinite);
 
-                const auto vbSize  = vertices.size() * sizeof(Mesh::Vertex);
-                const auto vbUsage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer;
-                vk::BufferCreateInfo ci({}, vbSize, vbUsage);
-                vk::MemoryPropertyFlags fb = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+                    // the previous envmap may be used by the frames in flight
+                    if (emitter.emissiveTex)
+                    {
+                        device.waitIdle();
+                        common()->textureRegistry.destroy(emitter.emissiveTex);
+                        mBoundEnvmap = VK_NULL_HANDLE;
+                    }
+
+                    // kept in general layout like the envmaps loaded by vk2s (rebound by updateEmitters())
+                    const auto& image = prepared->image;
+                    UploadBatch uploadBatch(device, common()->memoryPool);
+                    emitter.emissiveTex  = uploadBatch.addImage(image.width, image.height, image.format, image.texels.data(), image.texels.size(), vk::ImageLayout::eGeneral);
+                    emitter.distribution = prepared->distribution;
+                    uploadBatch.submit();
 
-                mesh.vertexBuffer = device.create<vk2s::Buffer>(ci, fb);
-                mesh.vertexBuffer->write(vertices.data(), vbSize);
+                    std::cout << "loaded envmap image: " << to_string(load.path) << std::endl;
+                }
+            }
+            catch (std::exception& e)
+            {
+                std::cerr << "failed to load " << to_string(load.path) << ": " << e.what() << "\n";
             }
 
-            {  // index buffer
+            itr = mPendingLoads.erase(itr);
+        }
+    }
 
-                const auto ibSize  = hostMesh.indices.size() * sizeof(uint32_t);
-                const auto ibUsage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer;
+    void Editor::removeEntity(const ec2s::Entity entity)
+    {
+        removeEntities({ entity });
+    }
 
-                vk::BufferCreateInfo ci({}, ibSize, ibUsage);
-                vk::MemoryPropertyFlags fb = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    void Editor::removeEntities(const std::vector<ec2s::Entity>& entities)
+    {
+        auto& device = common()->device;
+        auto& scene  = common()->scene;
+
+        device.waitIdle();
 
-                mesh.indexBuffer = device.create<vk2s::Buffer>(ci, fb);
-                mesh.indexBuffer->write(hostMesh.indices.data(), ibSize);
+        // textures may be shared by instances, so count the references once and destroy the ones no longer referred to
+        std::unordered_map<VkImage, uint32_t> textureRefs;
+        const auto countRef = [&](Handle<vk2s::Image> image)
+        {
+            if (image)
+            {
+                ++textureRefs[image->getVkImage().get()];
             }
+        };
+        scene.each<Material>(
+            [&](const Material& material)
+            {
+                countRef(material.albedoTex);
+                countRef(material.ormTex);
+                countRef(material.normalMapTex);
+            });
+        scene.each<Emitter>([&](const Emitter& emitter) { countRef(emitter.emissiveTex); });
 
-            {  // BLAS
-                mesh.blas = device.create<vk2s::AccelerationStructure>(mesh.hostMesh.vertices.size(), sizeof(Mesh::Vertex), mesh.vertexBuffer.get(), mesh.hostMesh.indices.size() / 3, mesh.indexBuffer.get());
+        const auto releaseTexture = [&](Handle<vk2s::Image>& image)
+        {
+            if (image && --textureRefs[image->getVkImage().get()] == 0)
+            {
+                common()->textureRegistry.destroy(image);
             }
+        };
 
-            {  // materials
-                // params initialize
-                material.params.albedo    = hostMaterial.albedo;
-                material.params.roughness = hostMaterial.roughness.x;
-                material.params.IOR       = hostMaterial.eta.r;
-                material.params.emissive  = glm::vec3(hostMaterial.emissive);
+        for (const auto entity : entities)
+        {
+            if (mPickedEntity && *mPickedEntity == entity)
+            {
+                mPickedEntity.reset();
+            }
 
-                // add emitter component if the material has emissive value
-                if (glm::dot(material.params.emissive, material.params.emissive) > 0.0)
-                {
-                    scene.add<Emitter>(entity);
+            if (scene.contains<Mesh>(entity))
+            {
+                auto& mesh = scene.get<Mesh>(entity);
+                // vertex/index buffers and BLAS are released with the last instance
+                mesh.geometry.reset();
+                device.destroy(mesh.instanceBuffer);
+            }
 
-                    auto& emitter          = scene.get<Emitter>(entity);
-                    emitter.attachedEntity = entity;
+            if (scene.contains<Material>(entity))
+            {
+                auto& material = scene.get<Material>(entity);
+                releaseTexture(material.albedoTex);
+                releaseTexture(material.ormTex);
+                releaseTexture(material.normalMapTex);
+            }
 
-                    emitter.params.emissive = material.params.emissive;
-                    emitter.params.type     = static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eArea);
-                    emitter.params.faceNum  = hostMesh.indices.size() / 3;
+            if (scene.contains<Emitter>(entity))
+            {
+                if (mInfiniteEmitterEntity && mInfiniteEmitterEntity == entity)
+                {
+                    mInfiniteEmitterEntity.reset();
                 }
 
-                // texture loading
-                // share create info
-                vk::ImageCreateInfo ci;
-                ci.arrayLayers   = 1;
-                ci.imageType     = vk::ImageType::e2D;
-                ci.mipLevels     = 1;
-                ci.usage         = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
-                ci.initialLayout = vk::ImageLayout::eUndefined;
+                auto& emitter = scene.get<Emitter>(entity);
+                releaseTexture(emitter.emissiveTex);
+            }
 
-                // albedo texture
-                // TODO: other texture creating
-                if (hostMaterial.albedoTex != -1)
-                {
-                    const auto& hostTex = hostTextures[hostMaterial.albedoTex];
-                    const auto size     = hostTex.width * hostTex.height * static_cast<uint32_t>(STBI_rgb_alpha);
-
-                    ci.format          = vk::Format::eR8G8B8A8Unorm;
-                    ci.extent          = vk::Extent3D(hostTex.width, hostTex.height, 1);
-                    material.albedoTex = device.create<vk2s::Image>(ci, vk::MemoryPropertyFlagBits::eDeviceLocal, size, vk::ImageAspectFlagBits::eColor);
-                    material.albedoTex->write(hostTex.pData, size);
-                    material.params.albedoTexIndex = 0;  // not Material::Params::kInvalidTexIndex
-
-                    // transition from initial layout
-                    UniqueHandle<vk2s::Command> cmd = device.create<vk2s::Command>();
-                    cmd->begin(true);
-                    cmd->transitionImageLayout(material.albedoTex.get(), vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal);
-                    cmd->end();
-                    cmd->execute();
-                }
+            scene.destroy(entity);
+        }
 
-                {  // uniform buffer
-                    const auto frameCount = window->getFrameCount();
-                    const auto ubSize     = sizeof(Material::Params) * frameCount;
-                    vk::BufferCreateInfo ci({}, ubSize, vk::BufferUsageFlagBits::eUniformBuffer);
-                    vk::MemoryPropertyFlags fb = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        mSceneStructureChanged = true;
+    }
 
-                    material.uniformBuffer = device.create<vk2s::DynamicBuffer>(ci, fb, frameCount);
-                    for (int i = 0; i < frameCount; ++i)
-                    {
-                        material.uniformBuffer->write(&material.params, sizeof(Material::Params), i * material.uniformBuffer->getBlockSize());
-                    }
-                }
+    std::vector<ec2s::Entity> Editor::instantiate(const ec2s::Entity source, const std::vector<Transform>& transforms)
+    {
+        auto& scene = common()->scene;
 
-                {  // bindgroup
-                    material.bindGroup = device.create<vk2s::BindGroup>(mGeometryPass.bindLayouts[2].get());
-                    material.bindGroup->bind(0, vk::DescriptorType::eUniformBufferDynamic, material.uniformBuffer.get());
-                    if (material.albedoTex)
-                    {
-                        material.bindGroup->bind(1, vk::DescriptorType::eSampledImage, material.albedoTex);
-                    }
-                    else
-                    {
-                        material.bindGroup->bind(1, vk::DescriptorType::eSampledImage, mDummyTexture);
-                    }
-                    material.bindGroup->bind(2, mLinearSampler.get());
-                }
+        std::vector<ec2s::Entity> entities;
+        if (!scene.contains<Mesh>(source) || !scene.contains<Material>(source) || !scene.contains<Transform>(source) || !scene.contains<EntityInfo>(source))
+        {
+            return entities;
+        }
+
+        // step 1 : create all entities and components first (adding components may move the storage)
+        const bool hasEmitter = scene.contains<Emitter>(source);
+        entities.reserve(transforms.size());
+        for (size_t i = 0; i < transforms.size(); ++i)
+        {
+            const auto entity = scene.create<Mesh, Material, EntityInfo, Transform>();
+            if (hasEmitter)
+            {
+                scene.add<Emitter>(entity);
             }
+            entities.emplace_back(entity);
+        }
 
-            {  // information
-                info.entityName = mesh.hostMesh.nodeName;
-                info.entityID   = entity;
-                info.editable   = true;
+        // step 2 : share the geometry and copy the other components
+        const auto& srcMesh     = scene.get<Mesh>(source);
+        const auto& srcMaterial = scene.get<Material>(source);
+        const auto& srcInfo     = scene.get<EntityInfo>(source);
+        for (size_t i = 0; i < entities.size(); ++i)
+        {
+            const auto entity = entities[i];
 
-                info.groupName      = path.filename().string();
-                const size_t dotPos = info.groupName.find_last_of('.');
-                if (dotPos != std::string_view::npos)
-                {
-                    info.groupName = info.groupName.substr(0, dotPos);
-                }
-            }
+            scene.get<Mesh>(entity).geometry = srcMesh.geometry;
 
-            {  // transform
-                transform.params.world             = glm::identity<glm::mat4>();
-                transform.params.worldInvTranspose = glm::identity<glm::mat4>();
-                transform.params.vel               = glm::vec3(0.f);
-                transform.params.entitySlot        = static_cast<uint32_t>(entity >> ec2s::kEntitySlotShiftWidth);
-                transform.params.entityIndex       = static_cast<uint32_t>(entity & ec2s::kEntityIndexMask);
-
-                const auto frameCount = window->getFrameCount();
-                const auto size       = sizeof(Transform::Params) * frameCount;
-                transform.uniformBuffer =
-                    device.create<vk2s::DynamicBuffer>(vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eUniformBuffer), vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, frameCount);
-                for (int i = 0; i < frameCount; ++i)
-                {
-                    transform.uniformBuffer->write(&transform.params, sizeof(Transform::Params), i * transform.uniformBuffer->getBlockSize());
-                }
+            auto& material        = scene.get<Material>(entity);
+            material.params       = srcMaterial.params;
+            material.albedoTex    = srcMaterial.albedoTex;
+            material.ormTex       = srcMaterial.ormTex;
+            material.normalMapTex = srcMaterial.normalMapTex;
 
-                transform.bindGroup = device.create<vk2s::BindGroup>(mGeometryPass.bindLayouts[1].get());
-                transform.bindGroup->bind(0, vk::DescriptorType::eUniformBufferDynamic, transform.uniformBuffer.get());
-            }
+            auto& info      = scene.get<EntityInfo>(entity);
+            info.groupName  = srcInfo.groupName;
+            info.entityName = srcInfo.entityName + "#" + std::to_string(entity & ec2s::kEntityIndexMask);
+            info.entityID   = entity;
+            info.editable   = true;
 
-            // select added entity
-            mPickedEntity = entity;
+            auto& transform = scene.get<Transform>(entity);
+            transform.pos   = transforms[i].pos;
+            transform.rot   = transforms[i].rot;
+            transform.scale = transforms[i].scale;
+            transform.params.update(transform.pos, transform.rot, transform.scale);
+            transform.params.vel         = glm::vec3(0.f);
+            transform.params.entitySlot  = static_cast<uint32_t>(entity >> ec2s::kEntitySlotShiftWidth);
+            transform.params.entityIndex = static_cast<uint32_t>(entity & ec2s::kEntityIndexMask);
+
+            if (hasEmitter)
+            {
+                auto& emitter          = scene.get<Emitter>(entity);
+                const auto& srcEmitter = scene.get<Emitter>(source);
+                emitter.params         = srcEmitter.params;
+                emitter.emissiveTex    = srcEmitter.emissiveTex;
+                emitter.distribution   = srcEmitter.distribution;
+                emitter.attachedEntity = entity;
+            }
         }
+
+        mSceneStructureChanged = true;
+
+        return entities;
     }
 
-    void Editor::removeEntity(const ec2s::Entity entity)
+    void Editor::scatter(const ec2s::Entity source, const int count, const float radius)
     {
-        if (mPickedEntity && *mPickedEntity == entity)
+        auto& scene = common()->scene;
+
+        if (!scene.contains<Transform>(source) || count <= 0)
+        {
+            return;
+        }
+
+        const auto& srcTransform = scene.get<Transform>(source);
+
+        // random positions on the disk around the source and random rotations around the Y axis
+        std::mt19937 engine(std::random_device{}());
+        std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+        std::vector<Transform> transforms(count);
+        for (auto& transform : transforms)
         {
-            mPickedEntity.reset();
+            const float r     = radius * std::sqrt(dist(engine));
+            const float theta = 2.f * glm::pi<float>() * dist(engine);
+            const float yaw   = 2.f * glm::pi<float>() * dist(engine);
+
+            transform.pos   = srcTransform.pos + glm::vec3(r * std::cos(theta), 0.f, r * std::sin(theta));
+            transform.rot   = glm::angleAxis(yaw, glm::vec3(0.f, 1.f, 0.f)) * srcTransform.rot;
+            transform.scale = srcTransform.scale;
         }
 
+        const auto entities = instantiate(source, transforms);
+        std::cout << "scattered " << entities.size() << " instances (" << common()->meshPool.size() << " unique geometries in the scene)" << std::endl;
+    }
+
+    void Editor::saveScene(const std::filesystem::path& path)
+    {
         auto& device = common()->device;
         auto& scene  = common()->scene;
 
+        // GPU resources are read back
         device.waitIdle();
 
-        if (scene.contains<Mesh>(entity))
+        SceneSerializer serializer(device, scene, common()->meshPool, common()->textureRegistry);
+        if (serializer.save(path))
         {
-            auto& mesh = scene.get<Mesh>(entity);
-            device.destroy(mesh.blas);
-            device.destroy(mesh.vertexBuffer);
-            device.destroy(mesh.indexBuffer);
-            device.destroy(mesh.instanceBuffer);
+            std::cout << "saved scene: " << to_string(path) << std::endl;
         }
+    }
 
-        if (scene.contains<Material>(entity))
-        {
-            auto& material = scene.get<Material>(entity);
-            device.destroy(material.uniformBuffer);
-            device.destroy(material.albedoTex);
-            device.destroy(material.normalMapTex);
-            device.destroy(material.metalnessTex);
-            device.destroy(material.roughnessTex);
-            device.destroy(material.bindGroup);
-        }
+    void Editor::loadScene(const std::filesystem::path& path)
+    {
+        auto& device = common()->device;
+        auto& scene  = common()->scene;
 
-        if (scene.contains<Transform>(entity))
+        SceneSerializer serializer(device, scene, common()->meshPool, common()->textureRegistry);
+        const auto loaded = serializer.load(path);
+        if (loaded.empty())
         {
-            auto& transform = scene.get<Transform>(entity);
-            device.destroy(transform.uniformBuffer);
-            device.destroy(transform.bindGroup);
+            return;
         }
 
-        if (scene.contains<Emitter>(entity))
+        // remove the current scene (the camera is kept unless the loaded scene has one)
+        const bool hasCamera = std::any_of(loaded.begin(), loaded.end(), [&](const ec2s::Entity entity) { return scene.contains<vk2s::Camera>(entity); });
+
+        std::vector<ec2s::Entity> removed;
+        scene.each<EntityInfo>(
+            [&](const ec2s::Entity entity, const EntityInfo& info)
+            {
+                if (std::find(loaded.begin(), loaded.end(), entity) != loaded.end())
+                {
+                    return;
+                }
+
+                if (!hasCamera && entity == mCameraEntity)
+                {
+                    return;
+                }
+
+                removed.emplace_back(entity);
+            });
+
+        removeEntities(removed);
+        mSceneStructureChanged = true;
+
+        for (const auto entity : loaded)
         {
-            if (mInfiniteEmitterEntity && mInfiniteEmitterEntity == entity)
+            if (scene.contains<vk2s::Camera>(entity))
             {
-                mInfiniteEmitterEntity.reset();
+                mCameraEntity = entity;
             }
 
-            auto& emitter = scene.get<Emitter>(entity);
-            device.destroy(emitter.emissiveTex);
+            if (scene.contains<Emitter>(entity) && scene.get<Emitter>(entity).params.type == static_cast<int32_t>(Emitter::Type::eInfinite))
+            {
+                mInfiniteEmitterEntity = entity;
+            }
         }
 
-        scene.destroy(entity);
+        std::cout << "loaded scene: " << to_string(path) << " (" << loaded.size() << " entities)" << std::endl;
     }
 
     void Editor::createGBuffer()
@@ -285,7 +412,7 @@ namespace palm
             ci.format        = format;
             ci.imageType     = vk::ImageType::e2D;
             ci.mipLevels     = 1;
-            ci.usage         = vk::ImageUsageFlagBits::eDepthStencilAttachment;
+            ci.usage         = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
             ci.initialLayout = vk::ImageLayout::eUndefined;
 
             mGBuffer.depthBuffer = device.create<vk2s::Image>(ci, vk::MemoryPropertyFlagBits::eDeviceLocal, size, vk::ImageAspectFlagBits::eDepth);
@@ -321,6 +448,103 @@ namespace palm
         }
     }
 
+    void Editor::createDrawResources(const uint32_t capacity)
+    {
+        auto& device = common()->device;
+        auto& window = common()->window;
+
+        auto& memoryPool     = common()->memoryPool;
+        const auto drawUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer;
+
+        mDrawCapacity = capacity;
+        mDrawResources.resize(window->getFrameCount());
+
+        // all texture slots hold the dummy texture until updateDrawResources()
+        const std::vector<Handle<vk2s::Image>> textures(kMaxRasterTextureNum, mDummyTexture.get());
+
+        for (auto& resources : mDrawResources)
+        {
+            // unique geometries never outnumber the instances
+            // per-frame data written by the CPU are persistently mapped, and the others stay on the GPU
+            resources.instanceBuffer = std::make_unique<PooledBuffer>(device, memoryPool, vk::BufferCreateInfo({}, sizeof(InstanceParams) * capacity, vk::BufferUsageFlagBits::eStorageBuffer), MemoryUsage::eUpload);
+            resources.materialBuffer = std::make_unique<PooledBuffer>(device, memoryPool, vk::BufferCreateInfo({}, sizeof(Material::Params) * capacity, vk::BufferUsageFlagBits::eStorageBuffer), MemoryUsage::eUpload);
+            resources.geometryBuffer = std::make_unique<PooledBuffer>(device, memoryPool, vk::BufferCreateInfo({}, sizeof(DrawGeometryParams) * capacity, vk::BufferUsageFlagBits::eStorageBuffer), MemoryUsage::eUpload);
+            resources.commandBuffer  = std::make_unique<PooledBuffer>(device, memoryPool, vk::BufferCreateInfo({}, sizeof(vk::DrawIndexedIndirectCommand) * capacity * 4, drawUsage), MemoryUsage::eDeviceLocal);
+            resources.cullingBuffer  = std::make_unique<PooledBuffer>(device, memoryPool, vk::BufferCreateInfo({}, sizeof(CullingParams), drawUsage | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc), MemoryUsage::eDeviceLocal);
+            resources.readbackBuffer = std::make_unique<PooledBuffer>(device, memoryPool, vk::BufferCreateInfo({}, sizeof(CullingParams), vk::BufferUsageFlagBits::eTransferDst), MemoryUsage::eReadback);
+
+            const CullingParams empty = {};
+            std::memcpy(resources.readbackBuffer->getMappedPointer(), &empty, sizeof(CullingParams));
+            resources.boundTextures.assign(kMaxRasterTextureNum, mDummyTexture->getVkImage().get());
+            // the new buffers are written entirely by the next updateDrawResources() of each frame
+            resources.sceneVersion = 0;
+            resources.dirtyInstances.clear();
+
+            resources.bindGroup = device.create<vk2s::BindGroup>(mGeometryPass.bindLayouts[1].get());
+            resources.instanceBuffer->bind(resources.bindGroup.get(), 0, vk::DescriptorType::eStorageBuffer);
+            resources.materialBuffer->bind(resources.bindGroup.get(), 1, vk::DescriptorType::eStorageBuffer);
+            resources.bindGroup->bind(2, vk::DescriptorType::eSampledImage, textures);
+            resources.bindGroup->bind(3, mLinearSampler.get());
+
+            resources.cullingBindGroup = device.create<vk2s::BindGroup>(mCullingBindLayout.get());
+            resources.instanceBuffer->bind(resources.cullingBindGroup.get(), 0, vk::DescriptorType::eStorageBuffer);
+            resources.geometryBuffer->bind(resources.cullingBindGroup.get(), 1, vk::DescriptorType::eStorageBuffer);
+            resources.commandBuffer->bind(resources.cullingBindGroup.get(), 2, vk::DescriptorType::eStorageBuffer);
+            resources.cullingBuffer->bind(resources.cullingBindGroup.get(), 3, vk::DescriptorType::eStorageBuffer);
+            mFrameRing->bind(resources.cullingBindGroup.get(), 4, sizeof(SceneParams));
+            mHiZBuffer->bind(resources.cullingBindGroup.get(), 6, vk::DescriptorType::eStorageBuffer);
+            resources.cullingBindGroup->bind(7, vk::DescriptorType::eSampledImage, mGBuffer.depthBuffer.get());
+            mHiZLevelBuffer->bind(resources.cullingBindGroup.get(), 8, vk::DescriptorType::eUniformBufferDynamic, sizeof(HiZLevelParams));
+        }
+
+        // visibility of the last frame is lost, so every instance is drawn in the late phase of the next frame
+        mVisibilityBuffer = std::make_unique<PooledBuffer>(device, memoryPool, vk::BufferCreateInfo({}, sizeof(uint32_t) * capacity, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst), MemoryUsage::eDeviceLocal);
+        {
+            UniqueHandle<vk2s::Fence> fence = device.create<vk2s::Fence>();
+            fence->reset();
+            UniqueHandle<vk2s::Command> cmd = device.create<vk2s::Command>();
+            cmd->begin(true);
+            cmd->getVkCommandBuffer()->fillBuffer(mVisibilityBuffer->getVkBuffer(), 0, VK_WHOLE_SIZE, 0);
+            cmd->end();
+            cmd->execute(fence);
+            fence->wait();
+        }
+
+        for (auto& resources : mDrawResources)
+        {
+            mVisibilityBuffer->bind(resources.cullingBindGroup.get(), 5, vk::DescriptorType::eStorageBuffer);
+        }
+    }
+
+    void Editor::createHiZ()
+    {
+        auto& device = common()->device;
+        auto& window = common()->window;
+
+        const auto [windowWidth, windowHeight] = window->getWindowSize();
+
+        // level 0 is half of the depth buffer, and each level halves (rounding up) down to 1 x 1
+        mHiZSize              = glm::max((glm::uvec2(windowWidth, windowHeight) + 1u) / 2u, glm::uvec2(1));
+        mHiZLevelNum          = 1;
+        glm::uvec2 size       = mHiZSize;
+        vk::DeviceSize texels = size.x * size.y;
+        while ((size.x > 1 || size.y > 1) && mHiZLevelNum < kMaxHiZLevelNum)
+        {
+            size = glm::max((size + 1u) / 2u, glm::uvec2(1));
+            texels += size.x * size.y;
+            ++mHiZLevelNum;
+        }
+
+        mHiZBuffer = std::make_unique<PooledBuffer>(device, common()->memoryPool, vk::BufferCreateInfo({}, sizeof(float) * texels, vk::BufferUsageFlagBits::eStorageBuffer), MemoryUsage::eDeviceLocal);
+
+        // the depth buffer is also recreated with the window
+        for (auto& resources : mDrawResources)
+        {
+            mHiZBuffer->bind(resources.cullingBindGroup.get(), 6, vk::DescriptorType::eStorageBuffer);
+            resources.cullingBindGroup->bind(7, vk::DescriptorType::eSampledImage, mGBuffer.depthBuffer.get());
+        }
+    }
+
     void Editor::initVulkan()
     {
         auto& device = getCommonRegion()->device;
@@ -333,8 +557,12 @@ namespace palm
         {
             // nearest sampler
             mNearestSampler = device.create<vk2s::Sampler>(vk::SamplerCreateInfo({}, vk::Filter::eNearest, vk::Filter::eNearest));
-            // linear sampler
-            mLinearSampler = device.create<vk2s::Sampler>(vk::SamplerCreateInfo({}, vk::Filter::eLinear, vk::Filter::eLinear));
+            // linear sampler (trilinear for mipmapped material textures)
+            {
+                vk::SamplerCreateInfo ci({}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear);
+                ci.maxLod      = VK_LOD_CLAMP_NONE;
+                mLinearSampler = device.create<vk2s::Sampler>(ci);
+            }
 
             // create G-Buffer
             auto& device = getCommonRegion()->device;
@@ -382,9 +610,13 @@ namespace palm
                 std::vector<Handle<vk2s::Image>> images = { mGBuffer.albedoTex, mGBuffer.worldPosTex, mGBuffer.normalTex, mGBuffer.roughnessMetalnessTex };
 
                 mGeometryPass.renderpass = device.create<vk2s::RenderPass>(images, mGBuffer.depthBuffer, vk::AttachmentLoadOp::eClear);
+                // the late phase of occlusion culling draws on top of the early phase
+                mGeometryLateRenderpass = device.create<vk2s::RenderPass>(images, mGBuffer.depthBuffer, vk::AttachmentLoadOp::eLoad);
 
-                mGeometryPass.vs = device.create<vk2s::Shader>("../../shaders/Slang/Rasterize/Deferred/Geometry.slang", "vsmain");
-                mGeometryPass.fs = device.create<vk2s::Shader>("../../shaders/Slang/Rasterize/Deferred/Geometry.slang", "fsmain");
+                // the vertex input follows the format of the global vertex buffer
+                const bool compactVertex = common()->meshPool.getVertexFormat() == VertexFormat::eCompact;
+                mGeometryPass.vs         = device.create<vk2s::Shader>("../../shaders/Slang/Rasterize/Deferred/Geometry.slang", compactVertex ? "vsmainCompact" : "vsmain");
+                mGeometryPass.fs         = device.create<vk2s::Shader>("../../shaders/Slang/Rasterize/Deferred/Geometry.slang", "fsmain");
 
                 std::vector bindings0 = {
                     // Scene MVP information
@@ -393,25 +625,20 @@ namespace palm
                 };
 
                 std::vector bindings1 = {
-                    // Entity information
-                    vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eAll),
-                };
-
-                std::vector bindings2 = {
-                    // Material params
-                    vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eAll),
+                    // Instances
+                    vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eAll),
+                    // Materials
+                    vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eAll),
                     // Material Textures
-                    vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eSampledImage, 1, vk::ShaderStageFlagBits::eAll),
+                    vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eSampledImage, kMaxRasterTextureNum, vk::ShaderStageFlagBits::eAll),
                     // Sampler
-                    vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eSampler, 1, vk::ShaderStageFlagBits::eAll),
-
+                    vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eSampler, 1, vk::ShaderStageFlagBits::eAll),
                 };
 
                 mGeometryPass.bindLayouts.emplace_back(device.create<vk2s::BindLayout>(bindings0));
                 mGeometryPass.bindLayouts.emplace_back(device.create<vk2s::BindLayout>(bindings1));
-                mGeometryPass.bindLayouts.emplace_back(device.create<vk2s::BindLayout>(bindings2));
 
-                vk::VertexInputBindingDescription inputBinding(0, sizeof(Mesh::Vertex));
+                vk::VertexInputBindingDescription inputBinding(0, static_cast<uint32_t>(common()->meshPool.getVertexStride()));
                 const auto& inputAttributes = std::get<0>(mGeometryPass.vs->getReflection());
                 vk::PipelineColorBlendAttachmentState colorBlendAttachment(VK_FALSE);
                 colorBlendAttachment.setColorWriteMask(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
@@ -439,6 +666,57 @@ namespace palm
                 mGeometryPass.pipeline = device.create<vk2s::Pipeline>(gpi);
             }
 
+            {  // GPU culling (generates the draw commands of the geometry pass)
+                const auto path     = "../../shaders/Slang/Rasterize/Deferred/Culling.slang";
+                mCullingEarlyShader = device.create<vk2s::Shader>(path, "csEarly");
+                mCullingLateShader  = device.create<vk2s::Shader>(path, "csLate");
+                mHiZShader          = device.create<vk2s::Shader>(path, "csBuildHiZ");
+
+                std::vector bindings = {
+                    // Instances
+                    vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+                    // Geometries
+                    vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+                    // Draw commands
+                    vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+                    // Culling params (draw counts and statistics)
+                    vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+                    // Scene (view and projection)
+                    vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute),
+                    // Visibilities of the last frame
+                    vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+                    // Hi-Z pyramid
+                    vk::DescriptorSetLayoutBinding(6, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+                    // Depth buffer
+                    vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eSampledImage, 1, vk::ShaderStageFlagBits::eCompute),
+                    // Hi-Z level
+                    vk::DescriptorSetLayoutBinding(8, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute),
+                };
+
+                mCullingBindLayout = device.create<vk2s::BindLayout>(bindings);
+
+                vk2s::Pipeline::ComputePipelineInfo cpi{
+                    .cs          = mCullingEarlyShader,
+                    .bindLayouts = mCullingBindLayout,
+                };
+                mCullingEarlyPipeline = device.create<vk2s::Pipeline>(cpi);
+
+                cpi.cs               = mCullingLateShader;
+                mCullingLatePipeline = device.create<vk2s::Pipeline>(cpi);
+
+                cpi.cs       = mHiZShader;
+                mHiZPipeline = device.create<vk2s::Pipeline>(cpi);
+
+                // one block per level of the pyramid (selected by the dynamic offset)
+                const auto size = kHiZLevelStride * kMaxHiZLevelNum;
+                mHiZLevelBuffer = std::make_unique<PooledBuffer>(device, common()->memoryPool, vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eUniformBuffer), MemoryUsage::eUpload);
+                for (uint32_t i = 0; i < kMaxHiZLevelNum; ++i)
+                {
+                    const HiZLevelParams params{ .level = i };
+                    mHiZLevelBuffer->write(&params, sizeof(HiZLevelParams), i * kHiZLevelStride);
+                }
+            }
+
             {  // lighting pass
                 mLightingPass.renderpass = device.create<vk2s::RenderPass>(window.get(), vk::AttachmentLoadOp::eClear);
                 mLightingPass.vs         = device.create<vk2s::Shader>("../../shaders/Slang/Rasterize/Deferred/Lighting.slang", "vsmain");
@@ -489,28 +767,23 @@ namespace palm
             // initialize ImGui
             device.initImGui(window.get(), mLightingPass.renderpass.get());
 
-            // scene uniform buffer
-            {
-                const auto size = sizeof(SceneParams) * frameCount;
-                mSceneBuffer    = device.create<vk2s::DynamicBuffer>(vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eUniformBuffer), vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, frameCount);
-            }
+            // per-frame uniform data (scene and emitters)
+            mFrameRing = std::make_unique<FrameRing>(device, common()->memoryPool, kFrameRingRegionSize, frameCount);
 
             // storage buffer (for picked ID)
             {
                 const auto size = sizeof(ec2s::Entity);
-                mPickedIDBuffer = device.create<vk2s::Buffer>(vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eStorageBuffer), vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-            }
-
-            // emitter uniform buffer
-            {
-                const auto size = sizeof(Emitter::Params) * kMaxEmitterNum * frameCount;
-                mEmitterBuffer  = device.create<vk2s::DynamicBuffer>(vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eUniformBuffer), vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, frameCount);
+                mPickedIDBuffer = std::make_unique<PooledBuffer>(device, common()->memoryPool, vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eStorageBuffer), MemoryUsage::eReadback);
             }
 
             // create bindgroup
             mSceneBindGroup = device.create<vk2s::BindGroup>(mGeometryPass.bindLayouts[0].get());
 
-            mSceneBindGroup->bind(0, vk::DescriptorType::eUniformBufferDynamic, mSceneBuffer.get());
+            mFrameRing->bind(mSceneBindGroup.get(), 0, sizeof(SceneParams));
+
+            // resources of the GPU-driven geometry pass
+            createHiZ();
+            createDrawResources(kInitialDrawCapacity);
 
             mGBuffer.bindGroup = device.create<vk2s::BindGroup>(mLightingPass.bindLayouts[0].get());
             mGBuffer.bindGroup->bind(0, vk::DescriptorType::eSampledImage, mGBuffer.albedoTex);
@@ -520,9 +793,9 @@ namespace palm
             mGBuffer.bindGroup->bind(4, mNearestSampler.get());
 
             mLightingBindGroup = device.create<vk2s::BindGroup>(mLightingPass.bindLayouts[1].get());
-            mLightingBindGroup->bind(0, vk::DescriptorType::eUniformBufferDynamic, mSceneBuffer.get());
-            mLightingBindGroup->bind(1, vk::DescriptorType::eStorageBuffer, mPickedIDBuffer.get());
-            mLightingBindGroup->bind(2, vk::DescriptorType::eUniformBufferDynamic, mEmitterBuffer.get());
+            mFrameRing->bind(mLightingBindGroup.get(), 0, sizeof(SceneParams));
+            mPickedIDBuffer->bind(mLightingBindGroup.get(), 1, vk::DescriptorType::eStorageBuffer);
+            mFrameRing->bind(mLightingBindGroup.get(), 2, sizeof(Emitter::Params) * kMaxEmitterNum);
             mLightingBindGroup->bind(3, vk::DescriptorType::eSampledImage, mDummyTexture);
             mLightingBindGroup->bind(4, mLinearSampler.get());
 
@@ -590,19 +863,6 @@ namespace palm
                 }
             });
 
-        // update material binding
-        scene.each<Material>(
-            [&](Material& material)
-            {
-                // bind dummy texture
-                if (!material.albedoTex)
-                {
-                    material.bindGroup->bind(1, vk::DescriptorType::eSampledImage, mDummyTexture);
-                }
-                // bind default sampler
-                material.bindGroup->bind(2, mNearestSampler.get());
-            });
-
         // member variables initialization
         mCurrentGizmoOperation = ImGuizmo::TRANSLATE;
         mCurrentPath           = std::filesystem::current_path();
@@ -611,6 +871,8 @@ namespace palm
 
         mEnvmapBrowser      = ImGui::FileBrowser(ImGuiFileBrowserFlags_EnterNewFilename | ImGuiFileBrowserFlags_CreateNewDir | ImGuiFileBrowserFlags_ConfirmOnEnter | ImGuiFileBrowserFlags_SkipItemsCausingError);
         mMaterialTexBrowser = ImGui::FileBrowser(ImGuiFileBrowserFlags_EnterNewFilename | ImGuiFileBrowserFlags_CreateNewDir | ImGuiFileBrowserFlags_ConfirmOnEnter | ImGuiFileBrowserFlags_SkipItemsCausingError);
+        mSceneSaveBrowser   = ImGui::FileBrowser(ImGuiFileBrowserFlags_EnterNewFilename | ImGuiFileBrowserFlags_CreateNewDir | ImGuiFileBrowserFlags_ConfirmOnEnter | ImGuiFileBrowserFlags_SkipItemsCausingError);
+        mSceneLoadBrowser   = ImGui::FileBrowser(ImGuiFileBrowserFlags_ConfirmOnEnter | ImGuiFileBrowserFlags_SkipItemsCausingError);
     }
 
     void Editor::update()
@@ -675,6 +937,11 @@ namespace palm
 
         // wait and reset fence
         mFences[mNow]->wait();
+        // the uniform data of this frame can be overwritten
+        mFrameRing->begin(mNow);
+
+        // add the models and envmaps loaded in the background
+        updatePendingLoads();
 
         // ImGui
         updateAndRenderImGui(deltaTime);
@@ -698,31 +965,41 @@ namespace palm
         auto& command = mCommands[mNow];
         // start writing command
         command->begin();
+        // frustum culling and the early phase of occlusion culling
+        recordCulling(command, CullingPhase::eEarly);
         // geometry pass
         {
-            command->beginRenderPass(mGeometryPass.renderpass.get(), 0, vk::Rect2D({ 0, 0 }, { windowWidth, windowHeight }), clearValues);
-
-            command->setPipeline(mGeometryPass.pipeline);
-
             const vk::Viewport viewport(0.f, 0.f, static_cast<float>(windowWidth), static_cast<float>(windowHeight), 0.f, 1.f);
             const vk::Rect2D scissor({ 0, 0 }, window->getVkSwapchainExtent());
-            command->setViewport(0, viewport);
-            command->setScissor(0, scissor);
 
-            command->setBindGroup(0, mSceneBindGroup.get(), { mNow * static_cast<uint32_t>(mSceneBuffer->getBlockSize()) });
-            // draw call
-            scene.each<Mesh, Material, Transform>(
-                [&](Mesh& mesh, Material& material, Transform& transform)
-                {
-                    command->setBindGroup(1, transform.bindGroup.get(), { mNow * static_cast<uint32_t>(transform.uniformBuffer->getBlockSize()) });
-                    command->setBindGroup(2, material.bindGroup.get(), { mNow * static_cast<uint32_t>(material.uniformBuffer->getBlockSize()) });
-                    command->bindVertexBuffer(mesh.vertexBuffer.get());
-                    command->bindIndexBuffer(mesh.indexBuffer.get());
+            const auto drawGeometries = [&](const CullingPhase phase)
+            {
+                command->setPipeline(mGeometryPass.pipeline);
+                command->setViewport(0, viewport);
+                command->setScissor(0, scissor);
 
-                    command->drawIndexed(mesh.hostMesh.indices.size(), 1, 0, 0, 1);
-                });
+                command->setBindGroup(0, mSceneBindGroup.get(), { mSceneOffset });
+                command->setBindGroup(1, mDrawResources[mNow].bindGroup.get());
+                // all geometries are in the global buffers of the pool (pooled, so bound directly)
+                command->getVkCommandBuffer()->bindVertexBuffers(0, common()->meshPool.getVertexBuffer().getVkBuffer(), { 0 });
+
+                recordGeometryDraws(command, phase);
+            };
 
+            command->beginRenderPass(mGeometryPass.renderpass.get(), 0, vk::Rect2D({ 0, 0 }, { windowWidth, windowHeight }), clearValues);
+            drawGeometries(CullingPhase::eEarly);
             command->endRenderPass();
+
+            // late phase : draw the instances that have become visible, tested against the depth of the early phase
+            if (mOcclusionCulling)
+            {
+                recordHiZBuild(command);
+                recordCulling(command, CullingPhase::eLate);
+
+                command->beginRenderPass(mGeometryLateRenderpass.get(), 0, vk::Rect2D({ 0, 0 }, { windowWidth, windowHeight }), clearValues);
+                drawGeometries(CullingPhase::eLate);
+                command->endRenderPass();
+            }
         }
 
         // barrier
@@ -745,7 +1022,7 @@ namespace palm
             command->setScissor(0, scissor);
 
             command->setBindGroup(0, mGBuffer.bindGroup.get());
-            command->setBindGroup(1, mLightingBindGroup.get(), { mNow * static_cast<uint32_t>(mSceneBuffer->getBlockSize()), mNow * static_cast<uint32_t>(mEmitterBuffer->getBlockSize()) });
+            command->setBindGroup(1, mLightingBindGroup.get(), { mSceneOffset, mEmitterOffset });
             command->draw(4, 1, 0, 0);
             command->drawImGui();
 
@@ -791,6 +1068,13 @@ namespace palm
     {
         auto& device = getCommonRegion()->device;
 
+        // the futures wait for their loading threads, which stop at the next step once cancelled
+        for (auto& load : mPendingLoads)
+        {
+            load.control->cancelled = true;
+        }
+        mPendingLoads.clear();
+
         for (auto& fence : mFences)
         {
             fence->wait();
@@ -849,70 +1133,369 @@ namespace palm
                 .frameSize = glm::uvec2(renderAreaWidth, renderAreaHeight),
             };
 
-            mSceneBuffer->write(&sceneParams, sizeof(SceneParams), mNow * mSceneBuffer->getBlockSize());
+            mSceneOffset = mFrameRing->push(sceneParams);
         }
 
         // read clicked pixel's entity
         if (isPointerOnRenderArea() && window->getMouseKey(GLFW_MOUSE_BUTTON_LEFT) && !ImGuizmo::IsUsing() && !mDragging)
         {
-            mPickedIDBuffer->read(
-                [&](const void* p)
+            // persistently mapped, so the entity is read directly
+            const auto hovered = *(reinterpret_cast<const ec2s::Entity*>(mPickedIDBuffer->getMappedPointer()));
+            if (hovered != 0 && (!mPickedEntity || *mPickedEntity != hovered))
+            {
+                mPickedEntity = hovered;
+            }
+        }
+
+        // write the edited instances, materials and emitters
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            updateDrawResources();
+            updateEmitters();
+            mSceneDelta.clear();
+
+            mUploadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    void Editor::rebuildDrawScene()
+    {
+        auto& scene = common()->scene;
+
+        const auto version = mDrawScene.version;
+        mDrawScene         = DrawScene{ .version = version + 1 };
+
+        const auto meshNum = scene.size<Mesh>();
+        mDrawScene.entities.reserve(meshNum);
+        mDrawScene.instances.reserve(meshNum);
+        mDrawScene.materials.reserve(meshNum);
+
+        // slot 0 is the dummy texture (for materials expecting a texture without one)
+        auto& textures = mDrawScene.textures;
+        textures.emplace_back(mDummyTexture.get());
+        std::unordered_map<VkImage, int32_t> textureIndices;
+        std::unordered_map<const MeshGeometry*, uint32_t> geometryIndices;
+
+        scene.each<Mesh, Material, Transform>(
+            [&](const ec2s::Entity entity, Mesh& mesh, Material& material, Transform& transform)
+            {
+                const auto& geometry         = *mesh.geometry;
+                const auto [it, newGeometry] = geometryIndices.try_emplace(&geometry, static_cast<uint32_t>(mDrawScene.geometries.size()));
+                if (newGeometry)
                 {
-                    const auto hovered = *(reinterpret_cast<const ec2s::Entity*>(p));
-                    if (hovered != 0 && (!mPickedEntity || *mPickedEntity != hovered))
+                    // firstIndex of geometries with 16 bit indices is counted in words
+                    const bool index16 = geometry.indexType == vk::IndexType::eUint16;
+                    mDrawScene.geometries.emplace_back(DrawGeometryParams{
+                        .firstIndex    = index16 ? geometry.firstIndex * 2 : geometry.firstIndex,
+                        .indexCount    = geometry.indexCount,
+                        .vertexOffset  = static_cast<int32_t>(geometry.firstVertex),
+                        .indexTypeSlot = index16 ? 1u : 0u,
+                        .aabbMin       = geometry.aabbMin,
+                        .aabbMax       = geometry.aabbMax,
+                    });
+                }
+
+                // texture indices refer to the texture table of the geometry pass
+                Material::Params params = material.params;
+                if (params.albedoTexIndex != Material::Params::kInvalidTexIndex)
+                {
+                    params.albedoTexIndex = 0;
+                    if (material.albedoTex)
                     {
-                        mPickedEntity = hovered;
+                        const auto [texIt, newTexture] = textureIndices.try_emplace(material.albedoTex->getVkImage().get(), static_cast<int32_t>(textures.size()));
+                        if (newTexture && textures.size() < kMaxRasterTextureNum)
+                        {
+                            textures.emplace_back(material.albedoTex);
+                        }
+                        // the albedo color is shown instead if the texture table overflows
+                        params.albedoTexIndex = texIt->second < static_cast<int32_t>(kMaxRasterTextureNum) ? texIt->second : Material::Params::kInvalidTexIndex;
                     }
-                },
-                sizeof(ec2s::Entity), 0);
+                }
+
+                const auto instanceIndex = static_cast<uint32_t>(mDrawScene.instances.size());
+                mDrawScene.instances.emplace_back(InstanceParams{
+                    .model             = transform.params.world,
+                    .modelInvTranspose = transform.params.worldInvTranspose,
+                    .entitySlot        = transform.params.entitySlot,
+                    .entityIndex       = transform.params.entityIndex,
+                    .materialIndex     = instanceIndex,
+                    .geometryIndex     = it->second,
+                });
+                mDrawScene.materials.emplace_back(params);
+                mDrawScene.entities.emplace_back(entity);
+                mDrawScene.instanceIndices.emplace(entity, instanceIndex);
+            });
+
+        textures.resize(kMaxRasterTextureNum, mDummyTexture.get());
+
+        // the edits are included in the rebuilt copy
+        mSceneStructureChanged = false;
+        mSceneDelta.clear();
+    }
+
+    void Editor::updateDrawResources()
+    {
+        auto& device = common()->device;
+        auto& scene  = common()->scene;
+
+        // the fence of this frame has been waited, so its buffers can be rewritten
+        // (the visibility buffer is shared by all frames, so growing waits for all of them)
+        const auto meshNum = static_cast<uint32_t>(scene.size<Mesh>());
+        if (meshNum > mDrawCapacity)
+        {
+            uint32_t capacity = mDrawCapacity;
+            while (capacity < meshNum)
+            {
+                capacity *= 2;
+            }
+            device.waitIdle();
+            createDrawResources(capacity);
+        }
+
+        auto& resources = mDrawResources[mNow];
+
+        // statistics of the last use of this frame slot
+        std::memcpy(&mCullingStats, resources.readbackBuffer->getMappedPointer(), sizeof(CullingParams));
+
+        if (mSceneStructureChanged || meshNum != mDrawScene.instances.size())
+        {
+            rebuildDrawScene();
         }
 
-        // write entity transform
-        scene.each<Transform>([&](Transform& transform) { transform.uniformBuffer->write(&transform.params, sizeof(Transform::Params), mNow * transform.uniformBuffer->getBlockSize()); });
+        // apply the edits to the CPU-side copy, and queue them for every frame (each frame has its own buffers)
+        const auto markDirty = [&](const uint32_t instanceIndex)
+        {
+            for (auto& frame : mDrawResources)
+            {
+                frame.dirtyInstances.emplace_back(instanceIndex);
+            }
+        };
 
-        // write entity material
-        scene.each<Material>([&](Material& material) { material.uniformBuffer->write(&material.params, sizeof(Material::Params), mNow * material.uniformBuffer->getBlockSize()); });
+        for (const auto entity : mSceneDelta.transforms)
+        {
+            const auto itr = mDrawScene.instanceIndices.find(entity);
+            if (itr == mDrawScene.instanceIndices.end() || !scene.contains<Transform>(entity))
+            {
+                continue;
+            }
 
-        // write emitters
+            const auto& transform      = scene.get<Transform>(entity);
+            auto& instance             = mDrawScene.instances[itr->second];
+            instance.model             = transform.params.world;
+            instance.modelInvTranspose = transform.params.worldInvTranspose;
+            markDirty(itr->second);
+        }
+
+        for (const auto entity : mSceneDelta.materials)
         {
-            constexpr size_t size = sizeof(Emitter::Params) * kMaxEmitterNum;
-            std::byte zeros[size] = { static_cast<std::byte>(0) };
-            mEmitterBuffer->write(zeros, size, mNow * mEmitterBuffer->getBlockSize());
+            const auto itr = mDrawScene.instanceIndices.find(entity);
+            if (itr == mDrawScene.instanceIndices.end() || !scene.contains<Material>(entity))
+            {
+                continue;
+            }
 
-            std::vector<Emitter::Params> emitterParams;
-            emitterParams.reserve(kMaxEmitterNum);
+            // textures are never replaced by edits, so the index into the texture table is kept
+            auto& params           = mDrawScene.materials[itr->second];
+            const int32_t texIndex = params.albedoTexIndex;
+            params                 = scene.get<Material>(entity).params;
+            params.albedoTexIndex  = texIndex;
+            markDirty(itr->second);
+        }
 
-            scene.each<Emitter>(
-                [&](const ec2s::Entity entity, Emitter& emitter)
-                {
-                    if (emitterParams.size() >= kMaxEmitterNum)
-                    {
-                        return;
-                    }
+        // write this frame
+        if (resources.sceneVersion != mDrawScene.version || mForceFullUpload)
+        {
+            resources.instanceNum = static_cast<uint32_t>(mDrawScene.instances.size());
+            if (resources.instanceNum > 0)
+            {
+                resources.instanceBuffer->write(mDrawScene.instances.data(), sizeof(InstanceParams) * mDrawScene.instances.size());
+                resources.materialBuffer->write(mDrawScene.materials.data(), sizeof(Material::Params) * mDrawScene.materials.size());
+                resources.geometryBuffer->write(mDrawScene.geometries.data(), sizeof(DrawGeometryParams) * mDrawScene.geometries.size());
+            }
 
-                    if (scene.contains<Transform>(entity))
-					{
-						emitter.params.pos = scene.get<Transform>(entity).pos;
-					}
+            // rebind the texture array only when the table has changed
+            bool texturesChanged = false;
+            for (uint32_t i = 0; i < kMaxRasterTextureNum; ++i)
+            {
+                const VkImage image = mDrawScene.textures[i]->getVkImage().get();
+                texturesChanged |= resources.boundTextures[i] != image;
+                resources.boundTextures[i] = image;
+            }
 
-                    emitterParams.emplace_back(emitter.params);
-                });
+            if (texturesChanged)
+            {
+                resources.bindGroup->bind(2, vk::DescriptorType::eSampledImage, mDrawScene.textures);
+            }
 
-            if (!emitterParams.empty())
+            mUploadedInstanceNum   = resources.instanceNum;
+            resources.sceneVersion = mDrawScene.version;
+        }
+        else
+        {
+            // only the edited instances, contiguous ones in one write
+            auto& dirty = resources.dirtyInstances;
+            std::sort(dirty.begin(), dirty.end());
+            dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+            for (size_t begin = 0; begin < dirty.size();)
             {
-                mEmitterBuffer->write(emitterParams.data(), sizeof(Emitter::Params) * emitterParams.size(), mNow * mEmitterBuffer->getBlockSize());
+                size_t end = begin + 1;
+                while (end < dirty.size() && dirty[end] == dirty[end - 1] + 1)
+                {
+                    ++end;
+                }
+
+                const uint32_t first = dirty[begin];
+                const uint32_t count = static_cast<uint32_t>(end - begin);
+                resources.instanceBuffer->write(mDrawScene.instances.data() + first, sizeof(InstanceParams) * count, sizeof(InstanceParams) * first);
+                resources.materialBuffer->write(mDrawScene.materials.data() + first, sizeof(Material::Params) * count, sizeof(Material::Params) * first);
+
+                begin = end;
             }
 
-            // update bind group
-            mLightingBindGroup->bind(3, vk::DescriptorType::eSampledImage, mDummyTexture);
-            if (mInfiniteEmitterEntity)
+            mUploadedInstanceNum = static_cast<uint32_t>(dirty.size());
+        }
+
+        resources.dirtyInstances.clear();
+    }
+
+    void Editor::updateEmitters()
+    {
+        auto& scene = common()->scene;
+
+        // the unused tail is written as zeros together
+        std::array<Emitter::Params, kMaxEmitterNum> emitterParams = {};
+        size_t emitterNum                                         = 0;
+        scene.each<Emitter>(
+            [&](const ec2s::Entity entity, Emitter& emitter)
             {
-                auto& emitter       = scene.get<Emitter>(*mInfiniteEmitterEntity);
-                if (emitter.emissiveTex)
+                if (emitterNum >= kMaxEmitterNum)
                 {
-                    mLightingBindGroup->bind(3, vk::DescriptorType::eSampledImage, emitter.emissiveTex);
+                    return;
                 }
+
+                if (scene.contains<Transform>(entity))
+                {
+                    emitter.params.pos = scene.get<Transform>(entity).pos;
+                }
+
+                emitterParams[emitterNum++] = emitter.params;
+            });
+
+        mEmitterOffset = mFrameRing->push(emitterParams);
+
+        // update bind group
+        Handle<vk2s::Image> envmap = mDummyTexture.get();
+        if (mInfiniteEmitterEntity)
+        {
+            auto& emitter = scene.get<Emitter>(*mInfiniteEmitterEntity);
+            if (emitter.emissiveTex)
+            {
+                envmap = emitter.emissiveTex;
+            }
+        }
+
+        if (mBoundEnvmap != envmap->getVkImage().get())
+        {
+            mLightingBindGroup->bind(3, vk::DescriptorType::eSampledImage, envmap);
+            mBoundEnvmap = envmap->getVkImage().get();
+        }
+    }
+
+    void Editor::recordCulling(Handle<vk2s::Command> command, const CullingPhase phase)
+    {
+        const auto& resources = mDrawResources[mNow];
+        auto& commandBuffer   = command->getVkCommandBuffer();
+        const bool early      = phase == CullingPhase::eEarly;
+
+        if (early)
+        {
+            // header and zeroed counts (kept through the late phase)
+            const CullingParams params{
+                .instanceNum      = resources.instanceNum,
+                .capacity         = mDrawCapacity,
+                .hizSize          = mHiZSize,
+                .hizLevelNum      = mHiZLevelNum,
+                .occlusionCulling = mOcclusionCulling ? 1u : 0u,
+                .drawNum          = { 0, 0, 0, 0 },
+            };
+            commandBuffer->updateBuffer(resources.cullingBuffer->getVkBuffer(), 0, sizeof(CullingParams), &params);
+        }
+
+        const vk::MemoryBarrier beforeCulling(vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+        commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, beforeCulling, {}, {});
+
+        if (resources.instanceNum > 0)
+        {
+            command->setPipeline(early ? mCullingEarlyPipeline : mCullingLatePipeline);
+            command->setBindGroup(0, resources.cullingBindGroup.get(), { mSceneOffset, 0 });
+            command->dispatch((resources.instanceNum + kCullingThreadNum - 1) / kCullingThreadNum, 1, 1);
+        }
+
+        const vk::MemoryBarrier afterCulling(vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferRead);
+        commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, {}, afterCulling, {}, {});
+
+        // statistics are read back when this frame slot comes around again
+        if (!early || !mOcclusionCulling)
+        {
+            commandBuffer->copyBuffer(resources.cullingBuffer->getVkBuffer(), resources.readbackBuffer->getVkBuffer(), vk::BufferCopy(0, 0, sizeof(CullingParams)));
+
+            const vk::MemoryBarrier afterCopy(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+            commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, afterCopy, {}, {});
+        }
+    }
+
+    void Editor::recordHiZBuild(Handle<vk2s::Command> command)
+    {
+        const auto& resources = mDrawResources[mNow];
+        auto& commandBuffer   = command->getVkCommandBuffer();
+
+        const vk::ImageSubresourceRange depthRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1);
+        const vk::Image depthImage = mGBuffer.depthBuffer->getVkImage().get();
+
+        {  // depth of the early phase -> sampled
+            const vk::ImageMemoryBarrier barrier(vk::AccessFlagBits::eDepthStencilAttachmentWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, depthImage, depthRange);
+            commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eLateFragmentTests, vk::PipelineStageFlagBits::eComputeShader, {}, {}, {}, barrier);
+        }
+
+        command->setPipeline(mHiZPipeline);
+
+        // each level reduces the previous one (level 0 reduces the depth buffer)
+        const vk::MemoryBarrier levelBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+        glm::uvec2 size = mHiZSize;
+        for (uint32_t level = 0; level < mHiZLevelNum; ++level)
+        {
+            // halves rounding up (same as createHiZ() and getLevelSize() in the shader)
+            if (level > 0)
+            {
+                size = glm::max((size + 1u) / 2u, glm::uvec2(1));
             }
+
+            command->setBindGroup(0, resources.cullingBindGroup.get(), { mSceneOffset, level * static_cast<uint32_t>(kHiZLevelStride) });
+            command->dispatch((size.x + kHiZThreadNum - 1) / kHiZThreadNum, (size.y + kHiZThreadNum - 1) / kHiZThreadNum, 1);
+            commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, levelBarrier, {}, {});
+        }
+
+        {  // back to the attachment for the late phase
+            const vk::ImageMemoryBarrier barrier(vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eDepthStencilAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, depthImage, depthRange);
+            commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eEarlyFragmentTests, {}, {}, {}, barrier);
+        }
+    }
+
+    void Editor::recordGeometryDraws(Handle<vk2s::Command> command, const CullingPhase phase)
+    {
+        const auto& resources = mDrawResources[mNow];
+
+        // one indirect draw per index type, the commands have been compacted into the slot of each type
+        const vk::Buffer indexBuffer      = common()->meshPool.getIndexBuffer().getVkBuffer();
+        constexpr std::array kIndexTypes  = { vk::IndexType::eUint32, vk::IndexType::eUint16 };
+        constexpr vk::DeviceSize kCmdSize = sizeof(vk::DrawIndexedIndirectCommand);
+        for (uint32_t slot = 0; slot < kIndexTypes.size(); ++slot)
+        {
+            const uint32_t index = static_cast<uint32_t>(phase) * 2 + slot;
+            command->getVkCommandBuffer()->bindIndexBuffer(indexBuffer, 0, kIndexTypes[slot]);
+            command->getVkCommandBuffer()->drawIndexedIndirectCount(resources.commandBuffer->getVkBuffer(), kCmdSize * mDrawCapacity * index, resources.cullingBuffer->getVkBuffer(), offsetof(CullingParams, drawNum) + sizeof(uint32_t) * index, mDrawCapacity, kCmdSize);
         }
     }
 
@@ -937,9 +1520,27 @@ namespace palm
 
         if (ImGui::BeginMenuBar())
         {
-            // TODO: scene save/load, cut/copy/paste, undo/redo
+            // TODO: cut/copy/paste, undo/redo
             // the architecture of the GUI needs to be fundamentally reconstruct
 
+            if (ImGui::BeginMenu("File"))
+            {
+                if (ImGui::MenuItem("Save Scene", nullptr))
+                {
+                    mSceneSaveBrowser.SetTitle("save scene");
+                    mSceneSaveBrowser.SetTypeFilters({ SceneSerializer::kExtension });
+                    mSceneSaveBrowser.Open();
+                }
+                else if (ImGui::MenuItem("Load Scene", nullptr))
+                {
+                    mSceneLoadBrowser.SetTitle("load scene");
+                    mSceneLoadBrowser.SetTypeFilters({ SceneSerializer::kExtension });
+                    mSceneLoadBrowser.Open();
+                }
+
+                ImGui::EndMenu();
+            }
+
             if (ImGui::BeginMenu("Add"))
             {
                 if (ImGui::BeginMenu("Emitter"))
@@ -971,18 +1572,6 @@ namespace palm
                             transform.params.vel               = glm::vec3(0.f);
                             transform.params.entitySlot        = static_cast<uint32_t>((added & ec2s::kEntitySlotMask) >> ec2s::kEntitySlotShiftWidth);
                             transform.params.entityIndex       = static_cast<uint32_t>(added & ec2s::kEntityIndexMask);
-
-                            const auto frameCount = window->getFrameCount();
-                            const auto size       = sizeof(Transform::Params) * frameCount;
-                            transform.uniformBuffer =
-                                device.create<vk2s::DynamicBuffer>(vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eUniformBuffer), vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, frameCount);
-                            for (int i = 0; i < frameCount; ++i)
-                            {
-                                transform.uniformBuffer->write(&transform.params, sizeof(Transform::Params), i * transform.uniformBuffer->getBlockSize());
-                            }
-
-                            transform.bindGroup = device.create<vk2s::BindGroup>(mGeometryPass.bindLayouts[1].get());
-                            transform.bindGroup->bind(0, vk::DescriptorType::eUniformBufferDynamic, transform.uniformBuffer.get());
                         }
 
                         mPickedEntity = added;
@@ -991,7 +1580,7 @@ namespace palm
                     else if (ImGui::MenuItem("Infinite", nullptr))
                     {
                         mEnvmapBrowser.SetTitle("load environment map image");
-                        mEnvmapBrowser.SetTypeFilters({ ".png", ".jpg" });
+                        mEnvmapBrowser.SetTypeFilters({ ".png", ".jpg", ".hdr" });
                         mEnvmapBrowser.Open();
 
                         if (!mInfiniteEmitterEntity)
@@ -1085,6 +1674,26 @@ namespace palm
                     }
                 });
 
+            // placeholders of the loads in progress
+            for (auto& load : mPendingLoads)
+            {
+                ImGui::PushID(&load);
+
+                const std::string viewing = "[loading]: " + to_string(load.path.filename());
+                ImGui::ProgressBar(load.control->progress, ImVec2(-ImGui::GetFontSize() * 6.f, 0.f), viewing.c_str());
+                ImGui::SameLine();
+                if (load.control->cancelled)
+                {
+                    ImGui::TextUnformatted("cancelling");
+                }
+                else if (ImGui::Button("Cancel"))
+                {
+                    load.control->cancelled = true;
+                }
+
+                ImGui::PopID();
+            }
+
             ImGui::SeparatorText("Information");
             ImGui::Text("device: %s", device.getPhysicalDeviceName().data());
             ImGui::Text("fps: %.3lf", 1. / deltaTime);
@@ -1093,6 +1702,27 @@ namespace palm
             ImGui::Text("pos: (%.3lf, %.3lf, %.3lf)", pos.x, pos.y, pos.z);
             ImGui::Text("lookat: (%.3lf, %.3lf, %.3lf)", lookAt.x, lookAt.y, lookAt.z);
 
+            // cost of writing the scene to the GPU (compare with the full upload to see the time saved)
+            ImGui::Checkbox("Full upload every frame", &mForceFullUpload);
+            ImGui::Text("upload: %.3lf ms (%u instances written)", mUploadTime, mUploadedInstanceNum);
+            ImGui::Text("frame ring: %llu / %llu bytes", static_cast<unsigned long long>(mFrameRing->getPeakSize()), static_cast<unsigned long long>(mFrameRing->getRegionSize()));
+            {
+                constexpr std::array<const char*, static_cast<size_t>(MemoryUsage::eUsageNum)> usageNames = { "device local", "upload", "readback" };
+                for (size_t i = 0; i < usageNames.size(); ++i)
+                {
+                    const auto stats = common()->memoryPool.getStats(static_cast<MemoryUsage>(i));
+                    ImGui::Text("%s pool: %u allocs / %u blocks, %.2lf / %.2lf MiB", usageNames[i], stats.allocationNum, stats.blockNum, stats.usedSize / (1024. * 1024.), stats.reservedSize / (1024. * 1024.));
+                }
+            }
+
+            // results of the GPU culling (a few frames behind)
+            ImGui::Checkbox("Occlusion culling", &mOcclusionCulling);
+            const auto& drawNum = mCullingStats.drawNum;
+            ImGui::Text("instances: %u", mCullingStats.instanceNum);
+            ImGui::Text("frustum culled: %u", mCullingStats.frustumCulledNum);
+            ImGui::Text("occlusion culled: %u", mCullingStats.occlusionCulledNum);
+            ImGui::Text("drawn: %u (early %u, late %u)", drawNum[0] + drawNum[1] + drawNum[2] + drawNum[3], drawNum[0] + drawNum[1], drawNum[2] + drawNum[3]);
+
             // transform editing
             if (mPickedEntity && scene.contains<Transform>(*mPickedEntity))
             {
@@ -1108,41 +1738,86 @@ namespace palm
                 projectionMat[1][1] *= -1.f;
 
                 // position editor (translation)
-                ImGui::InputFloat3("Translate", glm::value_ptr(transform.pos));
+                bool edited = ImGui::InputFloat3("Translate", glm::value_ptr(transform.pos));
                 // rotation editor (Euler angles)
                 glm::vec3 rotInEuler = glm::degrees(glm::eulerAngles(transform.rot));
-                ImGui::InputFloat3("Rotate", glm::value_ptr(rotInEuler));
-                transform.rot = glm::quat(glm::radians(rotInEuler));
+                if (ImGui::InputFloat3("Rotate", glm::value_ptr(rotInEuler)))
+                {
+                    transform.rot = glm::quat(glm::radians(rotInEuler));
+                    edited        = true;
+                }
                 // scale editor
-                ImGui::InputFloat3("Scale", glm::value_ptr(transform.scale));
+                edited |= ImGui::InputFloat3("Scale", glm::value_ptr(transform.scale));
 
                 // update buffer value
-                transform.params.update(transform.pos, transform.rot, transform.scale);
+                if (edited)
+                {
+                    transform.params.update(transform.pos, transform.rot, transform.scale);
+                }
 
                 // manipulate (the entity must not be picked during the operation, so the state is preserved)
                 ImGuizmo::Manipulate(glm::value_ptr(viewMat), glm::value_ptr(projectionMat), mCurrentGizmoOperation, ImGuizmo::WORLD, glm::value_ptr(transform.params.world));
 
-                glm::vec3 translation, rotation, scale;
-                ImGuizmo::DecomposeMatrixToComponents(glm::value_ptr(transform.params.world), glm::value_ptr(translation), glm::value_ptr(rotation), glm::value_ptr(scale));
+                if (ImGuizmo::IsUsing())
+                {
+                    glm::vec3 translation, rotation, scale;
+                    ImGuizmo::DecomposeMatrixToComponents(glm::value_ptr(transform.params.world), glm::value_ptr(translation), glm::value_ptr(rotation), glm::value_ptr(scale));
+
+                    transform.pos   = translation;
+                    transform.rot   = glm::quat(glm::radians(rotation));
+                    transform.scale = scale;
+                    // re-calculate
+                    transform.params.update(transform.pos, transform.rot, transform.scale);
+                    edited = true;
+                }
 
-                transform.pos   = translation;
-                transform.rot   = glm::quat(glm::radians(rotation));
-                transform.scale = scale;
-                // re-calculate
-                transform.params.update(transform.pos, transform.rot, transform.scale);
+                // only the edited entities are written to the GPU
+                if (edited)
+                {
+                    mSceneDelta.transforms.emplace_back(*mPickedEntity);
+                }
+            }
+
+            // instancing (the geometry of the picked entity is shared, not copied)
+            if (mPickedEntity && scene.contains<Mesh>(*mPickedEntity))
+            {
+                ImGui::SeparatorText("Instancing");
+
+                if (ImGui::Button("Duplicate"))
+                {
+                    const auto& transform = scene.get<Transform>(*mPickedEntity);
+                    const auto entities   = instantiate(*mPickedEntity, { transform });
+                    if (!entities.empty())
+                    {
+                        mPickedEntity = entities.front();
+                    }
+                }
+
+                ImGui::InputInt("Count", &mScatterCount);
+                ImGui::InputFloat("Radius", &mScatterRadius);
+                if (ImGui::Button("Scatter"))
+                {
+                    scatter(*mPickedEntity, mScatterCount, mScatterRadius);
+                }
             }
 
             if (mPickedEntity && scene.contains<Material>(*mPickedEntity) && scene.contains<Transform>(*mPickedEntity))
             {  // material
                 ImGui::SeparatorText("Material");
 
-                auto& material      = scene.get<Material>(*mPickedEntity);
-                auto& transform     = scene.get<Transform>(*mPickedEntity);
-                bool enableEmissive = false;
+                auto& material        = scene.get<Material>(*mPickedEntity);
+                auto& transform       = scene.get<Transform>(*mPickedEntity);
+                const auto prevParams = material.params;
+                bool enableEmissive   = false;
 
                 // show material editing UI
                 material.updateAndDrawMaterialUI(enableEmissive);
 
+                if (std::memcmp(&prevParams, &material.params, sizeof(Material::Params)) != 0)
+                {
+                    mSceneDelta.materials.emplace_back(*mPickedEntity);
+                }
+
                 if (enableEmissive)
                 {
                     // add emissive component
@@ -1156,7 +1831,7 @@ namespace palm
 
                     emitter.params.emissive = material.params.emissive;
                     emitter.params.type     = static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eArea);
-                    emitter.params.faceNum  = scene.get<Mesh>(*mPickedEntity).hostMesh.indices.size() / 3;
+                    emitter.params.faceNum  = scene.get<Mesh>(*mPickedEntity).geometry->indexCount / 3;
                 }
                 else if (glm::dot(material.params.emissive, material.params.emissive) == 0. && scene.contains<Emitter>(*mPickedEntity))
                 {
@@ -1215,22 +1890,36 @@ namespace palm
 
         mEnvmapBrowser.Display();
         mMaterialTexBrowser.Display();
+        mSceneSaveBrowser.Display();
+        mSceneLoadBrowser.Display();
 
-        if (mInfiniteEmitterEntity && mEnvmapBrowser.HasSelected())
+        if (mSceneSaveBrowser.HasSelected())
         {
-            const std::string& path = mEnvmapBrowser.GetSelected().string();
-            mEnvmapBrowser.ClearSelected();
+            auto path = mSceneSaveBrowser.GetSelected();
+            mSceneSaveBrowser.ClearSelected();
 
-            auto& emitter       = scene.get<Emitter>(*mInfiniteEmitterEntity);
-            emitter.params.type = static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eInfinite);
-
-            emitter.emissiveTex = device.create<vk2s::Image>(path);
-
-            if (emitter.emissiveTex)
+            if (path.extension() != SceneSerializer::kExtension)
             {
-                mLightingBindGroup->bind(3, vk::DescriptorType::eSampledImage, emitter.emissiveTex);
+                path += SceneSerializer::kExtension;
             }
-            std::cout << "loaded envmap image: " << mEnvmapBrowser.GetSelected().string() << std::endl;
+
+            saveScene(path);
+        }
+
+        if (mSceneLoadBrowser.HasSelected())
+        {
+            const auto path = mSceneLoadBrowser.GetSelected();
+            mSceneLoadBrowser.ClearSelected();
+
+            loadScene(path);
+        }
+
+        if (mInfiniteEmitterEntity && mEnvmapBrowser.HasSelected())
+        {
+            const auto path = mEnvmapBrowser.GetSelected();
+            mEnvmapBrowser.ClearSelected();
+
+            loadEnvmap(path);
         }
 
         ImGui::Render();
@@ -1249,6 +1938,7 @@ namespace palm
 
         std::vector<Handle<vk2s::Image>> images = { mGBuffer.albedoTex, mGBuffer.worldPosTex, mGBuffer.normalTex, mGBuffer.roughnessMetalnessTex };
         mGeometryPass.renderpass->recreateFrameBuffers(images, mGBuffer.depthBuffer);
+        mGeometryLateRenderpass->recreateFrameBuffers(images, mGBuffer.depthBuffer);
 
         mLightingPass.renderpass->recreateFrameBuffers(window.get());
 
@@ -1257,6 +1947,9 @@ namespace palm
         mGBuffer.bindGroup->bind(1, vk::DescriptorType::eSampledImage, mGBuffer.worldPosTex);
         mGBuffer.bindGroup->bind(2, vk::DescriptorType::eSampledImage, mGBuffer.normalTex);
         mGBuffer.bindGroup->bind(3, vk::DescriptorType::eSampledImage, mGBuffer.roughnessMetalnessTex);
+
+        // the Hi-Z pyramid follows the size of the depth buffer
+        createHiZ();
     }
 
     bool Editor::isPointerOnRenderArea() const
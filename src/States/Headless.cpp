@@ -0,0 +1,316 @@
+/*****************************************************************/ /**
+ * @file   Headless.cpp
+ * @brief  source file of Headless class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+#include "../include/States/Headless.hpp"
+
+#include "../include/Integrators/PathIntegrator.hpp"
+#include "../include/Integrators/ReSTIRIntegrator.hpp"
+
+#include "../include/ModelLoader.hpp"
+#include "../include/SceneSerializer.hpp"
+#include "../include/EntityInfo.hpp"
+#include "../include/Emitter.hpp"
+#include "../include/Mesh.hpp"
+#include "../include/UploadBatch.hpp"
+
+#include <stb_image_write.h>
+
+#include <filesystem>
+#include <iostream>
+
+namespace palm
+{
+    void Headless::init()
+    {
+        const auto& settings = *common()->headless;
+
+        initVulkan();
+        if (common()->headlessFailed)
+        {
+            return;
+        }
+
+        // any input that fails to load aborts the rendering
+        loadScene();
+        if (common()->headlessFailed)
+        {
+            return;
+        }
+
+        auto& device = common()->device;
+        auto& scene  = common()->scene;
+
+        if (scene.size<Emitter>() == 0)
+        {
+            fail("the scene has no emitter, specify --envmap or --env-color!");
+            return;
+        }
+
+        // flatten the scene into the GPU resources bound by the integrator
+        common()->gpuScene = std::make_unique<GPUScene>(device, scene, common()->meshPool);
+
+        // select integrator
+        if (settings.integrator == "path")
+        {
+            auto integrator                   = std::make_unique<PathIntegrator>(device, scene, *common()->gpuScene, mOutputImage);
+            integrator->getGUIParamsRef().spp = static_cast<int>(settings.sppPerFrame);
+            mIntegrator                       = std::move(integrator);
+        }
+        else if (settings.integrator == "restir")
+        {
+            auto integrator                   = std::make_unique<ReSTIRIntegrator>(device, scene, *common()->gpuScene, mOutputImage);
+            integrator->getGUIParamsRef().spp = static_cast<int>(settings.sppPerFrame);
+            mIntegrator                       = std::move(integrator);
+        }
+        else
+        {
+            fail("unknown integrator \"" + settings.integrator + "\"");
+            return;
+        }
+
+        std::cout << "headless: rendering " << settings.width << "x" << settings.height << " with " << settings.integrator << " integrator on " << device.getPhysicalDeviceName() << std::endl;
+
+        mAccumulatedSpp = 0;
+        mStartTime      = std::chrono::steady_clock::now();
+        mLastReportTime = 0.;
+    }
+
+    void Headless::update()
+    {
+        const auto& settings = *common()->headless;
+
+        if (!mIntegrator)
+        {
+            exitApplication();
+            return;
+        }
+
+        // update shader resource buffers
+        mIntegrator->updateShaderResources();
+
+        mFence->reset();
+
+        // start writing command
+        mCommand->begin();
+        mIntegrator->sample(mCommand.get());
+        mCommand->end();
+
+        // execute and wait (integrators write shader resources only when GPU is idle)
+        mCommand->execute(mFence);
+        mFence->wait();
+
+        mAccumulatedSpp += settings.sppPerFrame;
+
+        const double elapsed    = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStartTime).count();
+        const bool reachedSpp  = settings.targetSpp != 0 && mAccumulatedSpp >= settings.targetSpp;
+        const bool reachedTime = settings.timeBudget > 0. && elapsed >= settings.timeBudget;
+
+        // report progress at a fixed interval (regardless of the spp per frame)
+        if (elapsed - mLastReportTime >= kProgressInterval)
+        {
+            std::cout << "headless: " << mAccumulatedSpp << " spp (" << elapsed << " s)" << std::endl;
+            mLastReportTime = elapsed;
+        }
+
+        if (reachedSpp || reachedTime)
+        {
+            std::cout << "headless: finished " << mAccumulatedSpp << " spp in " << elapsed << " s" << std::endl;
+            saveImage(settings.outputPath);
+            exitApplication();
+        }
+    }
+
+    Headless::~Headless()
+    {
+        auto& device = getCommonRegion()->device;
+
+        device.waitIdle();
+
+        // integrator must be destroyed before the output image
+        mIntegrator.reset();
+        // and before the scene resources it binds
+        getCommonRegion()->gpuScene.reset();
+    }
+
+    void Headless::initVulkan()
+    {
+        auto& device         = getCommonRegion()->device;
+        const auto& settings = *getCommonRegion()->headless;
+
+        try
+        {
+            mCommand = device.create<vk2s::Command>();
+            mFence   = device.create<vk2s::Fence>();
+
+            // create output image (no swapchain, so the format is fixed)
+            {
+                const auto format   = vk::Format::eR8G8B8A8Unorm;
+                const uint32_t size = settings.width * settings.height * vk2s::Compiler::getSizeOfFormat(format);
+
+                vk::ImageCreateInfo ci;
+                ci.arrayLayers   = 1;
+                ci.extent        = vk::Extent3D(settings.width, settings.height, 1);
+                ci.format        = format;
+                ci.imageType     = vk::ImageType::e2D;
+                ci.mipLevels     = 1;
+                ci.usage         = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eStorage;
+                ci.initialLayout = vk::ImageLayout::eUndefined;
+
+                mOutputImage = device.create<vk2s::Image>(ci, vk::MemoryPropertyFlagBits::eDeviceLocal, size, vk::ImageAspectFlagBits::eColor);
+
+                UniqueHandle<vk2s::Command> cmd = device.create<vk2s::Command>();
+                cmd->begin(true);
+                cmd->transitionImageLayout(mOutputImage.get(), vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+                cmd->end();
+                cmd->execute();
+            }
+
+            // create staging buffer
+            {
+                constexpr vk::Format outputFormat = vk::Format::eR8G8B8A8Unorm;
+                const uint32_t channelSize        = vk2s::Compiler::getSizeOfFormat(outputFormat);
+                const uint32_t size               = settings.width * settings.height * channelSize;
+                mStagingBuffer                    = std::make_unique<PooledBuffer>(device, getCommonRegion()->memoryPool, vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferDst), MemoryUsage::eReadback);
+            }
+        }
+        catch (std::exception& e)
+        {
+            fail(e.what());
+        }
+    }
+
+    void Headless::loadScene()
+    {
+        auto& device         = getCommonRegion()->device;
+        auto& scene          = getCommonRegion()->scene;
+        const auto& settings = *getCommonRegion()->headless;
+
+        try
+        {
+            // scene file
+            if (!settings.scenePath.empty())
+            {
+                SceneSerializer serializer(device, scene, getCommonRegion()->meshPool, getCommonRegion()->textureRegistry);
+                const auto entities = serializer.load(settings.scenePath);
+                std::cout << "headless: loaded " << settings.scenePath.string() << " (" << entities.size() << " entities)" << std::endl;
+            }
+
+            // models
+            ModelLoader loader(device, scene, getCommonRegion()->meshPool, getCommonRegion()->textureRegistry);
+            for (const auto& path : settings.modelPaths)
+            {
+                const auto entities = loader.load(path);
+                std::cout << "headless: loaded " << path.string() << " (" << entities.size() << " meshes)" << std::endl;
+            }
+
+            // infinite emitter
+            if (!settings.envmapPath.empty() || settings.envColor)
+            {
+                const auto entity = scene.create<Emitter, EntityInfo>();
+
+                auto& emitter       = scene.get<Emitter>(entity);
+                emitter.params.type = static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eInfinite);
+                if (!settings.envmapPath.empty())
+                {
+                    // HDR images are kept in float, and the distribution is built from the decoded texels
+                    const auto image = DecodedEnvmap::load(settings.envmapPath);
+                    UploadBatch uploadBatch(device, common()->memoryPool);
+                    emitter.emissiveTex  = uploadBatch.addImage(image.width, image.height, image.format, image.texels.data(), image.texels.size(), vk::ImageLayout::eGeneral);
+                    emitter.distribution = std::make_shared<const EnvmapDistribution>(image.texels.data(), image.format, image.width, image.height);
+                    uploadBatch.submit();
+                }
+                else
+                {
+                    emitter.params.emissive = *settings.envColor;
+                }
+
+                auto& info      = scene.get<EntityInfo>(entity);
+                info.entityID   = entity;
+                info.entityName = std::string("Infinite emitter");
+                info.groupName  = "emitter";
+                info.editable   = true;
+            }
+
+            // camera (the one in the scene file is used if exists, with the aspect of the output image)
+            if (scene.size<vk2s::Camera>() != 0)
+            {
+                scene.each<vk2s::Camera>([&](vk2s::Camera& camera) { camera.setAspect(1. * settings.width / settings.height); });
+            }
+            else
+            {
+                const auto entity = scene.create<vk2s::Camera, EntityInfo>();
+
+                auto& camera = scene.get<vk2s::Camera>(entity);
+                camera       = vk2s::Camera(settings.cameraFOV, 1. * settings.width / settings.height);
+                camera.setPos(settings.cameraPos);
+                camera.setLookAt(settings.cameraLookAt);
+
+                auto& info      = scene.get<EntityInfo>(entity);
+                info.entityID   = entity;
+                info.entityName = "Main Camera";
+                info.groupName  = "Camera";
+                info.editable   = true;
+            }
+        }
+        catch (std::exception& e)
+        {
+            fail(e.what());
+        }
+    }
+
+    void Headless::saveImage(const std::filesystem::path& saveDst)
+    {
+        const auto extent = mOutputImage->getVkExtent();
+
+        const auto copyRegion = vk::BufferImageCopy().setBufferOffset(0).setBufferRowLength(0).setBufferImageHeight(0).setImageSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 }).setImageOffset({ 0, 0, 0 }).setImageExtent(extent);
+
+        mFence->reset();
+        mCommand->begin(true);
+        mCommand->transitionImageLayout(mOutputImage.get(), vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal);
+        mCommand->getVkCommandBuffer()->copyImageToBuffer(mOutputImage->getVkImage().get(), vk::ImageLayout::eTransferSrcOptimal, mStagingBuffer->getVkBuffer(), copyRegion);
+
+        // the readback memory is host-coherent, so making the copy visible to the host needs no invalidate
+        const vk::MemoryBarrier afterCopy(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+        mCommand->getVkCommandBuffer()->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, afterCopy, {}, {});
+
+        mCommand->transitionImageLayout(mOutputImage.get(), vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eGeneral);
+        mCommand->end();
+        mCommand->execute(mFence);
+        mFence->wait();
+
+        std::vector<uint8_t> output(extent.width * extent.height * 3);
+        {
+            const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(mStagingBuffer->getMappedPointer());
+            for (size_t h = 0; h < extent.height; ++h)
+            {
+                for (size_t w = 0; w < extent.width; ++w)
+                {
+                    const size_t index    = h * extent.width + w;
+                    output[index * 3 + 0] = p[index * 4 + 0];
+                    output[index * 3 + 1] = p[index * 4 + 1];
+                    output[index * 3 + 2] = p[index * 4 + 2];
+                }
+            }
+        }
+
+        const int res = stbi_write_png(saveDst.string<char>().c_str(), extent.width, extent.height, 3, output.data(), extent.width * 3);
+        if (res == 0)
+        {
+            fail("failed to output to " + saveDst.string());
+            return;
+        }
+
+        std::cout << "headless: saved rendered image to: " << saveDst.string() << std::endl;
+    }
+
+    void Headless::fail(const std::string& message)
+    {
+        std::cerr << "headless: " << message << "\n";
+        getCommonRegion()->headlessFailed = true;
+    }
+
+}  // namespace palm
@@ -10,6 +10,12 @@
 #include "../include/Integrators/PathIntegrator.hpp"
 #include "../include/Integrators/ReSTIRIntegrator.hpp"
 
+#include "../include/EntityInfo.hpp"
+#include "../include/Transform.hpp"
+#include "../include/Material.hpp"
+#include "../include/Emitter.hpp"
+#include "../include/Mesh.hpp"
+
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 #include <ImGuizmo.h>
@@ -17,6 +23,7 @@
 
 #include <stb_image_write.h>
 
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 
@@ -24,6 +31,9 @@ namespace palm
 {
     void Renderer::init()
     {
+        // the scene may have been edited in the Editor, so it is flattened again when the first integrator is created
+        common()->gpuScene.reset();
+
         initVulkan();
         mFileBrowser = ImGui::FileBrowser(ImGuiFileBrowserFlags_EnterNewFilename | ImGuiFileBrowserFlags_CreateNewDir | ImGuiFileBrowserFlags_ConfirmOnEnter | ImGuiFileBrowserFlags_SkipItemsCausingError);
 
@@ -229,7 +239,7 @@ namespace palm
                 constexpr vk::Format outputFormat = vk::Format::eR8G8B8A8Unorm;
                 const uint32_t channelSize        = vk2s::Compiler::getSizeOfFormat(outputFormat);
                 const uint32_t size               = windowWidth * windowHeight * channelSize;
-                mStagingBuffer                    = device.create<vk2s::Buffer>(vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferDst), vk::MemoryPropertyFlagBits::eHostVisible);
+                mStagingBuffer                    = std::make_unique<PooledBuffer>(device, getCommonRegion()->memoryPool, vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferDst), MemoryUsage::eReadback);
             }
         }
         catch (std::exception& e)
@@ -240,9 +250,7 @@ namespace palm
 
     void Renderer::updateAndRenderImGui(const double deltaTime)
     {
-        auto& device = common()->device;
         auto& window = common()->window;
-        auto& scene  = common()->scene;
 
         const auto [windowWidth, windowHeight] = window->getWindowSize();
 
@@ -287,15 +295,15 @@ namespace palm
         ImGui::End();
 
         ImGui::Begin("Select Integrator");
-        if (ImGui::Selectable("path"))
+        if (ImGui::Selectable("path", mIntegratorName == "path") && mIntegratorName != "path")
         {
             // set integrator
-            mIntegrator = std::make_unique<PathIntegrator>(device, scene, mOutputImage);
+            createIntegrator("path");
         }
-        if (ImGui::Selectable("ReSTIR"))
+        if (ImGui::Selectable("ReSTIR", mIntegratorName == "ReSTIR") && mIntegratorName != "ReSTIR")
         {
             // set integrator
-            mIntegrator = std::make_unique<ReSTIRIntegrator>(device, scene, mOutputImage);
+            createIntegrator("ReSTIR");
         }
 
         if (mIntegrator)
@@ -306,6 +314,8 @@ namespace palm
 
         ImGui::End();
 
+        updateAndRenderSceneImGui();
+
         mFileBrowser.Display();
 
         if (mFileBrowser.HasSelected())
@@ -319,14 +329,143 @@ namespace palm
         ImGui::Render();
     }
 
+    void Renderer::updateAndRenderSceneImGui()
+    {
+        auto& scene = common()->scene;
+
+        ImGui::Begin("Scene");
+
+        scene.each<EntityInfo>(
+            [&](ec2s::Entity entity, EntityInfo& info)
+            {
+                std::string viewing = "[" + std::to_string(entity & ec2s::kEntityIndexMask) + "]: " + info.groupName + "/" + info.entityName;
+                const bool picked   = mPickedEntity && entity == *mPickedEntity;
+
+                if (ImGui::Selectable(viewing.c_str(), picked) && info.editable)
+                {
+                    mPickedEntity = entity;
+                }
+            });
+
+        if (mPickedEntity && scene.contains<Transform>(*mPickedEntity))
+        {
+            ImGui::SeparatorText("Transform");
+
+            auto& transform = scene.get<Transform>(*mPickedEntity);
+
+            bool edited = false;
+            edited |= ImGui::DragFloat3("Translate", glm::value_ptr(transform.pos), 0.01f);
+            glm::vec3 rotInEuler = glm::degrees(glm::eulerAngles(transform.rot));
+            if (ImGui::DragFloat3("Rotate", glm::value_ptr(rotInEuler), 0.5f))
+            {
+                transform.rot = glm::quat(glm::radians(rotInEuler));
+                edited        = true;
+            }
+            edited |= ImGui::DragFloat3("Scale", glm::value_ptr(transform.scale), 0.01f);
+
+            if (edited)
+            {
+                transform.params.update(transform.pos, transform.rot, transform.scale);
+                mSceneDelta.transforms.emplace_back(*mPickedEntity);
+            }
+        }
+
+        if (mPickedEntity && scene.contains<Material>(*mPickedEntity))
+        {
+            ImGui::SeparatorText("Material");
+
+            auto& material        = scene.get<Material>(*mPickedEntity);
+            const auto prevParams = material.params;
+            bool enableEmissive   = false;
+
+            material.updateAndDrawMaterialUI(enableEmissive);
+
+            if (std::memcmp(&prevParams, &material.params, sizeof(Material::Params)) != 0)
+            {
+                mSceneDelta.materials.emplace_back(*mPickedEntity);
+
+                if (enableEmissive && !scene.contains<Emitter>(*mPickedEntity) && scene.contains<Mesh>(*mPickedEntity))
+                {
+                    // new area emitter (the integrator is rebuilt because the number of emitters changes)
+                    scene.add<Emitter>(*mPickedEntity);
+
+                    auto& emitter          = scene.get<Emitter>(*mPickedEntity);
+                    emitter.attachedEntity = *mPickedEntity;
+                    emitter.params.type    = static_cast<std::underlying_type_t<Emitter::Type>>(Emitter::Type::eArea);
+                    emitter.params.faceNum = scene.get<Mesh>(*mPickedEntity).geometry->indexCount / 3;
+                }
+
+                if (scene.contains<Emitter>(*mPickedEntity))
+                {
+                    scene.get<Emitter>(*mPickedEntity).params.emissive = material.params.emissive;
+                    mSceneDelta.emitters.emplace_back(*mPickedEntity);
+                }
+            }
+        }
+        else if (mPickedEntity && scene.contains<Emitter>(*mPickedEntity))
+        {
+            ImGui::SeparatorText("Emitter");
+
+            auto& emitter = scene.get<Emitter>(*mPickedEntity);
+            if (ImGui::ColorEdit3("Emissive", glm::value_ptr(emitter.params.emissive), ImGuiColorEditFlags_Float | ImGuiColorEditFlags_HDR))
+            {
+                mSceneDelta.emitters.emplace_back(*mPickedEntity);
+            }
+        }
+
+        ImGui::End();
+    }
+
     void Renderer::updateShaderResources()
     {
+        auto& device = common()->device;
+
+        if (mIntegrator && !mSceneDelta.empty())
+        {
+            // the TLAS instances are written by the host and shared by all frames in flight
+            device.waitIdle();
+
+            if (!mIntegrator->applySceneDelta(mSceneDelta))
+            {
+                // the structure of the scene has changed, flatten it again and rebuild
+                mIntegrator.reset();
+                common()->gpuScene.reset();
+                createIntegrator(mIntegratorName);
+            }
+        }
+        mSceneDelta.clear();
+
         if (mIntegrator)
         {
             mIntegrator->updateShaderResources();
         }
     }
 
+    void Renderer::createIntegrator(const std::string& name)
+    {
+        auto& device = common()->device;
+        auto& scene  = common()->scene;
+
+        // the previous integrator binds the resources of the GPUScene
+        mIntegrator.reset();
+
+        // integrators share the flattened scene, so switching them uploads nothing
+        if (!common()->gpuScene)
+        {
+            common()->gpuScene = std::make_unique<GPUScene>(device, scene, common()->meshPool);
+        }
+
+        if (name == "path")
+        {
+            mIntegrator = std::make_unique<PathIntegrator>(device, scene, *common()->gpuScene, mOutputImage);
+        }
+        else if (name == "ReSTIR")
+        {
+            mIntegrator = std::make_unique<ReSTIRIntegrator>(device, scene, *common()->gpuScene, mOutputImage);
+        }
+        mIntegratorName = name;
+    }
+
     void Renderer::onResized()
     {
         auto& device = getCommonRegion()->device;
@@ -341,17 +480,14 @@ namespace palm
     {
         auto& device = getCommonRegion()->device;
 
-        const auto extent                 = mOutputImage->getVkExtent();
-        constexpr vk::Format outputFormat = vk::Format::eR8G8B8A8Unorm;
-        const uint32_t channelSize        = vk2s::Compiler::getSizeOfFormat(outputFormat);
-        const uint32_t size               = extent.width * extent.height * channelSize;
+        const auto extent = mOutputImage->getVkExtent();
 
         const auto copyRegion = vk::BufferImageCopy().setBufferOffset(0).setBufferRowLength(0).setBufferImageHeight(0).setImageSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 }).setImageOffset({ 0, 0, 0 }).setImageExtent(extent);
 
         UniqueHandle<vk2s::Command> cmd = device.create<vk2s::Command>();
         cmd->begin(true);
         cmd->transitionImageLayout(mOutputImage.get(), vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal);
-        cmd->copyImageToBuffer(mOutputImage.get(), mStagingBuffer.get(), copyRegion);
+        cmd->getVkCommandBuffer()->copyImageToBuffer(mOutputImage->getVkImage().get(), vk::ImageLayout::eTransferSrcOptimal, mStagingBuffer->getVkBuffer(), copyRegion);
         cmd->transitionImageLayout(mOutputImage.get(), vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eGeneral);
         cmd->end();
         cmd->execute();
@@ -360,7 +496,8 @@ namespace palm
 
         std::vector<uint8_t> output(extent.width * extent.height * 3);
         {
-            std::uint8_t* p = reinterpret_cast<std::uint8_t*>(device.getVkDevice()->mapMemory(mStagingBuffer->getVkDeviceMemory().get(), 0, size));
+            // the readback memory is coherent, so the copy is visible without an invalidate
+            const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(mStagingBuffer->getMappedPointer());
             for (size_t h = 0; h < extent.height; ++h)
             {
                 for (size_t w = 0; w < extent.width; ++w)
@@ -371,8 +508,6 @@ namespace palm
                     output[index * 3 + 2] = p[index * 4 + 2];
                 }
             }
-
-            device.getVkDevice()->unmapMemory(mStagingBuffer->getVkDeviceMemory().get());
         }
 
         const int res = stbi_write_png(saveDst.string<char>().c_str(), extent.width, extent.height, 3, output.data(), extent.width * 3);
@@ -0,0 +1,150 @@
+/*****************************************************************/ /**
+ * @file   TLAS.cpp
+ * @brief  source file of TLAS class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/TLAS.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace palm
+{
+    namespace
+    {
+        // alignment of scratch addresses (covers minAccelerationStructureScratchOffsetAlignment of current devices)
+        constexpr vk::DeviceSize kScratchAlignment = 256;
+
+        constexpr vk::DeviceAddress alignUp(const vk::DeviceAddress value, const vk::DeviceSize alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }  // namespace
+
+    TLAS::TLAS(vk2s::Device& device, DeviceMemoryPool& memoryPool, const std::vector<vk::AccelerationStructureInstanceKHR>& instances)
+        : mDevice(device)
+        , mInstanceNum(static_cast<uint32_t>(instances.size()))
+    {
+        auto& vkDevice = device.getVkDevice();
+
+        {  // instance buffer
+            const auto size  = sizeof(vk::AccelerationStructureInstanceKHR) * std::max(mInstanceNum, 1u);
+            const auto usage = vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+            mInstanceBuffer  = std::make_unique<PooledBuffer>(device, memoryPool, vk::BufferCreateInfo({}, size, usage), MemoryUsage::eUpload);
+            if (!instances.empty())
+            {
+                std::memcpy(mInstanceBuffer->getMappedPointer(), instances.data(), sizeof(vk::AccelerationStructureInstanceKHR) * instances.size());
+            }
+        }
+
+        vk::AccelerationStructureGeometryInstancesDataKHR instancesData;
+        instancesData.arrayOfPointers    = false;
+        instancesData.data.deviceAddress = mInstanceBuffer->getDeviceAddress();
+        mGeometry                        = vk::AccelerationStructureGeometryKHR(vk::GeometryTypeKHR::eInstances, instancesData, vk::GeometryFlagBitsKHR::eOpaque);
+
+        auto buildInfo      = makeBuildInfo(vk::BuildAccelerationStructureModeKHR::eBuild);
+        const auto sizeInfo = vkDevice->getAccelerationStructureBuildSizesKHR(vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfo, mInstanceNum);
+
+        {  // storage and scratch
+            const auto storageUsage = vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+            mStorageBuffer          = std::make_unique<PooledBuffer>(device, memoryPool, vk::BufferCreateInfo({}, sizeInfo.accelerationStructureSize, storageUsage), MemoryUsage::eDeviceLocal);
+
+            const auto scratchSize  = std::max(sizeInfo.buildScratchSize, sizeInfo.updateScratchSize) + kScratchAlignment;
+            const auto scratchUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+            mScratchBuffer          = std::make_unique<PooledBuffer>(device, memoryPool, vk::BufferCreateInfo({}, scratchSize, scratchUsage), MemoryUsage::eDeviceLocal);
+        }
+
+        const vk::AccelerationStructureCreateInfoKHR ci({}, mStorageBuffer->getVkBuffer(), 0, sizeInfo.accelerationStructureSize, vk::AccelerationStructureTypeKHR::eTopLevel);
+        mAccelerationStructure = vkDevice->createAccelerationStructureKHR(ci);
+
+        // build
+        buildInfo.dstAccelerationStructure  = mAccelerationStructure;
+        buildInfo.scratchData.deviceAddress = alignUp(mScratchBuffer->getDeviceAddress(), kScratchAlignment);
+        const vk::AccelerationStructureBuildRangeInfoKHR range(mInstanceNum, 0, 0, 0);
+
+        UniqueHandle<vk2s::Fence> fence = device.create<vk2s::Fence>();
+        fence->reset();
+        UniqueHandle<vk2s::Command> cmd = device.create<vk2s::Command>();
+        cmd->begin(true);
+        cmd->getVkCommandBuffer()->buildAccelerationStructuresKHR(buildInfo, &range);
+        cmd->end();
+        cmd->execute(fence);
+        fence->wait();
+    }
+
+    TLAS::~TLAS()
+    {
+        mDevice.getVkDevice()->destroyAccelerationStructureKHR(mAccelerationStructure);
+    }
+
+    void TLAS::setInstanceTransform(const uint32_t index, const vk::TransformMatrixKHR& transform)
+    {
+        if (index >= mInstanceNum)
+        {
+            return;
+        }
+
+        // only the transform of the instance is rewritten (the buffer is persistently mapped)
+        const auto offset = sizeof(vk::AccelerationStructureInstanceKHR) * index + offsetof(VkAccelerationStructureInstanceKHR, transform);
+        std::memcpy(static_cast<std::uint8_t*>(mInstanceBuffer->getMappedPointer()) + offset, &transform, sizeof(vk::TransformMatrixKHR));
+
+        mDirty = true;
+    }
+
+    void TLAS::recordUpdate(Handle<vk2s::Command> command)
+    {
+        if (!mDirty)
+        {
+            return;
+        }
+
+        auto& commandBuffer = command->getVkCommandBuffer();
+
+        // wait for the ray tracing of the previous frames reading the TLAS
+        const vk::MemoryBarrier before(vk::AccessFlagBits::eAccelerationStructureReadKHR, vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+        commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, {}, before, {}, {});
+
+        auto buildInfo                      = makeBuildInfo(vk::BuildAccelerationStructureModeKHR::eUpdate);
+        buildInfo.srcAccelerationStructure  = mAccelerationStructure;
+        buildInfo.dstAccelerationStructure  = mAccelerationStructure;
+        buildInfo.scratchData.deviceAddress = alignUp(mScratchBuffer->getDeviceAddress(), kScratchAlignment);
+        const vk::AccelerationStructureBuildRangeInfoKHR range(mInstanceNum, 0, 0, 0);
+        commandBuffer->buildAccelerationStructuresKHR(buildInfo, &range);
+
+        const vk::MemoryBarrier after(vk::AccessFlagBits::eAccelerationStructureWriteKHR, vk::AccessFlagBits::eAccelerationStructureReadKHR);
+        commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, vk::PipelineStageFlagBits::eRayTracingShaderKHR, {}, after, {}, {});
+
+        mDirty = false;
+    }
+
+    void TLAS::bind(Handle<vk2s::BindGroup> bindGroup, const uint32_t binding) const
+    {
+        const vk::WriteDescriptorSetAccelerationStructureKHR asInfo(mAccelerationStructure);
+
+        vk::WriteDescriptorSet write;
+        write.dstSet          = bindGroup->getVkDescriptorSet().get();
+        write.dstBinding      = binding;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+        write.descriptorType  = vk::DescriptorType::eAccelerationStructureKHR;
+        write.pNext           = &asInfo;
+
+        mDevice.getVkDevice()->updateDescriptorSets(write, {});
+    }
+
+    vk::AccelerationStructureBuildGeometryInfoKHR TLAS::makeBuildInfo(const vk::BuildAccelerationStructureModeKHR mode) const
+    {
+        vk::AccelerationStructureBuildGeometryInfoKHR buildInfo;
+        buildInfo.type          = vk::AccelerationStructureTypeKHR::eTopLevel;
+        buildInfo.flags         = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace | vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate;
+        buildInfo.mode          = mode;
+        buildInfo.geometryCount = 1;
+        buildInfo.pGeometries   = &mGeometry;
+
+        return buildInfo;
+    }
+}  // namespace palm
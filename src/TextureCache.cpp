@@ -0,0 +1,532 @@
+/*****************************************************************/ /**
+ * @file   TextureCache.cpp
+ * @brief  source file of TextureCache and CompressedTexture classes
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/TextureCache.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+
+namespace palm
+{
+    namespace
+    {
+        // FNV-1a
+        constexpr uint64_t kFNVOffsetBasis = 0xcbf29ce484222325ull;
+        constexpr uint64_t kFNVPrime       = 0x100000001b3ull;
+
+        uint64_t hashBytes(const void* data, size_t size, uint64_t hash = kFNVOffsetBasis)
+        {
+            const auto* p = reinterpret_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash = (hash ^ p[i]) * kFNVPrime;
+            }
+
+            return hash;
+        }
+
+        constexpr size_t align16(const size_t offset)
+        {
+            return (offset + 15) & ~size_t(15);
+        }
+
+        uint32_t getBlockSize(const vk::Format format)
+        {
+            return format == vk::Format::eBc4UnormBlock ? 8 : 16;
+        }
+
+        // writes bits from the LSB of the block (the bit order of BC formats)
+        struct BitWriter
+        {
+            uint8_t* p;
+            uint32_t pos = 0;
+
+            void put(const uint32_t value, const uint32_t bitNum)
+            {
+                for (uint32_t i = 0; i < bitNum; ++i, ++pos)
+                {
+                    if ((value >> i) & 1)
+                    {
+                        p[pos >> 3] |= static_cast<uint8_t>(1 << (pos & 7));
+                    }
+                }
+            }
+        };
+
+        // BC4 block of 16 values (8 bytes), endpoints are the range of the values in the 8 level mode
+        void encodeBC4Block(const std::array<uint8_t, 16>& values, uint8_t* pDst)
+        {
+            const auto [lo, hi] = std::minmax_element(values.begin(), values.end());
+
+            std::memset(pDst, 0, 8);
+            pDst[0] = *hi;
+            pDst[1] = *lo;
+            if (*hi == *lo)
+            {
+                return;
+            }
+
+            // index 0 is hi, 1 is lo and 2..7 are interpolated from hi to lo
+            BitWriter writer{ pDst + 2 };
+            const float scale = 7.f / static_cast<float>(*hi - *lo);
+            for (const auto value : values)
+            {
+                const int32_t step = static_cast<int32_t>(std::lround((value - *lo) * scale));
+                writer.put(step == 7 ? 0 : step == 0 ? 1 : 8 - step, 3);
+            }
+        }
+
+        // BC7 block of 16 RGBA pixels (16 bytes) in mode 6 (one subset, 7 bit endpoints with p-bits, 4 bit indices)
+        void encodeBC7Block(const std::array<std::array<uint8_t, 4>, 16>& pixels, uint8_t* pDst)
+        {
+            constexpr std::array<int32_t, 16> kWeights = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+            // principal axis of the pixels (power iteration on the covariance)
+            std::array<float, 4> mean{};
+            for (const auto& pixel : pixels)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    mean[c] += pixel[c] / 16.f;
+                }
+            }
+
+            std::array<std::array<float, 4>, 4> covariance{};
+            for (const auto& pixel : pixels)
+            {
+                for (int r = 0; r < 4; ++r)
+                {
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        covariance[r][c] += (pixel[r] - mean[r]) * (pixel[c] - mean[c]);
+                    }
+                }
+            }
+
+            std::array<float, 4> axis = { 1.f, 1.f, 1.f, 1.f };
+            for (int iteration = 0; iteration < 8; ++iteration)
+            {
+                std::array<float, 4> next{};
+                for (int r = 0; r < 4; ++r)
+                {
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        next[r] += covariance[r][c] * axis[c];
+                    }
+                }
+
+                const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+                if (length < 1e-6f)
+                {
+                    break;  // flat block, the endpoints collapse to the mean
+                }
+                for (int c = 0; c < 4; ++c)
+                {
+                    axis[c] = next[c] / length;
+                }
+            }
+
+            float tMin = 0.f, tMax = 0.f;
+            for (const auto& pixel : pixels)
+            {
+                float t = 0.f;
+                for (int c = 0; c < 4; ++c)
+                {
+                    t += (pixel[c] - mean[c]) * axis[c];
+                }
+                tMin = std::min(tMin, t);
+                tMax = std::max(tMax, t);
+            }
+
+            // quantize the endpoints to 7 bits + a p-bit shared by the channels
+            std::array<std::array<int32_t, 4>, 2> quantized{};
+            std::array<int32_t, 2> pBits{};
+            for (int e = 0; e < 2; ++e)
+            {
+                const float t = e == 0 ? tMin : tMax;
+
+                float bestError = std::numeric_limits<float>::max();
+                for (int32_t p = 0; p < 2; ++p)
+                {
+                    std::array<int32_t, 4> q{};
+                    float error = 0.f;
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        const float value = std::clamp(mean[c] + axis[c] * t, 0.f, 255.f);
+                        q[c]              = std::clamp(static_cast<int32_t>(std::lround((value - p) / 2.f)), 0, 127);
+                        const float diff  = static_cast<float>(q[c] * 2 + p) - value;
+                        error += diff * diff;
+                    }
+
+                    if (error < bestError)
+                    {
+                        bestError    = error;
+                        quantized[e] = q;
+                        pBits[e]     = p;
+                    }
+                }
+            }
+
+            // palette and nearest indices
+            std::array<std::array<int32_t, 4>, 16> palette{};
+            for (int i = 0; i < 16; ++i)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    const int32_t e0 = quantized[0][c] * 2 + pBits[0];
+                    const int32_t e1 = quantized[1][c] * 2 + pBits[1];
+                    palette[i][c]    = ((64 - kWeights[i]) * e0 + kWeights[i] * e1 + 32) >> 6;
+                }
+            }
+
+            std::array<uint32_t, 16> indices{};
+            for (int i = 0; i < 16; ++i)
+            {
+                int32_t bestError = std::numeric_limits<int32_t>::max();
+                for (uint32_t j = 0; j < 16; ++j)
+                {
+                    int32_t error = 0;
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        const int32_t diff = palette[j][c] - pixels[i][c];
+                        error += diff * diff;
+                    }
+
+                    if (error < bestError)
+                    {
+                        bestError  = error;
+                        indices[i] = j;
+                    }
+                }
+            }
+
+            // the MSB of the anchor index is implicit 0, so the endpoints are swapped if needed
+            if (indices[0] & 8)
+            {
+                std::swap(quantized[0], quantized[1]);
+                std::swap(pBits[0], pBits[1]);
+                for (auto& index : indices)
+                {
+                    index = 15 - index;
+                }
+            }
+
+            std::memset(pDst, 0, 16);
+            BitWriter writer{ pDst };
+            writer.put(1 << 6, 7);  // mode 6
+            for (int c = 0; c < 4; ++c)
+            {
+                writer.put(quantized[0][c], 7);
+                writer.put(quantized[1][c], 7);
+            }
+            writer.put(pBits[0], 1);
+            writer.put(pBits[1], 1);
+            writer.put(indices[0], 3);
+            for (int i = 1; i < 16; ++i)
+            {
+                writer.put(indices[i], 4);
+            }
+        }
+
+        // encode one level of R8G8B8A8 texels into blocks (edge blocks repeat the last row and column)
+        void encodeLevel(const uint8_t* pTexels, const uint32_t width, const uint32_t height, const TextureUsage usage, uint8_t* pDst)
+        {
+            const uint32_t blockWidth  = (width + 3) / 4;
+            const uint32_t blockHeight = (height + 3) / 4;
+            const uint32_t blockSize   = getBlockSize(TextureCache::getFormat(usage));
+
+#pragma omp parallel for schedule(dynamic)
+            for (int by = 0; by < static_cast<int>(blockHeight); ++by)  // int for OpenMP
+            {
+                for (uint32_t bx = 0; bx < blockWidth; ++bx)
+                {
+                    std::array<std::array<uint8_t, 4>, 16> pixels;
+                    for (uint32_t i = 0; i < 16; ++i)
+                    {
+                        const uint32_t x = std::min(bx * 4 + i % 4, width - 1);
+                        const uint32_t y = std::min(by * 4 + i / 4, height - 1);
+                        std::memcpy(pixels[i].data(), pTexels + (static_cast<size_t>(y) * width + x) * 4, 4);
+                    }
+
+                    uint8_t* pBlock = pDst + (static_cast<size_t>(by) * blockWidth + bx) * blockSize;
+                    switch (usage)
+                    {
+                    case TextureUsage::eAlbedo:
+                    case TextureUsage::eORM:
+                        encodeBC7Block(pixels, pBlock);
+                        break;
+                    case TextureUsage::eNormalMap:
+                    {
+                        std::array<uint8_t, 16> x, y;
+                        for (uint32_t i = 0; i < 16; ++i)
+                        {
+                            x[i] = pixels[i][0];
+                            y[i] = pixels[i][1];
+                        }
+                        encodeBC4Block(x, pBlock);
+                        encodeBC4Block(y, pBlock + 8);
+                        break;
+                    }
+                    }
+                }
+            }
+        }
+
+        // 2x2 box filter (an odd last row or column is dropped)
+        std::vector<uint8_t> downsample(const uint8_t* pTexels, const uint32_t width, const uint32_t height)
+        {
+            const uint32_t nextWidth  = std::max(width / 2, 1u);
+            const uint32_t nextHeight = std::max(height / 2, 1u);
+            std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+#pragma omp parallel for
+            for (int y = 0; y < static_cast<int>(nextHeight); ++y)  // int for OpenMP
+            {
+                const uint32_t y0 = std::min(y * 2u, height - 1);
+                const uint32_t y1 = std::min(y * 2u + 1, height - 1);
+                for (uint32_t x = 0; x < nextWidth; ++x)
+                {
+                    const uint32_t x0 = std::min(x * 2, width - 1);
+                    const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+                    for (uint32_t c = 0; c < 4; ++c)
+                    {
+                        const auto texel = [&](const uint32_t tx, const uint32_t ty) { return static_cast<uint32_t>(pTexels[(static_cast<size_t>(ty) * width + tx) * 4 + c]); };
+
+                        next[(static_cast<size_t>(y) * nextWidth + x) * 4 + c] = static_cast<uint8_t>((texel(x0, y0) + texel(x1, y0) + texel(x0, y1) + texel(x1, y1) + 2) / 4);
+                    }
+                }
+            }
+
+            return next;
+        }
+    }  // namespace
+
+    CompressedTexture::CompressedTexture(MappedFile&& file)
+        : mFile(std::move(file))
+        , mData(mFile.data(), mFile.size())
+    {
+    }
+
+    CompressedTexture::CompressedTexture(std::vector<std::byte>&& data)
+        : mMemory(std::move(data))
+        , mData(mMemory.data(), mMemory.size())
+    {
+    }
+
+    bool CompressedTexture::isValid(const uint64_t key) const
+    {
+        if (mData.size() < sizeof(Header))
+        {
+            return false;
+        }
+
+        const auto& header = getHeader();
+        if (header.magic != TextureCache::kMagic || header.version != TextureCache::kVersion || header.key != key || header.fileSize != mData.size())
+        {
+            return false;
+        }
+
+        if (header.width == 0 || header.height == 0 || header.mipLevels != static_cast<uint32_t>(std::bit_width(std::max(header.width, header.height))))
+        {
+            return false;
+        }
+
+        return sizeof(Header) + getTexelSize() <= mData.size();
+    }
+
+    const CompressedTexture::Header& CompressedTexture::getHeader() const
+    {
+        return *reinterpret_cast<const Header*>(mData.data());
+    }
+
+    vk::Format CompressedTexture::getFormat() const
+    {
+        return static_cast<vk::Format>(getHeader().format);
+    }
+
+    const uint8_t* CompressedTexture::getTexels() const
+    {
+        return reinterpret_cast<const uint8_t*>(mData.data() + sizeof(Header));
+    }
+
+    size_t CompressedTexture::getTexelSize() const
+    {
+        size_t size = 0;
+        for (const auto levelSize : getLevelSizes())
+        {
+            size += levelSize;
+        }
+
+        return size;
+    }
+
+    std::vector<size_t> CompressedTexture::getLevelSizes() const
+    {
+        const auto& header = getHeader();
+
+        std::vector<size_t> sizes(header.mipLevels);
+        for (uint32_t level = 0; level < header.mipLevels; ++level)
+        {
+            sizes[level] = getLevelSize(getFormat(), header.width, header.height, level);
+        }
+
+        return sizes;
+    }
+
+    size_t CompressedTexture::getLevelSize(const vk::Format format, const uint32_t width, const uint32_t height, const uint32_t level)
+    {
+        const size_t levelWidth  = std::max(width >> level, 1u);
+        const size_t levelHeight = std::max(height >> level, 1u);
+
+        return ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * getBlockSize(format);
+    }
+
+    bool CompressedTexture::isCompressedFormat(const vk::Format format)
+    {
+        return format == vk::Format::eBc7UnormBlock || format == vk::Format::eBc5UnormBlock || format == vk::Format::eBc4UnormBlock;
+    }
+
+    TextureCache::TextureCache(const std::filesystem::path& directory)
+        : mDirectory(directory)
+    {
+    }
+
+    CompressedTexture TextureCache::acquire(const uint8_t* pTexels, const uint32_t width, const uint32_t height, const TextureUsage usage)
+    {
+        return acquire(computeKey(pTexels, width, height, usage), pTexels, width, height, usage);
+    }
+
+    CompressedTexture TextureCache::acquire(const uint64_t key, const uint8_t* pTexels, const uint32_t width, const uint32_t height, const TextureUsage usage)
+    {
+        char keyStr[17];
+        std::snprintf(keyStr, sizeof(keyStr), "%016llx", static_cast<unsigned long long>(key));
+        const auto cachePath = mDirectory / (std::string(keyStr) + kExtension);
+
+        // cache hit
+        if (std::filesystem::exists(cachePath))
+        {
+            try
+            {
+                CompressedTexture cached(MappedFile{ cachePath });
+                if (cached.isValid(key))
+                {
+                    return cached;
+                }
+            }
+            catch (std::exception& e)
+            {
+                std::cerr << e.what() << "\n";
+            }
+
+            std::cerr << "invalid texture cache, encoding again: " << cachePath.string() << "\n";
+        }
+
+        // cache miss
+        auto compiled = compile(pTexels, width, height, usage, key);
+
+        // write to a temporary file first, not to leave a broken cache file
+        std::error_code ec;
+        std::filesystem::create_directories(mDirectory, ec);
+        // (named per thread, since concurrent loads may write the same entry)
+        const auto tmpPath = std::filesystem::path(cachePath).concat("." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp");
+        {
+            std::ofstream ofs(tmpPath, std::ios::binary);
+            ofs.write(reinterpret_cast<const char*>(compiled.data()), compiled.size());
+        }
+        std::filesystem::rename(tmpPath, cachePath, ec);
+        if (ec)
+        {
+            std::cerr << "failed to write texture cache (" << ec.message() << "): " << cachePath.string() << "\n";
+            std::filesystem::remove(tmpPath, ec);
+        }
+
+        return CompressedTexture(std::move(compiled));
+    }
+
+    uint64_t TextureCache::computeKey(const uint8_t* pTexels, const uint32_t width, const uint32_t height, const TextureUsage usage)
+    {
+        uint64_t hash = hashBytes(pTexels, static_cast<size_t>(width) * height * 4);
+
+        // encoding options (the encoded result depends on these)
+        const uint32_t options[] = { kVersion, width, height, static_cast<uint32_t>(usage) };
+        hash                     = hashBytes(options, sizeof(options), hash);
+
+        return hash;
+    }
+
+    vk::Format TextureCache::getFormat(const TextureUsage usage)
+    {
+        switch (usage)
+        {
+        case TextureUsage::eAlbedo:
+        case TextureUsage::eORM:
+            return vk::Format::eBc7UnormBlock;
+        case TextureUsage::eNormalMap:
+            return vk::Format::eBc5UnormBlock;
+        }
+
+        return vk::Format::eUndefined;
+    }
+
+    std::vector<std::byte> TextureCache::compile(const uint8_t* pTexels, const uint32_t width, const uint32_t height, const TextureUsage usage, const uint64_t key)
+    {
+        // layout : header | level 0 | level 1 | ...
+        CompressedTexture::Header header{};
+        header.magic     = kMagic;
+        header.version   = kVersion;
+        header.key       = key;
+        header.format    = static_cast<uint32_t>(getFormat(usage));
+        header.width     = width;
+        header.height    = height;
+        header.mipLevels = static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+
+        std::vector<size_t> levelOffsets(header.mipLevels);
+        size_t offset = sizeof(CompressedTexture::Header);
+        for (uint32_t level = 0; level < header.mipLevels; ++level)
+        {
+            levelOffsets[level] = offset;
+            offset += CompressedTexture::getLevelSize(getFormat(usage), width, height, level);
+        }
+
+        header.fileSize = align16(offset);
+
+        std::vector<std::byte> data(header.fileSize);
+        std::memcpy(data.data(), &header, sizeof(header));
+
+        // level 0 is encoded from the source, and each next level is filtered from the previous one
+        std::vector<uint8_t> levelTexels;
+        const uint8_t* pLevel = pTexels;
+        uint32_t levelWidth   = width;
+        uint32_t levelHeight  = height;
+        for (uint32_t level = 0; level < header.mipLevels; ++level)
+        {
+            encodeLevel(pLevel, levelWidth, levelHeight, usage, reinterpret_cast<uint8_t*>(data.data() + levelOffsets[level]));
+
+            if (level + 1 < header.mipLevels)
+            {
+                levelTexels = downsample(pLevel, levelWidth, levelHeight);
+                pLevel      = levelTexels.data();
+                levelWidth  = std::max(levelWidth / 2, 1u);
+                levelHeight = std::max(levelHeight / 2, 1u);
+            }
+        }
+
+        return data;
+    }
+}  // namespace palm
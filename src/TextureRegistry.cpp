@@ -0,0 +1,84 @@
+/*****************************************************************/ /**
+ * @file   TextureRegistry.cpp
+ * @brief  source file of TextureRegistry class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/TextureRegistry.hpp"
+
+namespace palm
+{
+    TextureRegistry::TextureRegistry(vk2s::Device& device)
+        : mDevice(device)
+    {
+    }
+
+    Handle<vk2s::Image> TextureRegistry::find(const uint64_t key) const
+    {
+        if (const auto itr = mImages.find(key); itr != mImages.end())
+        {
+            return itr->second;
+        }
+
+        return Handle<vk2s::Image>();
+    }
+
+    std::optional<uint64_t> TextureRegistry::findKey(const std::string& source) const
+    {
+        if (const auto itr = mSources.find(source); itr != mSources.end() && mImages.contains(itr->second))
+        {
+            return itr->second;
+        }
+
+        return std::nullopt;
+    }
+
+    std::optional<uint64_t> TextureRegistry::getKey(Handle<vk2s::Image> image) const
+    {
+        if (!image)
+        {
+            return std::nullopt;
+        }
+
+        if (const auto itr = mKeys.find(image->getVkImage().get()); itr != mKeys.end())
+        {
+            return itr->second;
+        }
+
+        return std::nullopt;
+    }
+
+    void TextureRegistry::add(const uint64_t key, Handle<vk2s::Image> image, const std::string& source)
+    {
+        if (!image)
+        {
+            return;
+        }
+
+        mImages[key]                     = image;
+        mKeys[image->getVkImage().get()] = key;
+        if (!source.empty())
+        {
+            mSources[source] = key;
+        }
+    }
+
+    void TextureRegistry::destroy(Handle<vk2s::Image>& image)
+    {
+        if (!image)
+        {
+            return;
+        }
+
+        if (const auto itr = mKeys.find(image->getVkImage().get()); itr != mKeys.end())
+        {
+            mImages.erase(itr->second);
+            // sources of the contents are left to the next load (findKey() ignores keys without an image)
+            mKeys.erase(itr);
+        }
+
+        mDevice.destroy(image);
+    }
+}  // namespace palm
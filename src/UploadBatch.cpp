@@ -0,0 +1,291 @@
+/*****************************************************************/ /**
+ * @file   UploadBatch.cpp
+ * @brief  source file of UploadBatch class
+ *
+ * @author ichi-raven
+ * @date   October 2026
+ *********************************************************************/
+
+#include "../include/UploadBatch.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+namespace palm
+{
+    namespace
+    {
+        constexpr vk::DeviceSize alignUp(const vk::DeviceSize value, const vk::DeviceSize alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        // layout transition of the levels [baseLevel, baseLevel + levelCount) of a color image
+        void transitionLevels(const vk::CommandBuffer commandBuffer, const vk::Image image, const uint32_t baseLevel, const uint32_t levelCount, const vk::ImageLayout oldLayout, const vk::ImageLayout newLayout, const vk::AccessFlags srcAccess, const vk::AccessFlags dstAccess, const vk::PipelineStageFlags dstStage)
+        {
+            vk::ImageMemoryBarrier barrier;
+            barrier.srcAccessMask       = srcAccess;
+            barrier.dstAccessMask       = dstAccess;
+            barrier.oldLayout           = oldLayout;
+            barrier.newLayout           = newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image               = image;
+            barrier.subresourceRange    = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, baseLevel, levelCount, 0, 1);
+
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, dstStage, {}, {}, {}, barrier);
+        }
+    }  // namespace
+
+    UploadBatch::UploadBatch(vk2s::Device& device, DeviceMemoryPool& memoryPool)
+        : mDevice(device)
+        , mMemoryPool(memoryPool)
+    {
+    }
+
+    Handle<vk2s::Image> UploadBatch::addImage(const uint32_t width, const uint32_t height, const vk::Format format, const void* pTexels, const size_t size, const vk::ImageLayout finalLayout, const bool mipmapped)
+    {
+        // each level is blitted from the previous one, which requires linear filtering of the format
+        const auto blitFeatures = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+        const bool canBlit      = (mDevice.getVkPhysicalDevice().getFormatProperties(format).optimalTilingFeatures & blitFeatures) == blitFeatures;
+
+        vk::ImageCreateInfo ci;
+        ci.arrayLayers   = 1;
+        ci.extent        = vk::Extent3D(width, height, 1);
+        ci.format        = format;
+        ci.imageType     = vk::ImageType::e2D;
+        ci.mipLevels     = mipmapped && canBlit ? static_cast<uint32_t>(std::bit_width(std::max(width, height))) : 1;
+        ci.usage         = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc;
+        ci.initialLayout = vk::ImageLayout::eUndefined;
+
+        Handle<vk2s::Image> image = mDevice.create<vk2s::Image>(ci, vk::MemoryPropertyFlagBits::eDeviceLocal, static_cast<uint32_t>(size), vk::ImageAspectFlagBits::eColor);
+
+        mPendingImages.emplace_back(PendingImage{ image, ci.extent, ci.mipLevels, { size }, finalLayout, pTexels, size });
+        mMaxImageSize = std::max(mMaxImageSize, alignUp(size, kStagingAlignment));
+
+        return image;
+    }
+
+    Handle<vk2s::Image> UploadBatch::addImage(const uint32_t width, const uint32_t height, const vk::Format format, const void* pTexels, std::span<const size_t> levelSizes, const vk::ImageLayout finalLayout)
+    {
+        vk::ImageCreateInfo ci;
+        ci.arrayLayers   = 1;
+        ci.extent        = vk::Extent3D(width, height, 1);
+        ci.format        = format;
+        ci.imageType     = vk::ImageType::e2D;
+        ci.mipLevels     = static_cast<uint32_t>(levelSizes.size());
+        ci.usage         = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc;
+        ci.initialLayout = vk::ImageLayout::eUndefined;
+
+        size_t size = 0;
+        for (const auto levelSize : levelSizes)
+        {
+            size += levelSize;
+        }
+
+        Handle<vk2s::Image> image = mDevice.create<vk2s::Image>(ci, vk::MemoryPropertyFlagBits::eDeviceLocal, static_cast<uint32_t>(size), vk::ImageAspectFlagBits::eColor);
+
+        mPendingImages.emplace_back(PendingImage{ image, ci.extent, ci.mipLevels, std::vector<size_t>(levelSizes.begin(), levelSizes.end()), finalLayout, pTexels, size });
+        mMaxImageSize = std::max(mMaxImageSize, alignUp(size, kStagingAlignment));
+
+        return image;
+    }
+
+    void UploadBatch::addBuffer(vk::Buffer buffer, const void* pData, const size_t size, const vk::DeviceSize offset)
+    {
+        // buffers can be copied in pieces, so they never enlarge the slots
+        const auto* p = reinterpret_cast<const std::uint8_t*>(pData);
+        for (size_t done = 0; done < size; done += kStagingSlotSize)
+        {
+            const size_t pieceSize = std::min(size - done, static_cast<size_t>(kStagingSlotSize));
+            mPendingBuffers.emplace_back(PendingBuffer{ buffer, offset + done, p + done, pieceSize });
+        }
+    }
+
+    void UploadBatch::addBuffer(vk::Buffer buffer, std::vector<std::uint8_t>&& data, const vk::DeviceSize offset)
+    {
+        const auto& owned = mOwnedData.emplace_back(std::move(data));
+        addBuffer(buffer, owned.data(), owned.size(), offset);
+    }
+
+    void UploadBatch::submit()
+    {
+        if (mPendingImages.empty() && mPendingBuffers.empty())
+        {
+            return;
+        }
+
+        // staging ring
+        const vk::DeviceSize slotSize = std::max(kStagingSlotSize, mMaxImageSize);
+        const PooledBuffer stagingBuffer(mDevice, mMemoryPool, vk::BufferCreateInfo({}, slotSize * kStagingSlotNum, vk::BufferUsageFlagBits::eTransferSrc), MemoryUsage::eUpload);
+        auto* pStaging                = reinterpret_cast<std::uint8_t*>(stagingBuffer.getMappedPointer());
+
+        std::array<UniqueHandle<vk2s::Fence>, kStagingSlotNum> fences;
+        std::array<UniqueHandle<vk2s::Command>, kStagingSlotNum> commands;
+        std::array<bool, kStagingSlotNum> inFlight{};
+        for (uint32_t i = 0; i < kStagingSlotNum; ++i)
+        {
+            fences[i]   = mDevice.create<vk2s::Fence>();
+            commands[i] = mDevice.create<vk2s::Command>();
+        }
+
+        // uploads packed into the current slot (pending image or buffer, offset in the slot)
+        struct Staged
+        {
+            bool isImage;
+            size_t index;
+            vk::DeviceSize offset;
+        };
+        std::vector<Staged> staged;
+        uint32_t slot         = 0;
+        vk::DeviceSize offset = 0;
+
+        const auto flush = [&]()
+        {
+            if (staged.empty())
+            {
+                return;
+            }
+
+            const vk::DeviceSize slotOffset = slotSize * slot;
+
+            // pack (in parallel, each range is disjoint)
+#pragma omp parallel for schedule(dynamic)
+            for (int i = 0; i < static_cast<int>(staged.size()); ++i)
+            {
+                const auto& s = staged[i];
+                if (s.isImage)
+                {
+                    std::memcpy(pStaging + slotOffset + s.offset, mPendingImages[s.index].pTexels, mPendingImages[s.index].size);
+                }
+                else
+                {
+                    std::memcpy(pStaging + slotOffset + s.offset, mPendingBuffers[s.index].pData, mPendingBuffers[s.index].size);
+                }
+            }
+
+            // record all copies of the slot into one command
+            auto& cmd = commands[slot];
+            fences[slot]->reset();
+            cmd->begin(true);
+
+            for (const auto& s : staged)
+            {
+                if (s.isImage)
+                {
+                    const auto& pending                   = mPendingImages[s.index];
+                    const vk::CommandBuffer commandBuffer = cmd->getVkCommandBuffer().get();
+                    const vk::Image image                 = pending.image->getVkImage().get();
+
+                    transitionLevels(commandBuffer, image, 0, pending.mipLevels, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, {}, vk::AccessFlagBits::eTransferWrite, vk::PipelineStageFlagBits::eTransfer);
+
+                    // given levels (packed in the staging slot from level 0)
+                    vk::DeviceSize levelOffset = slotOffset + s.offset;
+                    for (uint32_t level = 0; level < pending.levelSizes.size(); ++level)
+                    {
+                        const vk::Extent3D levelExtent(std::max(pending.extent.width >> level, 1u), std::max(pending.extent.height >> level, 1u), 1);
+                        const auto copyRegion = vk::BufferImageCopy().setBufferOffset(levelOffset).setBufferRowLength(0).setBufferImageHeight(0).setImageSubresource({ vk::ImageAspectFlagBits::eColor, level, 0, 1 }).setImageOffset({ 0, 0, 0 }).setImageExtent(levelExtent);
+                        commandBuffer.copyBufferToImage(stagingBuffer.getVkBuffer(), image, vk::ImageLayout::eTransferDstOptimal, copyRegion);
+                        levelOffset += pending.levelSizes[level];
+                    }
+
+                    if (pending.levelSizes.size() == pending.mipLevels)
+                    {
+                        transitionLevels(commandBuffer, image, 0, pending.mipLevels, vk::ImageLayout::eTransferDstOptimal, pending.finalLayout, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::PipelineStageFlagBits::eAllCommands);
+                        continue;
+                    }
+
+                    // generated mip chain (each level is read once it is written, then waits in eTransferSrcOptimal)
+                    int32_t levelWidth  = static_cast<int32_t>(pending.extent.width);
+                    int32_t levelHeight = static_cast<int32_t>(pending.extent.height);
+                    for (uint32_t level = 1; level < pending.mipLevels; ++level)
+                    {
+                        transitionLevels(commandBuffer, image, level - 1, 1, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead, vk::PipelineStageFlagBits::eTransfer);
+
+                        const int32_t nextWidth  = std::max(levelWidth / 2, 1);
+                        const int32_t nextHeight = std::max(levelHeight / 2, 1);
+
+                        vk::ImageBlit blit;
+                        blit.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - 1, 0, 1);
+                        blit.srcOffsets[1]  = vk::Offset3D(levelWidth, levelHeight, 1);
+                        blit.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1);
+                        blit.dstOffsets[1]  = vk::Offset3D(nextWidth, nextHeight, 1);
+                        commandBuffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+                        levelWidth  = nextWidth;
+                        levelHeight = nextHeight;
+                    }
+
+                    // every level except the last one is in eTransferSrcOptimal
+                    const uint32_t lastLevel = pending.mipLevels - 1;
+                    if (lastLevel > 0)
+                    {
+                        transitionLevels(commandBuffer, image, 0, lastLevel, vk::ImageLayout::eTransferSrcOptimal, pending.finalLayout, vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eShaderRead, vk::PipelineStageFlagBits::eAllCommands);
+                    }
+                    transitionLevels(commandBuffer, image, lastLevel, 1, vk::ImageLayout::eTransferDstOptimal, pending.finalLayout, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::PipelineStageFlagBits::eAllCommands);
+                }
+                else
+                {
+                    const auto& pending = mPendingBuffers[s.index];
+                    cmd->getVkCommandBuffer()->copyBuffer(stagingBuffer.getVkBuffer(), pending.buffer, vk::BufferCopy(slotOffset + s.offset, pending.offset, pending.size));
+                }
+            }
+
+            // make the copied buffers visible to every later use (vertex input, AS build input, shaders)
+            const vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eMemoryRead);
+            cmd->getVkCommandBuffer()->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, barrier, {}, {});
+
+            cmd->end();
+            cmd->execute(fences[slot]);
+            inFlight[slot] = true;
+
+            // move to the next slot, waiting for its previous copies
+            staged.clear();
+            offset = 0;
+            slot   = (slot + 1) % kStagingSlotNum;
+            if (inFlight[slot])
+            {
+                fences[slot]->wait();
+                inFlight[slot] = false;
+            }
+        };
+
+        const auto stage = [&](const bool isImage, const size_t index, const size_t size)
+        {
+            if (offset + size > slotSize)
+            {
+                flush();
+            }
+
+            staged.emplace_back(Staged{ isImage, index, offset });
+            offset += alignUp(size, kStagingAlignment);
+        };
+
+        for (size_t i = 0; i < mPendingImages.size(); ++i)
+        {
+            stage(true, i, mPendingImages[i].size);
+        }
+        for (size_t i = 0; i < mPendingBuffers.size(); ++i)
+        {
+            stage(false, i, mPendingBuffers[i].size);
+        }
+        flush();
+
+        for (uint32_t i = 0; i < kStagingSlotNum; ++i)
+        {
+            if (inFlight[i])
+            {
+                fences[i]->wait();
+            }
+        }
+
+        mPendingImages.clear();
+        mPendingBuffers.clear();
+        mOwnedData.clear();
+        mMaxImageSize = 0;
+    }
+}  // namespace palm
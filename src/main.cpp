@@ -3,12 +3,16 @@
 #include "../include/AppStates.hpp"
 #include "../include/States/Editor.hpp"
 #include "../include/States/Renderer.hpp"
+#include "../include/States/Headless.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image.h>
 #include <stb_image_write.h>
 
+#include <iostream>
+#include <string_view>
+
 inline void setupImGuiStyle()
 {
     ImGui::CreateContext();
@@ -62,23 +66,202 @@ inline void setupImGuiStyle()
     style.Colors[ImGuiCol_TextSelectedBg]       = ImVec4(0.00f, 1.00f, 1.00f, 0.22f);
 }
 
-int main()
+inline void printUsage()
 {
-    setupImGuiStyle();
+    std::cout << "usage: palm [--compact-vertices] [--headless [options]]\n"
+                 "  --compact-vertices       store vertices with quantized normal and UV (20 bytes per vertex)\n"
+                 "  --headless               render offline without window, swapchain and GUI\n"
+                 "  --scene <path>           scene file (.palmscene) saved from the editor\n"
+                 "  --model <path>           3D model to be loaded (can be specified multiple times)\n"
+                 "  --envmap <path>          environment map image for infinite emitter\n"
+                 "  --env-color <r> <g> <b>  constant emissive of infinite emitter\n"
+                 "  --integrator <name>      path (default) or restir\n"
+                 "  --size <w> <h>           resolution of output image (default: 1920 1080)\n"
+                 "  --spp <n>                total samples per pixel (default: 1024, 0: unlimited, requires --time)\n"
+                 "  --spp-per-frame <n>      samples per pixel per frame (default: 1)\n"
+                 "  --time <sec>             time budget in seconds (default: 0, no limit)\n"
+                 "  --camera-pos <x> <y> <z> camera position\n"
+                 "  --camera-lookat <x> <y> <z> camera look-at point\n"
+                 "  --fov <degree>           camera field of view (default: 60)\n"
+                 "  --output <path>          destination of rendered image (default: rendered.png)\n";
+}
+
+/** 
+ * @brief  Parse command line arguments for headless mode
+ *  
+ * @param argc argc of main
+ * @param argv argv of main
+ * @return Settings if launched in headless mode, otherwise std::nullopt
+ */
+inline std::optional<palm::HeadlessSettings> parseArguments(int argc, char** argv)
+{
+    std::optional<palm::HeadlessSettings> settings;
+    palm::HeadlessSettings parsed;
+
+    // throws if the option lacks its values
+    const auto next = [&](int& i) -> std::string_view
+    {
+        if (++i >= argc)
+        {
+            throw std::invalid_argument(std::string("missing value for ") + argv[i - 1]);
+        }
+        return argv[i];
+    };
+
+    const auto nextVec3 = [&](int& i) -> glm::vec3
+    {
+        const float x = std::stof(std::string(next(i)));
+        const float y = std::stof(std::string(next(i)));
+        const float z = std::stof(std::string(next(i)));
+        return glm::vec3(x, y, z);
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+
+        if (arg == "--headless")
+        {
+            settings = parsed;
+        }
+        else if (arg == "--scene")
+        {
+            parsed.scenePath = next(i);
+        }
+        else if (arg == "--model")
+        {
+            parsed.modelPaths.emplace_back(next(i));
+        }
+        else if (arg == "--envmap")
+        {
+            parsed.envmapPath = next(i);
+        }
+        else if (arg == "--env-color")
+        {
+            parsed.envColor = nextVec3(i);
+        }
+        else if (arg == "--integrator")
+        {
+            parsed.integrator = next(i);
+        }
+        else if (arg == "--size")
+        {
+            parsed.width  = std::stoul(std::string(next(i)));
+            parsed.height = std::stoul(std::string(next(i)));
+        }
+        else if (arg == "--spp")
+        {
+            parsed.targetSpp = std::stoul(std::string(next(i)));
+        }
+        else if (arg == "--spp-per-frame")
+        {
+            parsed.sppPerFrame = std::max(1ul, std::stoul(std::string(next(i))));
+        }
+        else if (arg == "--time")
+        {
+            parsed.timeBudget = std::stod(std::string(next(i)));
+        }
+        else if (arg == "--camera-pos")
+        {
+            parsed.cameraPos = nextVec3(i);
+        }
+        else if (arg == "--camera-lookat")
+        {
+            parsed.cameraLookAt = nextVec3(i);
+        }
+        else if (arg == "--fov")
+        {
+            parsed.cameraFOV = std::stod(std::string(next(i)));
+        }
+        else if (arg == "--output")
+        {
+            parsed.outputPath = next(i);
+        }
+        else if (arg == "--compact-vertices")
+        {
+            // common to both modes, applied in main
+        }
+        else
+        {
+            throw std::invalid_argument(std::string("unknown option: ") + std::string(arg));
+        }
+    }
+
+    // options may be given after --headless
+    if (settings)
+    {
+        settings = parsed;
+
+        // the rendering must end to write the image
+        if (settings->targetSpp == 0 && settings->timeBudget <= 0.)
+        {
+            throw std::invalid_argument("--spp 0 requires --time");
+        }
+    }
+
+    return settings;
+}
+
+int main(int argc, char** argv)
+{
+    bool compactVertices = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+
+        compactVertices |= std::string_view(argv[i]) == "--compact-vertices";
+    }
+
+    std::optional<palm::HeadlessSettings> headless;
+    try
+    {
+        headless = parseArguments(argc, argv);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        printUsage();
+        return 1;
+    }
 
     ec2s::Application<palm::AppState, palm::CommonRegion> app;
 
-    app.mpCommonRegion->window = app.mpCommonRegion->device.create<vk2s::Window>(1920, 1080, 3, "palm window", false);
+    // must be selected before any geometry is created
+    if (compactVertices)
+    {
+        app.mpCommonRegion->meshPool.setVertexFormat(palm::VertexFormat::eCompact);
+    }
 
-    app.addState<palm::Editor>(palm::AppState::eEditor);
-    app.addState<palm::Renderer>(palm::AppState::eRenderer);
+    if (headless)
+    {
+        // no window, swapchain and ImGui
+        app.mpCommonRegion->headless = headless;
+
+        app.addState<palm::Headless>(palm::AppState::eHeadless);
+
+        app.init(palm::AppState::eHeadless);
+    }
+    else
+    {
+        setupImGuiStyle();
 
-    app.init(palm::AppState::eEditor);
+        app.mpCommonRegion->window = app.mpCommonRegion->device.create<vk2s::Window>(1920, 1080, 3, "palm window", false);
+
+        app.addState<palm::Editor>(palm::AppState::eEditor);
+        app.addState<palm::Renderer>(palm::AppState::eRenderer);
+
+        app.init(palm::AppState::eEditor);
+    }
 
     while (!app.endAll())
     {
         app.update();
     }
 
-    return 0;
-}
\ No newline at end of file
+    // report failures of headless rendering (e.g. an input that could not be loaded) to the caller
+    return app.mpCommonRegion->headlessFailed ? 1 : 0;
+}